@@ -0,0 +1,65 @@
+/**
+ * @file    alloc.h
+ * @brief   Huge page and NUMA aware memory for big matrices
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+/*** Dependencies ***/
+
+#include <stddef.h>
+
+/*** Constants ***/
+
+/* Where the values of a matrix come from. A page size can be or'ed with
+ * one NUMA placement, e.g. ALLOC_HUGE | ALLOC_INTERLEAVE, a placement on
+ * its own uses ordinary 4KB pages */
+#define ALLOC_MALLOC      0x0  /* Plain malloc, the default */
+#define ALLOC_HUGE        0x1  /* 2MB transparent huge pages */
+#define ALLOC_HUGE1G      0x2  /* 1GB pages reserved for hugetlbfs, else 2MB */
+#define ALLOC_INTERLEAVE  0x4  /* Pages spread round robin over the nodes */
+#define ALLOC_BIND(node)  (0x8 | (node) << 8)  /* Pages on one node only */
+
+/* Masks of the parts of a policy */
+#define ALLOC_PAGES       0x3
+#define ALLOC_NUMA        0xc
+#define ALLOC_NODE(policy) ((policy) >> 8)
+
+/* Anything smaller comes from malloc, most of a huge page would be wasted */
+#define ALLOC_MIN_BYTES (1L << 21)
+
+/*** Function Prototypes ***/
+
+/**
+ * Allocates zeroed values of a row-major nrows x ncols matrix. Pages
+ * that are not from malloc are touched for the first time by the thread
+ * pool, split by rows the same way tprange() splits them for the
+ * kernels, so without a NUMA placement every page lands on the node of
+ * the thread that works on it.
+ *
+ * @param[in] nrows
+ * @param[in] ncols
+ *     The size of the matrix
+ * @param[in,out] policy
+ *     The ALLOC_* policy to use, changed to the one that was used when a
+ *     part of it is not available, e.g. no reserved 1GB pages or a node
+ *     that is not online
+ * @return
+ *     Returns the pointer to the values, 64 byte aligned
+ */
+double *allocvals(int nrows, int ncols, int *policy);
+
+/**
+ * Free values from allocvals().
+ *
+ * @param[in] vals
+ *     The values to free
+ * @param[in] policy
+ *     The policy allocvals() returned for them
+ */
+void freevals(double *vals, int policy);
+
+#endif /* ALLOC_H */
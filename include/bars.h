@@ -0,0 +1,150 @@
+/**
+ * @file    bars.h
+ * @brief   Streaming tick to bar resampling at several timeframes
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef BARS_H
+#define BARS_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+
+/*** Constants ***/
+
+/* Columns of a tick Matrix, one row per trade */
+#define TICK_TIME  0
+#define TICK_SYM   1 /* Symbol number, 0 to nsyms - 1 */
+#define TICK_PRICE 2
+#define TICK_QTY   3
+#define TICK_COLS  4
+
+/* Columns of a bar, one row per completed bar */
+#define BAR_TIME   0 /* Start of the period */
+#define BAR_OPEN   1
+#define BAR_HIGH   2
+#define BAR_LOW    3
+#define BAR_CLOSE  4
+#define BAR_VOLUME 5
+#define BAR_VWAP   6
+#define BAR_COLS   7
+
+/*** Type Definitions ***/
+
+/* A bar that is still being built, one cache line */
+typedef struct {
+	double start;  /* Start of the period, the bar is empty while end == start */
+	double end;
+	double open;
+	double high;
+	double low;
+	double close;
+	double volume;
+	double pv;     /* Sum of price * qty */
+} OpenBar;
+
+/* Bars of nsyms symbols at nframes timeframes. The open bars of a symbol
+ * are next to each other, so a tick touches nframes adjacent cache lines.
+ * Completed bars of symbol s at timeframe f go to ring s * nframes + f, a
+ * block of 2 * cap rows of rings where every bar is written twice, cap
+ * rows apart, so the last cap bars are always one contiguous view */
+typedef struct {
+	int nsyms;
+	int nframes;
+	int cap;           /* Bars kept per symbol and timeframe */
+	double *frames;    /* Length of every timeframe, in the unit of time */
+	OpenBar *open;     /* nsyms x nframes bars being built */
+	long *count;       /* Bars completed per symbol and timeframe */
+	Matrix *rings;     /* nsyms * nframes * 2 * cap x BAR_COLS */
+} BarAgg;
+
+/*** Function Prototypes ***/
+
+/**
+ * Instantiates an aggregator without any bars. A period of a timeframe
+ * starts at a multiple of its length, e.g. a 60 second bar from 12:00:00
+ * to 12:01:00.
+ *
+ * @param[in] nsyms
+ *     The amount of symbols
+ * @param[in] nframes
+ *     The amount of timeframes
+ * @param[in] frames
+ *     The length of every timeframe, in the unit of the tick times
+ * @param[in] cap
+ *     The amount of completed bars kept per symbol and timeframe
+ * @return
+ *     Returns the pointer to the new aggregator
+ */
+BarAgg *initbars(int nsyms, int nframes, const double *frames, int cap);
+
+/**
+ * Free the aggregator.
+ *
+ * @param[in] agg
+ *     The aggregator to free
+ */
+void freebars(BarAgg *agg);
+
+/**
+ * Add one trade to the open bars of its symbol at every timeframe. A bar
+ * completes when the first trade after its period arrives, periods
+ * without trades have no bar. Trades of a symbol come in time order, a
+ * late trade is added to the open bar.
+ *
+ * @param[in] agg
+ *     The aggregator
+ * @param[in] sym
+ *     The symbol number
+ * @param[in] time
+ * @param[in] price
+ * @param[in] qty
+ *     The trade
+ */
+void barstick(BarAgg *agg, int sym, double time, double price, double qty);
+
+/**
+ * Add every trade of a tick Matrix in a single pass.
+ *
+ * @param[in] agg
+ *     The aggregator
+ * @param[in] ticks
+ *     n x TICK_COLS trades, oldest first
+ */
+void barsfeed(BarAgg *agg, const Matrix *ticks);
+
+/**
+ * Complete every open bar whose period is over by time, for when no
+ * trade has arrived since, e.g. on a timer.
+ *
+ * @param[in] agg
+ *     The aggregator
+ * @param[in] time
+ *     The current time
+ */
+void barsflush(BarAgg *agg, double time);
+
+/**
+ * View of the last completed bars of a symbol at a timeframe, oldest
+ * first. Nothing is copied, the rows stay the same until cap - k more
+ * bars of the symbol and timeframe complete.
+ *
+ * @param[in] agg
+ *     The aggregator
+ * @param[in] sym
+ *     The symbol number
+ * @param[in] frame
+ *     The timeframe number
+ * @param[in] k
+ *     The amount of bars wanted, at most cap
+ * @param[out] view
+ *     The bars, one per row with the BAR_* columns
+ * @return
+ *     Returns the amount of rows in view, less than k if fewer bars
+ *     have completed
+ */
+int barslast(const BarAgg *agg, int sym, int frame, int k, Matrix *view);
+
+#endif /* BARS_H */
@@ -0,0 +1,161 @@
+/**
+ * @file    batch.h
+ * @brief   Batches of small same-size matrices solved all at once
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+
+/*** Defines ***/
+
+/* Pointer to tile t, the values of matrices t * BATCH_LANES onwards */
+#define TILE(batch, t) \
+	(&(batch)->vals[(size_t)(t) * (batch)->nrows * (batch)->ncols * BATCH_LANES])
+
+/* Pointer to value (x, y) of the first matrix in a tile of matrices with
+ * ncols columns, the same value of the other matrices follows after it */
+#define LANES(tile, ncols, x, y) ((tile) + ((x) + (y) * (ncols)) * BATCH_LANES)
+
+/* Helper Macro to get value (x, y) of matrix b in the batch */
+#define BGET(batch, b, x, y) \
+	LANES(TILE(batch, (b) / BATCH_LANES), (batch)->ncols, x, y)[(b) % BATCH_LANES]
+
+/*** Constants ***/
+
+/* The count is rounded up to this so every lane loop is full vectors,
+ * 8 doubles is one AVX-512 register or two AVX2 ones */
+#define BATCH_LANES 8
+
+/*** Type Definitions ***/
+
+/* count matrices of nrows x ncols stored in tiles of BATCH_LANES
+ * matrices, interleaved value by value inside a tile so that the loops
+ * over the matrices run along contiguous memory */
+typedef struct {
+	int count;
+	int stride;    /* count rounded up to BATCH_LANES */
+	int nrows;
+	int ncols;
+	double *vals;
+} MatBatch;
+
+/*** Function Prototypes ***/
+
+/**
+ * Instantiates a batch of zeroed matrices.
+ *
+ * @param[in] count
+ *     The amount of matrices
+ * @param[in] nrows
+ * @param[in] ncols
+ *     The dimension of every matrix
+ * @return
+ *     Returns the pointer to the new batch
+ */
+MatBatch *initbatch(int count, int nrows, int ncols);
+
+/**
+ * Free the batch.
+ *
+ * @param[in] batch
+ *     The batch to free
+ */
+void freebatch(MatBatch *batch);
+
+/**
+ * Copy a Matrix into the batch.
+ *
+ * @param[in] batch
+ *     The batch to copy into
+ * @param[in] b
+ *     The index of the matrix in the batch
+ * @param[in] mat
+ *     The matrix to copy, the same size as the batch
+ */
+void batchset(MatBatch *batch, int b, const Matrix *mat);
+
+/**
+ * Copy a matrix out of the batch.
+ *
+ * @param[in] res
+ *     The Matrix to copy into, the same size as the batch
+ * @param[in] batch
+ *     The batch to copy from
+ * @param[in] b
+ *     The index of the matrix in the batch
+ */
+void batchget(Matrix *res, const MatBatch *batch, int b);
+
+/**
+ * LU decomposition with partial pivoting of every matrix in place, the
+ * same as solinv() does for one matrix.
+ *
+ * @param[in] batch
+ *     Square matrices, replaced by L (unit diagonal not stored) and U
+ * @param[out] pivots
+ *     Room for nrows * stride ints, the rows swapped with row k of the
+ *     matrices in tile t are at pivots[(t * nrows + k) * BATCH_LANES]
+ * @param[out] status
+ *     NULL, or room for count ints set to 0 or -1 if that matrix is singular
+ * @return
+ *     Returns the amount of singular matrices
+ */
+int batchlu(MatBatch *batch, int *pivots, int *status);
+
+/**
+ * Solves LUx = Py for every matrix, after batchlu().
+ *
+ * @param[in] lu
+ *     The factors from batchlu()
+ * @param[in] pivots
+ *     The pivots from batchlu()
+ * @param[in] vec
+ *     A batch of nrows x k right hand sides, replaced by the solutions
+ */
+void batchlusolve(const MatBatch *lu, const int *pivots, MatBatch *vec);
+
+/**
+ * Cholesky decomposition of every matrix in place, the same as matchol()
+ * does for one matrix.
+ *
+ * @param[in] batch
+ *     Symmetric matrices, replaced by L with the upper part zeroed
+ * @param[out] status
+ *     NULL, or room for count ints set to 0 or -1 if that matrix is not
+ *     positive definite
+ * @return
+ *     Returns the amount of matrices that are not positive definite
+ */
+int batchchol(MatBatch *batch, int *status);
+
+/**
+ * Solves LL^Tx = y for every matrix, after batchchol().
+ *
+ * @param[in] chol
+ *     The factors from batchchol()
+ * @param[in] vec
+ *     A batch of nrows x k right hand sides, replaced by the solutions
+ */
+void batchcholsolve(const MatBatch *chol, MatBatch *vec);
+
+/**
+ * Solves Ax = y for every matrix, factoring with batchlu().
+ *
+ * @param[in] mat
+ *     The A matrices, replaced by their LU factors
+ * @param[in] vec
+ *     A batch of nrows x k y vectors, replaced by the x vectors
+ * @param[out] status
+ *     As for batchlu()
+ * @return
+ *     Returns the amount of singular matrices
+ */
+int batchsolve(MatBatch *mat, MatBatch *vec, int *status);
+
+#endif /* BATCH_H */
@@ -0,0 +1,125 @@
+/**
+ * @file    covariance.h
+ * @brief   Streaming covariance of many assets, updated bar by bar
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef COVARIANCE_H
+#define COVARIANCE_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+#include "symmat.h"
+
+/*** Constants ***/
+
+/* A sliding window is recomputed from its bars after this many windows
+ * of updates, so the rounding of the downdates does not build up */
+#define COV_REFRESH_WINDOWS 8
+
+/*** Type Definitions ***/
+
+/* Weighted mean and sum of squared deviations of the bars seen so far,
+ * kept with Welford's updates. Either every bar is weighted decay^age or
+ * only the last window bars are kept, with weight 1 */
+typedef struct {
+	int n;
+	double decay;      /* 1 for a sliding window */
+	int window;        /* 0 for exponential decay */
+	long count;        /* Bars seen */
+	double weight;     /* Sum of the weights */
+	double weight2;    /* Sum of the squared weights */
+	double *mean;      /* n weighted means */
+	SymMatrix *m2;     /* Weighted sum of (x - mean)(x - mean)^T */
+
+	/* Moments around the first bar, for the Ledoit-Wolf shrinkage */
+	double *shift;     /* The first bar */
+	double *s3;        /* Weighted sum of |x - shift|^2 (x - shift) */
+	double s2;         /* Weighted sum of |x - shift|^2 */
+	double s4;         /* Weighted sum of |x - shift|^4 */
+
+	Matrix *ring;      /* The last window bars, window x n */
+	int head;          /* Row of the oldest bar in the ring */
+	long fresh;        /* Bars since the window was last recomputed */
+
+	double *scratch;   /* Deviations handed to symrankk() */
+	double *wts;       /* Weights of the rows in scratch */
+	int cap;           /* Rows of room in scratch and wts */
+} CovEst;
+
+/*** Function Prototypes ***/
+
+/**
+ * Instantiates an exponentially weighted covariance estimator, a bar
+ * that is t bars old has weight decay^t.
+ *
+ * @param[in] n
+ *     The amount of assets
+ * @param[in] decay
+ *     Between 0 and 1, e.g. 0.5^(1 / half life in bars)
+ * @return
+ *     Returns the pointer to the new estimator
+ */
+CovEst *initcovewma(int n, double decay);
+
+/**
+ * Instantiates a covariance estimator over a sliding window of bars.
+ *
+ * @param[in] n
+ *     The amount of assets
+ * @param[in] window
+ *     The amount of most recent bars to keep
+ * @return
+ *     Returns the pointer to the new estimator
+ */
+CovEst *initcovwindow(int n, int window);
+
+/**
+ * Free the estimator.
+ *
+ * @param[in] est
+ *     The estimator to free
+ */
+void freecov(CovEst *est);
+
+/**
+ * Add a batch of new bars. The deviations of the batch from its own mean
+ * go in with one rank-k update, then the batch is merged with the older
+ * bars as Chan et al. merge two sets of moments. Bars that fall out of
+ * the window are taken out the same way, so a bar costs O(n^2).
+ *
+ * @param[in] est
+ *     The estimator
+ * @param[in] bars
+ *     k x n new bars, oldest first
+ */
+void covupdate(CovEst *est, const Matrix *bars);
+
+/**
+ * The weighted sample covariance M2 / weight of the bars so far.
+ *
+ * @param[in] est
+ *     The estimator, with at least one bar
+ * @param[out] res
+ *     The n x n covariance
+ */
+void covget(const CovEst *est, SymMatrix *res);
+
+/**
+ * The covariance shrunk towards a multiple of the identity as in Ledoit
+ * and Wolf (2004), with the optimal intensity found from the running
+ * moments in O(n^2). Weighted bars count as the Kish effective sample
+ * size weight^2 / weight2.
+ *
+ * @param[in] est
+ *     The estimator, with at least one bar
+ * @param[out] res
+ *     The n x n shrunk covariance
+ * @return
+ *     Returns the shrinkage intensity, between 0 and 1
+ */
+double covshrink(const CovEst *est, SymMatrix *res);
+
+#endif /* COVARIANCE_H */
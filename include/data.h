@@ -0,0 +1,101 @@
+/**
+ * @file    data.h
+ * @brief   Functions to store and read market data on the local computer
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef DATA_H
+#define DATA_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+
+/*** Constants ***/
+
+/* Magic bytes at the start of every data store file */
+#define DATA_MAGIC "TBOTMAT1"
+#define DATA_MAGIC_LEN 8
+
+/*** Type Definitions ***/
+
+/* Header of a data store file, the row-major doubles follow directly after */
+typedef struct {
+	char magic[DATA_MAGIC_LEN];
+	long nrows;
+	long ncols;
+} DataHeader;
+
+/* A data store file opened for reading rows on demand */
+typedef struct {
+	int fd;
+	long nrows;
+	long ncols;
+} DataFile;
+
+/*** Function Prototypes ***/
+
+/**
+ * Writes a Matrix to the local data store.
+ *
+ * @param[in] path
+ *     The file to write the matrix to, it is truncated if it exists
+ * @param[in] mat
+ *     The matrix to store
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 for an error
+ */
+int savemat(const char *path, const Matrix *mat);
+
+/**
+ * Reads a Matrix written with savemat() back from the local data store.
+ *
+ * @param[in] path
+ *     The file to read the matrix from
+ * @return
+ *     Returns the pointer to the new matrix,
+ *     NULL if the file could not be read or is not a data store file
+ */
+Matrix *loadmat(const char *path);
+
+/**
+ * Opens a data store file without reading the rows, for data sets that
+ * are too big to load with loadmat().
+ *
+ * @param[in] path
+ *     The file written with savemat()
+ * @return
+ *     Returns the pointer to the opened file,
+ *     NULL if the file could not be read or is not a data store file
+ */
+DataFile *opendata(const char *path);
+
+/**
+ * Close a data store file.
+ *
+ * @param[in] df
+ *     The file to close
+ */
+void closedata(DataFile *df);
+
+/**
+ * Reads a chunk of consecutive rows, safe to call from several threads at
+ * the same time since it uses pread.
+ *
+ * @param[in] df
+ *     The opened file
+ * @param[out] buf
+ *     Room for at least count * df->ncols doubles
+ * @param[in] row
+ *     The first row to read
+ * @param[in] count
+ *     The maximum amount of rows to read
+ * @return
+ *     Returns the amount of rows read, 0 past the end of the file
+ *     -1 for an error
+ */
+long readrows(const DataFile *df, double *buf, long row, long count);
+
+#endif /* DATA_H */
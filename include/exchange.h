@@ -0,0 +1,215 @@
+/**
+ * @file    exchange.h
+ * @brief   Local matching engine to trade against when there is no network
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef EXCHANGE_H
+#define EXCHANGE_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+
+#include <stdint.h>
+
+/*** Constants ***/
+
+/* Order sides */
+#define SIDE_BUY  0
+#define SIDE_SELL 1
+
+/* Order types */
+#define ORDER_LIMIT  0 /* Rests whatever is not filled immediately */
+#define ORDER_MARKET 1 /* Takes liquidity at any price, never rests */
+#define ORDER_IOC    2 /* Limit price, but whatever is not filled is dropped */
+
+/* Columns of a replay Matrix, one row per market event */
+#define REPLAY_TIME  0
+#define REPLAY_SIDE  1
+#define REPLAY_TYPE  2
+#define REPLAY_PRICE 3
+#define REPLAY_QTY   4
+#define REPLAY_COLS  5
+
+/*** Type Definitions ***/
+
+/* An order resting in the book, linked into the FIFO of its price level */
+typedef struct Order {
+	struct Order *next;
+	struct Order *prev;
+	long id;
+	long price;
+	long qty;
+	int side;
+} Order;
+
+/* All the orders resting at one price, oldest at the head */
+typedef struct {
+	Order *head;
+	Order *tail;
+	long qty;
+} PriceLevel;
+
+/* A single match between a resting (maker) and an incoming (taker) order */
+typedef struct {
+	long maker;
+	long taker;
+	long price;
+	long qty;
+	int side;     /* Side of the taker */
+	long tick;    /* Replay row the bot was reacting to, -1 otherwise */
+	long latency; /* Nanoseconds since that row arrived, 0 if tick is -1 */
+} Fill;
+
+typedef struct OrderBook OrderBook;
+
+/* Called for every fill, in the order they happen */
+typedef void (*FillCallback)(const Fill *fill, void *arg);
+
+/* Called by bookreplay() after every market event so the bot can react */
+typedef void (*TickCallback)(OrderBook *book, const double *row, void *arg);
+
+/* Price-level limit order book on a fixed ladder of integer tick prices */
+struct OrderBook {
+	long minprice;       /* Price of level 0 */
+	int nlevels;         /* Amount of price levels on the ladder */
+	PriceLevel *levels[2];
+	uint64_t *nonempty[2]; /* Bitmap of levels that have resting orders */
+	int nwords;
+	int best[2];         /* Best level per side, -1 if the side is empty */
+
+	Order *pool;         /* Preallocated orders, never malloc while trading */
+	Order *freelist;
+	int capacity;
+	long seq;
+
+	FillCallback onfill;
+	void *fillarg;
+
+	long tick;           /* Replay row being processed */
+	long tickns;         /* When that row arrived */
+};
+
+/*** Function Prototypes ***/
+
+/**
+ * Creates an empty order book.
+ *
+ * @param[in] minprice
+ *     The lowest price in ticks the book accepts
+ * @param[in] nlevels
+ *     The amount of tick prices above and including minprice
+ * @param[in] capacity
+ *     The maximum amount of orders that can rest at the same time
+ * @return
+ *     Returns the pointer to the new order book
+ */
+OrderBook *initbook(long minprice, int nlevels, int capacity);
+
+/**
+ * Free the order book.
+ *
+ * @param[in] book
+ *     The order book to free
+ */
+void freebook(OrderBook *book);
+
+/**
+ * Set the function that gets called for every fill.
+ *
+ * @param[in] book
+ * @param[in] onfill
+ *     The callback, NULL to stop reporting fills
+ * @param[in] arg
+ *     Passed through to the callback untouched
+ */
+void bookonfill(OrderBook *book, FillCallback onfill, void *arg);
+
+/**
+ * Submit an order, matching it against the other side of the book first.
+ *
+ * @param[in] book
+ * @param[in] side
+ *     SIDE_BUY or SIDE_SELL
+ * @param[in] type
+ *     ORDER_LIMIT, ORDER_MARKET or ORDER_IOC
+ * @param[in] price
+ *     The limit price in ticks, ignored for market orders
+ * @param[in] qty
+ *     The quantity to trade, must be positive
+ * @return
+ *     Returns the id of the order, the order only stays in the book if it is
+ *     a limit order that was not completely filled, only such an order
+ *     needs a free order slot
+ *     -1 if the order was rejected
+ */
+long bookorder(OrderBook *book, int side, int type, long price, long qty);
+
+/**
+ * Cancel a resting order.
+ *
+ * @param[in] book
+ * @param[in] id
+ *     The id returned by bookorder()
+ * @return
+ *     Returns 0 on success
+ *     -1 if the order is not resting in the book
+ */
+int bookcancel(OrderBook *book, long id);
+
+/**
+ * Get the best price on one side of the book.
+ *
+ * @param[in] book
+ * @param[in] side
+ *     SIDE_BUY for the best bid, SIDE_SELL for the best ask
+ * @return
+ *     Returns the best price in ticks
+ *     -1 if that side of the book is empty
+ */
+long bookbest(const OrderBook *book, int side);
+
+/**
+ * Get the total quantity resting at a price.
+ *
+ * @param[in] book
+ * @param[in] side
+ *     SIDE_BUY or SIDE_SELL
+ * @param[in] price
+ * @return
+ *     Returns the resting quantity, 0 if there is none or the price is
+ *     outside the ladder
+ */
+long bookdepth(const OrderBook *book, int side, long price);
+
+/**
+ * Get the quantity of an order that is still resting.
+ *
+ * @param[in] book
+ * @param[in] id
+ * @return
+ *     Returns the remaining quantity, 0 if the order is not resting
+ */
+long bookqty(const OrderBook *book, long id);
+
+/**
+ * Replay market events into the book and let the bot react to every one.
+ * The rows are laid out as described by the REPLAY_* columns, the time
+ * column is only passed through to the callback.
+ *
+ * @param[in] book
+ * @param[in] events
+ *     The market events, e.g. loaded from the local data store with loadmat()
+ * @param[in] ontick
+ *     Called after every event has been applied, may submit and cancel orders
+ * @param[in] arg
+ *     Passed through to the callback untouched
+ * @return
+ *     Returns the amount of events replayed
+ *     -1 if the events Matrix has the wrong shape
+ */
+long bookreplay(OrderBook *book, const Matrix *events, TickCallback ontick, void *arg);
+
+#endif /* EXCHANGE_H */
@@ -0,0 +1,144 @@
+/**
+ * @file    latency.h
+ * @brief   HDR style latency histograms to report tail latency per stage
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+/*** Dependencies ***/
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*** Constants ***/
+
+/* Every power of two range is split into LAT_SUB_HALF linear buckets,
+ * which keeps the relative error of a reported value under 1/64 */
+#define LAT_SUB_BITS  7
+#define LAT_SUB_COUNT (1 << LAT_SUB_BITS)
+#define LAT_SUB_HALF  (LAT_SUB_COUNT / 2)
+
+/* Largest recordable value is 2^LAT_MAX_BITS - 1 ns (about 18 minutes) */
+#define LAT_MAX_BITS  40
+#define LAT_NBUCKETS  ((LAT_MAX_BITS - LAT_SUB_BITS + 2) * LAT_SUB_HALF)
+
+/* Stages of the tick-to-trade path and the heavy calls behind them */
+#define LAT_DATA     0 /* Market data arrival */
+#define LAT_FEATURE  1 /* Feature update */
+#define LAT_PREDICT  2 /* Model predict */
+#define LAT_ORDER    3 /* Order send, from the tick arriving to the fill */
+#define LAT_SOLVE    4 /* Matrix solvers */
+#define LAT_TRAIN    5 /* Training calls */
+#define LAT_NSTAGES  6
+
+/*** Defines ***/
+
+/* Time the code between the two macros and record it under stage */
+#define LATENCY_START(t) long t = latnow()
+#define LATENCY_STOP(stage, t) latrecord(stage, latnow() - (t))
+
+/*** Type Definitions ***/
+
+typedef struct {
+	uint64_t counts[LAT_NBUCKETS];
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+} LatHist;
+
+/*** Function Prototypes ***/
+
+/**
+ * Clear all the recorded values of a histogram.
+ *
+ * @param[in] hist
+ */
+void lathistreset(LatHist *hist);
+
+/**
+ * Record a single value, takes constant time and never allocates.
+ *
+ * @param[in] hist
+ * @param[in] ns
+ *     The latency in nanoseconds, clamped to the recordable range
+ */
+void lathistrecord(LatHist *hist, long ns);
+
+/**
+ * Add all the values recorded in src to dst.
+ *
+ * @param[in] dst
+ * @param[in] src
+ */
+void lathistmerge(LatHist *dst, const LatHist *src);
+
+/**
+ * Get the value at a percentile.
+ *
+ * @param[in] hist
+ * @param[in] p
+ *     The percentile between 0 and 100, e.g. 99.9
+ * @return
+ *     Returns the highest value that is equivalent to the bucket the
+ *     percentile falls in, 0 if nothing has been recorded
+ */
+long lathistpercentile(const LatHist *hist, double p);
+
+/**
+ * Get the current time of the monotonic clock.
+ *
+ * @return
+ *     Returns the time in nanoseconds
+ */
+long latnow(void);
+
+/**
+ * Record a latency under a stage in the calling thread's histograms.
+ * Every thread records into its own histograms so there is no contention,
+ * they are only allocated on the first call of each thread.
+ *
+ * @param[in] stage
+ *     One of the LAT_* stages
+ * @param[in] ns
+ *     The latency in nanoseconds
+ */
+void latrecord(int stage, long ns);
+
+/**
+ * Merge the histograms of every thread for a stage.
+ *
+ * @param[in] res
+ *     The histogram to store the merged values in, it is reset first
+ * @param[in] stage
+ *     One of the LAT_* stages
+ */
+void latmerge(LatHist *res, int stage);
+
+/**
+ * Log the count, p50, p99, p99.9 and max of every stage that has recorded
+ * anything.
+ */
+void latreport(void);
+
+/**
+ * Write the merged percentiles of every stage as a JSON object.
+ *
+ * @param[in] f
+ *     The file to write to
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 for an error
+ */
+int latjson(FILE *f);
+
+/**
+ * Clear the histograms of every thread, only call this while no other
+ * thread is recording.
+ */
+void latreset(void);
+
+#endif /* LATENCY_H */
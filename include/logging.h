@@ -22,6 +22,9 @@
 	#define LOG_ERROR(...) logm("ERROR", __FILE__, __LINE__, __VA_ARGS__)
 #endif
 
+/* Statistics like latency percentiles are wanted in release builds too */
+#define LOG_STAT(...) logm("STAT", __FILE__, __LINE__, __VA_ARGS__)
+
 /*** Global variables ***/
 
 /* Variable to check if the log file is Open */
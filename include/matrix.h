@@ -15,7 +15,7 @@
 /*** Defines ***/
 
 /* Helper Macro to get a specific value in the matrix */
-#define GET(mat, x, y) mat->vals[x + y * mat->ncols]
+#define GET(mat, x, y) (mat)->vals[(x) + (y) * (mat)->ncols]
 
 /*** Constants ***/
 
@@ -27,6 +27,7 @@ typedef struct {
 	int nrows;
 	int ncols;
 	double *vals;
+	int alloc; /* ALLOC_* policy of vals, 0 for views and malloc */
 } Matrix;
 
 /*** Function Prototypes ***/
@@ -50,6 +51,21 @@ typedef struct {
  */
 Matrix *initmat(int nrows, int ncols, const double *data, int byrow);
 
+/**
+ * Instantiates a zero Matrix with its values from an ALLOC_* policy, for
+ * big matrices that are worth huge pages or a NUMA placement.
+ *
+ * @param[in] nrows
+ * @param[in] ncols
+ *     The dimension of the matrix
+ * @param[in] policy
+ *     Where the values come from, see alloc.h
+ * @return
+ *     Returns the pointer to the new matrix, mat->alloc is the policy
+ *     that was used
+ */
+Matrix *initmatalloc(int nrows, int ncols, int policy);
+
 /**
  * Free the Matrix.
  *
@@ -76,6 +92,7 @@ int matadd(Matrix *res, int count, ...);
 /**
  * Do standard matrix multiplication on all the matrices in order.
  * Assume order will be mat1 * mat2 ...
+ * Square products from matcrossover() up use Strassen-Winograd.
  *
  * @param[in] res
  *     The matrix to store the results in
@@ -88,30 +105,143 @@ int matadd(Matrix *res, int count, ...);
  */
 int matmult(Matrix *res, const Matrix *mat1, const Matrix *mat2);
 
+/**
+ * Dot product of two vectors, with independent partial sums so the
+ * compiler can keep several SIMD lanes busy at once.
+ *
+ * @param[in] a
+ * @param[in] b
+ *     The vectors, len long
+ * @param[in] len
+ *     The length of the vectors
+ * @return
+ *     Returns the dot product
+ */
+double matdot(const double *a, const double *b, int len);
+
+/**
+ * Matrix-vector product without wrapping the vector in a Matrix. Both
+ * directions read mat along its rows, big products are split over the
+ * thread pool by rows.
+ *
+ * @param[out] res
+ *     The result, mat->nrows long, or mat->ncols long if trans is set
+ * @param[in] mat
+ *     The matrix
+ * @param[in] vec
+ *     The vector, mat->ncols long, or mat->nrows long if trans is set
+ * @param[in] trans
+ *     Boolean to multiply with the transpose of mat instead
+ * @return
+ *     Returns 0 on success
+ */
+int matgemv(double *res, const Matrix *mat, const double *vec, int trans);
+
+/**
+ * Scores many rows of features against many linear models at once,
+ * res = x * coefs^T. A block of rows is kept in registers while it is
+ * scored against every model, so the coefficients are read once per
+ * block instead of once per row. One row against one model is a single
+ * matdot() for live inference.
+ *
+ * @param[out] res
+ *     The predictions, x->nrows x coefs->nrows, one column per model
+ * @param[in] x
+ *     The features, one row per sample
+ * @param[in] coefs
+ *     The models, one row of x->ncols coefficients each, e.g. from trainpath()
+ * @return
+ *     Returns 0 on success
+ */
+int matpredict(Matrix *res, const Matrix *x, const Matrix *coefs);
+
+/**
+ * Set the size from which matmult() uses Strassen-Winograd for square
+ * products, 512 by default. Every level of the recursion does 7 half
+ * size products instead of 8 and stops below the crossover, n0. The error
+ * bound is weaker than the classical n^2 u ||A|| ||B||, normwise
+ *     ||C - fl(AB)|| <= [(n/n0)^log2(18) (n0^2 + 6 n0) - 6n] u ||A|| ||B||
+ * with u the unit roundoff (Higham, Accuracy and Stability of Numerical
+ * Algorithms, ch. 23). The error is spread over all of C, so small values
+ * can lose relative accuracy. Scratch is about 2/3 n^2 doubles on one
+ * thread, about (11 + nthreads * 2/3) (n/2)^2 with the thread pool.
+ *
+ * @param[in] n
+ *     The new crossover, 0 or less to always use the blocked product
+ * @return
+ *     Returns the previous crossover, 0 if it was off
+ */
+int matcrossover(int n);
+
 /**
  * Get the transpose of a matrix
+ * Cache oblivious, big matrices are split in halves until the pieces fit
+ * in cache and are then transposed 4x4 at a time in registers
  *
  * @param[in] res
- *     The matrix to store the new data in
+ *     The matrix to store the new data in, ncols x nrows of mat,
+ *     if it is mat itself matTip() is used
  * @param[in] mat
  *     The matrix to be transposed
  * @return
- *     Returns the resulting transposed matrix as a pointer
+ *     Returns 0 on success
  */
 int matT(Matrix *res, const Matrix *mat);
 
+/**
+ * Transpose a matrix in place without a second buffer.
+ * Square matrices swap blocks across the diagonal, other shapes follow the
+ * cycles of the permutation and need one bit of scratch per value
+ *
+ * @param[in] mat
+ *     The matrix to transpose, its nrows and ncols are swapped
+ * @return
+ *     Returns 0 on success
+ */
+int matTip(Matrix *mat);
+
+/**
+ * Symmetric rank-k update res += mat^T * mat, without forming the transpose.
+ * Blocked and spread over the thread pool, so it can be called once for
+ * every chunk of rows when X^TX is built from data that does not fit in
+ * memory.
+ *
+ * @param[in] res
+ *     The ncols x ncols matrix to add the product to
+ * @param[in] mat
+ *     The rows to add
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 for an error
+ */
+int matsyrk(Matrix *res, const Matrix *mat);
+
 /**
  * Get the Reduced Row Echolon Form of the given matrix.
- * Using the Gauss-Jordan elimination method.
+ * Using the Gauss-Jordan elimination method, a panel of columns at a time
+ * with the rest of the matrix updated by parallel matrix multiplication.
  *
  * @param[in] mat
  *     The matrix to use rref on
  * @return
  *     The rank of the matrix,
- *     Less than zero for an error
+ *     Less than zero for an error, e.g. a block of pivot rows that can't
+ *     be inverted, mat is then only partly reduced
  */
 int rref(Matrix *max);
 
+/**
+ * Get the rank of a matrix without changing it, for when the rref itself
+ * is not needed. LU with partial pivoting on a copy, about 2/3 n^3 flops
+ * against the n^3 of the Gauss-Jordan elimination in rref().
+ *
+ * @param[in] mat
+ *     The matrix to find the rank of
+ * @return
+ *     The numerical rank, pivots of at most EPSILON * max|a| count as 0
+ */
+int matrank(const Matrix *mat);
+
 /**
  * Solves the equation Ax = y for y
  * where A is non-singular
@@ -135,6 +265,51 @@ int rref(Matrix *max);
  */
 int solinv(const Matrix *mat, Matrix *lu, double *res, const double *vec);
 
+/**
+ * Cholesky decomposition A = LL^T of a symmetric positive definite matrix,
+ * done in place. Only the lower triangle of mat is read.
+ *
+ * @param[in] mat
+ *     The A matrix, replaced by L with zeros above the diagonal
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 if A is not positive definite
+ */
+int matchol(Matrix *mat);
+
+/**
+ * Solves Lx = y or L^Tx = y for x in place, where L is lower triangular,
+ * e.g. the result of matchol().
+ *
+ * @param[in] mat
+ *     The L matrix
+ * @param[in] vec
+ *     The y vector, replaced by the x vector
+ * @param[in] trans
+ *     0 to solve with L, 1 to solve with L^T
+ */
+void soltri(const Matrix *mat, double *vec, int trans);
+
+/**
+ * Solves the equation Ax = y for y
+ * where A is symmetric positive definite
+ * Uses Cholesky Decomposition, about twice as fast as solinv()
+ *
+ * @param[in] mat
+ *     The A matrix
+ * @param[in] chol
+ *     NULL if you don't care that I use malloc to allocate space for the
+ *     factor, else a deep copy of mat that will be replaced by L
+ * @param[in] vec
+ *     The y vector
+ * @param[in] res
+ *     The x vector to be solved
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 for an error
+ */
+int solchol(const Matrix *mat, Matrix *chol, double *res, const double *vec);
+
 /**
  * Solves the equation Ax = y for y
  * where A:mxn non-singular x:nx1 y:mx1
@@ -154,28 +329,56 @@ int solgen(const Matrix *mat, double *res, const double *vec);
 
 /**
  * Get the inverse of a Matrix
+ * Factors mat once with LU, then solves for blocks of columns of the
+ * identity in parallel on the thread pool
  *
  * @param[in] res
  *     The results the matrix will be placed in
  * @param[in] mat
- *     The matrix to find a inverse for
+ *     The matrix to find a inverse for, it is left unchanged
  * @return 
  *     Returns 0 for success
- *     Anything less than 0 for an error
+ *     Anything less than 0 for an error, e.g. mat is singular
  */
 int matinv(Matrix *res, Matrix *mat);
 
 /**
  * Gets the Moore-Penrose psuodoinverse Matrix
+ * Uses matsvd(), singular values below max(m, n) * s_max * machine epsilon
+ * are treated as zero so rank deficient matrices work
  *
  * @param[in] res
- *     The results the matrix will be placed in
+ *     The results the matrix will be placed in, ncols x nrows of mat
  * @param[in] mat
- *     The matrix to get the psuodoinverse from
+ *     The matrix to get the psuodoinverse from, it is left unchanged
  * @return
  *     Return 0 for success
  *     Anything less than 0 for an error
  */
 int matginv(Matrix *res, Matrix *mat);
 
+/**
+ * Singular value decomposition A = U S V^T with the one-sided Jacobi
+ * method, the rotations of every round touch disjoint pairs of columns
+ * so they are done in parallel on the thread pool.
+ * Only the economy (k = min(m, n)) or truncated (k < min(m, n)) parts are
+ * computed, which is all PCA needs.
+ *
+ * @param[in] mat
+ *     The m x n A matrix, it is left unchanged
+ * @param[in] k
+ *     The amount of singular values to keep, the biggest ones,
+ *     0 for min(m, n)
+ * @param[out] u
+ *     m x k matrix of left singular vectors, NULL if not needed
+ * @param[out] s
+ *     The k singular values from big to small
+ * @param[out] v
+ *     n x k matrix of right singular vectors, NULL if not needed
+ * @return
+ *     Returns the numerical rank of A
+ *     Anything less than 0 for an error
+ */
+int matsvd(const Matrix *mat, int k, Matrix *u, double *s, Matrix *v);
+
 #endif /* MATRIX_H */
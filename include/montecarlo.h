@@ -0,0 +1,160 @@
+/**
+ * @file    montecarlo.h
+ * @brief   Parallel bootstrap resampling of returns and regression fits
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+
+#include <stdint.h>
+
+/*** Constants ***/
+
+/* Independent xoshiro256** streams stepped together, one per SIMD lane */
+#define MC_LANES 4
+
+/*** Type Definitions ***/
+
+/* MC_LANES xoshiro256** generators with their state stored lane by lane,
+ * so a step is the same few operations on MC_LANES values at a time */
+typedef struct {
+	uint64_t s[4][MC_LANES];
+} McRng;
+
+/* Settings of a bootstrap, fill in with mcdefaults() */
+typedef struct {
+	int nresample;      /* Amount of resamples */
+	int block;          /* Rows per block, 1 for the ordinary bootstrap */
+	unsigned long seed; /* Resample r always draws the same rows for a seed */
+} McOptions;
+
+/*** Function Prototypes ***/
+
+/**
+ * Seeds the generators of one stream. Streams of the same seed are
+ * independent, so work split by stream gives the same numbers on any
+ * amount of threads.
+ *
+ * @param[out] rng
+ *     The generators to seed
+ * @param[in] seed
+ *     The seed of the whole run
+ * @param[in] stream
+ *     Which stream of the seed, e.g. the resample number
+ */
+void mcseed(McRng *rng, unsigned long seed, long stream);
+
+/**
+ * Steps every lane once.
+ *
+ * @param[in] rng
+ *     The generators
+ * @param[out] out
+ *     MC_LANES random 64 bit values
+ */
+void mcnext(McRng *rng, uint64_t *out);
+
+/**
+ * Fill in the usual bootstrap settings.
+ *
+ * @param[out] opt
+ *     The settings to fill in
+ */
+void mcdefaults(McOptions *opt);
+
+/**
+ * The rows drawn by resample r, a circular block bootstrap. Blocks of
+ * block consecutive rows start at uniformly random rows and wrap around
+ * the end, which keeps the autocorrelation within a block.
+ *
+ * @param[out] idx
+ *     The n rows of the resample
+ * @param[in] n
+ *     The amount of rows
+ * @param[in] opt
+ *     The settings, NULL for mcdefaults()
+ * @param[in] r
+ *     Which resample
+ */
+void mcresample(long *idx, long n, const McOptions *opt, long r);
+
+/**
+ * Sharpe ratio, mean over standard deviation per period, of every
+ * resample of a return series. The resamples are split over the thread
+ * pool and read the returns through their rows, nothing is copied.
+ *
+ * @param[in] returns
+ *     The n returns per period
+ * @param[in] n
+ *     The amount of returns
+ * @param[in] opt
+ *     The settings, NULL for mcdefaults()
+ * @param[out] sharpe
+ *     The opt->nresample Sharpe ratios
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 if there are too few returns
+ */
+int mcsharpe(const double *returns, long n, const McOptions *opt, double *sharpe);
+
+/**
+ * Maximum drawdown of the cumulative sum of every resample of a series
+ * of log returns, the largest fall from a peak.
+ *
+ * @param[in] returns
+ *     The n log returns per period
+ * @param[in] n
+ *     The amount of returns
+ * @param[in] opt
+ *     The settings, NULL for mcdefaults()
+ * @param[out] drawdown
+ *     The opt->nresample drawdowns, 0 or more
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 if there are too few returns
+ */
+int mcdrawdown(const double *returns, long n, const McOptions *opt, double *drawdown);
+
+/**
+ * Least squares coefficients of every resample of the rows of a
+ * regression, from the Gram matrix of the drawn rows.
+ *
+ * @param[in] x
+ *     The features, one row per sample
+ * @param[in] y
+ *     The x->nrows targets
+ * @param[in] opt
+ *     The settings, NULL for mcdefaults()
+ * @param[out] coefs
+ *     opt->nresample x x->ncols, the coefficients of one resample per row
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 if a resample is singular
+ */
+int mccoef(const Matrix *x, const double *y, const McOptions *opt, Matrix *coefs);
+
+/**
+ * Percentile confidence interval of a bootstrap distribution.
+ *
+ * @param[in] stats
+ *     The statistic of every resample, e.g. from mcsharpe()
+ * @param[in] count
+ *     The amount of resamples
+ * @param[in] stride
+ *     Distance between two values in stats, 1 for an array or the
+ *     ncols of a column of coefficients from mccoef()
+ * @param[in] level
+ *     The coverage, e.g. 0.95
+ * @param[out] lo
+ * @param[out] hi
+ *     The ends of the interval
+ */
+void mcinterval(const double *stats, int count, int stride, double level, double *lo, double *hi);
+
+#endif /* MONTECARLO_H */
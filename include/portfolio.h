@@ -0,0 +1,97 @@
+/**
+ * @file    portfolio.h
+ * @brief   Mean-variance portfolio weights from an active-set QP solver
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef PORTFOLIO_H
+#define PORTFOLIO_H
+
+/*** Dependencies ***/
+
+#include "symmat.h"
+
+/*** Constants ***/
+
+/* Where every asset is in the active set */
+#define PORT_FREE  0
+#define PORT_LOWER 1 /* Held at its lower limit */
+#define PORT_UPPER 2 /* Held at its upper limit */
+
+/* Active set changes allowed per asset before portsolve() gives up */
+#define PORT_MAX_ITER 4
+
+/*** Type Definitions ***/
+
+/* A portfolio of n assets with its limits and the last solution, which
+ * the next rebalance starts from. Fill in budget, lo and hi after
+ * initport(), the defaults are fully invested and long only */
+typedef struct {
+	int n;
+	double budget;     /* Sum of the weights */
+	double *lo;        /* n lower limits */
+	double *hi;        /* n upper limits */
+	double *weights;   /* n weights of the last solution */
+	int *state;        /* n of PORT_FREE, PORT_LOWER or PORT_UPPER */
+	int solved;        /* Whether weights holds a solution to warm start from */
+	int iters;         /* Active set changes in the last solve */
+
+	/* The free assets in the order of the rows of chol, and the Cholesky
+	 * factor of their block of the covariance. Only the first nfree rows
+	 * of chol are in use */
+	int nfree;
+	int *order;
+	SymMatrix *chol;
+
+	double *work;      /* n doubles of scratch */
+} Portfolio;
+
+/*** Function Prototypes ***/
+
+/**
+ * Instantiates a portfolio, fully invested and long only with no limit
+ * per asset.
+ *
+ * @param[in] n
+ *     The amount of assets
+ * @return
+ *     Returns the pointer to the new portfolio
+ */
+Portfolio *initport(int n);
+
+/**
+ * Free the portfolio.
+ *
+ * @param[in] port
+ *     The portfolio to free
+ */
+void freeport(Portfolio *port);
+
+/**
+ * Finds the weights w that minimize gamma / 2 w^T cov w - mu^T w subject
+ * to sum(w) = budget and lo <= w <= hi, with a primal active-set method.
+ * The free assets solve their KKT system with the Cholesky factor of
+ * their block of cov. An asset that hits a limit is taken out of the
+ * factor and one that leaves a limit is added to it, each an O(nfree^2)
+ * update instead of a new factorization.
+ *
+ * A later call starts from the previous weights and active set, so when
+ * the covariance and predictions move a little between rebalances only a
+ * few assets change state.
+ *
+ * @param[in] port
+ *     The portfolio, its weights are replaced by the solution
+ * @param[in] cov
+ *     The n x n covariance, positive definite, e.g. from covshrink()
+ * @param[in] mu
+ *     The n expected returns
+ * @param[in] gamma
+ *     The risk aversion, more than 0
+ * @return
+ *     Returns the amount of active set changes on success
+ *     Anything less than 0 if the limits can not be met or it did not converge
+ */
+int portsolve(Portfolio *port, const SymMatrix *cov, const double *mu, double gamma);
+
+#endif /* PORTFOLIO_H */
@@ -0,0 +1,145 @@
+/**
+ * @file    symmat.h
+ * @brief   Symmetric matrices stored as their packed lower triangle
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef SYMMAT_H
+#define SYMMAT_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+
+/*** Defines ***/
+
+/* Offset of value (x, y) with x <= y in the packed lower triangle */
+#define SIDX(x, y) ((size_t)(y) * ((y) + 1) / 2 + (x))
+
+/* Helper Macro to get value (x, y) of a symmetric matrix, either triangle */
+#define SGET(sym, x, y) \
+	((sym)->vals[(x) <= (y) ? SIDX(x, y) : SIDX(y, x)])
+
+/*** Type Definitions ***/
+
+/* n x n symmetric matrix, only the lower triangle is stored, row by row.
+ * Row y is the y + 1 values (0, y) .. (y, y) and starts at SIDX(0, y), so
+ * X^TX, covariances and their inverses take n (n + 1) / 2 doubles */
+typedef struct {
+	int n;
+	double *vals;
+} SymMatrix;
+
+/*** Function Prototypes ***/
+
+/**
+ * Instantiates a zeroed symmetric matrix.
+ *
+ * @param[in] n
+ *     The amount of rows and columns
+ * @return
+ *     Returns the pointer to the new matrix
+ */
+SymMatrix *initsym(int n);
+
+/**
+ * Free the symmetric matrix.
+ *
+ * @param[in] sym
+ *     The matrix to free
+ */
+void freesym(SymMatrix *sym);
+
+/**
+ * Copy the lower triangle of a square Matrix into a symmetric matrix.
+ *
+ * @param[in] res
+ *     The symmetric matrix to copy into, the same size as mat
+ * @param[in] mat
+ *     The matrix to copy, the upper triangle is not read
+ */
+void sympack(SymMatrix *res, const Matrix *mat);
+
+/**
+ * Copy a symmetric matrix into both triangles of a Matrix.
+ *
+ * @param[in] res
+ *     The n x n Matrix to copy into
+ * @param[in] sym
+ *     The symmetric matrix to copy
+ */
+void symunpack(Matrix *res, const SymMatrix *sym);
+
+/**
+ * Symmetric rank-1 update A += alpha * x x^T.
+ *
+ * @param[in] sym
+ *     The A matrix
+ * @param[in] alpha
+ *     The scale of the update, negative to downdate
+ * @param[in] vec
+ *     The n values of x
+ */
+void symrank1(SymMatrix *sym, double alpha, const double *vec);
+
+/**
+ * Symmetric rank-k update A += alpha * mat^T * mat, the packed version of
+ * matsyrk() for adding k rows at once. Blocked and spread over the thread
+ * pool like matsyrk().
+ *
+ * @param[in] sym
+ *     The A matrix, the same size as the columns of mat
+ * @param[in] alpha
+ *     The scale of the update, negative to downdate
+ * @param[in] mat
+ *     The k x n rows to add
+ */
+void symrankk(SymMatrix *sym, double alpha, const Matrix *mat);
+
+/**
+ * Symmetric matrix-vector product y = Ax, in one pass over the triangle.
+ *
+ * @param[in] sym
+ *     The A matrix
+ * @param[in] vec
+ *     The n values of x
+ * @param[out] res
+ *     The n values of y, must not overlap x
+ */
+void symmv(const SymMatrix *sym, const double *vec, double *res);
+
+/**
+ * Cholesky decomposition A = LL^T in place, the packed version of matchol().
+ *
+ * @param[in] sym
+ *     The A matrix, replaced by the lower triangle L
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 if A is not positive definite
+ */
+int symchol(SymMatrix *sym);
+
+/**
+ * Solves Lx = y or L^Tx = y for x in place, the packed version of soltri().
+ *
+ * @param[in] chol
+ *     The L factor from symchol()
+ * @param[in] vec
+ *     The y vector, replaced by the x vector
+ * @param[in] trans
+ *     0 to solve with L, 1 to solve with L^T
+ */
+void symsoltri(const SymMatrix *chol, double *vec, int trans);
+
+/**
+ * Solves LL^Tx = y for x in place after symchol().
+ *
+ * @param[in] chol
+ *     The L factor from symchol()
+ * @param[in] vec
+ *     The y vector, replaced by the x vector
+ */
+void symcholsolve(const SymMatrix *chol, double *vec);
+
+#endif /* SYMMAT_H */
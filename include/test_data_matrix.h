@@ -0,0 +1,94 @@
+/**
+ * @file    test_data_matrix.h
+ * @brief   generated data to use with test_matrix.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    20/01/2026
+*/
+
+/*** Test Data ***/
+
+const int SHAPE_A[] = { 3, 3 };
+const int SHAPE_B[] = { 3, 3 };
+const int SHAPE_C[] = { 3, 3 };
+const int SHAPE_D[] = { 3, 3 };
+const int SHAPE_E[] = { 3, 3 };
+const int SHAPE_F[] = { 3, 3 };
+
+const double TEST_DATA_A[] = { 6, -4, 1, -3, 14, 20, -16, -11, 15 };
+const double TEST_DATA_B[] = { -42, 38, 42, -35, -26, -4, 3, -8, 13 };
+const double TEST_DATA_C[] = { 20, 4, -48, 25, -37, -32, -9, -22, 43 };
+const double TEST_DATA_D[] = { 4, -39, 2, -5, -26, 23, 47, 27, -19 };
+const double TEST_DATA_E[] = { -13, -47, -36, -1, -41, -12, 22, 18, -6 };
+const double TEST_DATA_F[] = { -15, 4, -24, 17, -8, 46, 13, -22, -25 };
+
+const double TEST_FDATA_A[] = { 6, -3, -16, -4, 14, -11, 1, 20, 15 };
+const double TEST_FDATA_B[] = { -42, -35, 3, 38, -26, -8, 42, -4, 13 };
+const double TEST_FDATA_C[] = { 20, 25, -9, 4, -37, -22, -48, -32, 43 };
+const double TEST_FDATA_D[] = { 4, -5, 47, -39, -26, 27, 2, 23, -19 };
+const double TEST_FDATA_E[] = { -13, -1, 22, -47, -41, 18, -36, -12, -6 };
+const double TEST_FDATA_F[] = { -15, 17, 13, 4, -8, -22, -24, 46, -25 };
+
+/*** Initialization Test Results ***/
+
+const double INIT_T = 9.907e-06;
+
+/*** Addition Test Results ***/
+
+const double MAT_A_P_B[] = { -36, 34, 43, -38, -12, 16, -13, -19, 28 };
+const double MAT_C_P_C[] = { 40, 8, -96, 50, -74, -64, -18, -44, 86 };
+
+const double ADD_T = 1.5702e-05;
+
+/*** Multiplication Test Results ***/
+
+const double MAT_A_M_C[] = { 11, 150, -117, 110, -970, 556, -730, 13, 1765 };
+const double MAT_B_M_C[] = { -268, -2498, 2606, -1314, 910, 2340, -257, 22, 671 };
+const double MAT_C_M_D[] = { -2196, -2180, 1044, -1219, -877, -193, 2095, 2084, -1341 };
+const double MAT_D_M_A[] = { 109, -584, -746, -320, -597, -180, 505, 399, 302 };
+const double MAT_D_M_B[] = { 1203, 1150, 350, 1189, 302, 193, -2976, 1236, 1619 };
+
+const double MUL_T = 3.0515e-05;
+
+/*** Transpose Test Results ***/
+
+const int SHAPE_A_T[] = { 3, 3 };
+const int SHAPE_B_T[] = { 3, 3 };
+const int SHAPE_C_T[] = { 3, 3 };
+const int SHAPE_D_T[] = { 3, 3 };
+
+const double MAT_A_T[] = { 6, -3, -16, -4, 14, -11, 1, 20, 15 };
+const double MAT_B_T[] = { -42, -35, 3, 38, -26, -8, 42, -4, 13 };
+const double MAT_C_T[] = { 20, 25, -9, 4, -37, -22, -48, -32, 43 };
+const double MAT_D_T[] = { 4, -5, 47, -39, -26, 27, 2, 23, -19 };
+
+const double T_T = 3.744e-06;
+const int RANK_A = 3;
+const int RANK_B = 3;
+const int RANK_C = 3;
+const int RANK_D = 3;
+
+const double RREF_A[] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+const double RREF_B[] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+const double RREF_C[] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+const double RREF_D[] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+
+const double RREF_T = 0.000737736001;
+
+const int CAN_INV_E = 1;
+const int CAN_INV_F = 1;
+
+const double TEST_VEC_E[] = { -7, 20, 42 };
+const double TEST_VEC_F[] = { 15, 21, 25 };
+
+const double SOL_VEC_E[] = { 2.3921241050119333, -0.5668257756563246, 0.07064439140811453 };
+const double SOL_VEC_F[] = { -4.096740273396426, -4.839905362776026, 1.1288117770767616 };
+
+const double NXNSOLVE_T = 9.4722001e-05;
+
+/*** Inverse Test Results ***/
+
+const double INV_E[] = { -0.018377088305489262, 0.0369928400954654, 0.036276849642004776, 0.010739856801909309, -0.03460620525059666, 0.004773269689737472, -0.03516308671439936, 0.031821797931583136, -0.019331742243436756 };
+const double PINV_C[] = { 0.34438775510204134, -0.13265306122449003, 0.2857142857142862, 0.11809723889555843, -0.06422569027611053, 0.08403361344537834, 0.13250300120048042, -0.060624249699880055, 0.12605042016806745 };
+const double SVAL_C[] = { 78.23783712481773, 45.02512779480725, 1.891747628984512 };
+
+const double INV_T = 0.000248644;
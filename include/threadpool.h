@@ -0,0 +1,77 @@
+/**
+ * @file    threadpool.h
+ * @brief   Fork-join thread pool shared by the parallel kernels
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+/*** Type Definitions ***/
+
+/**
+ * Work run on every thread of the pool.
+ *
+ * @param[in] arg
+ *     The argument given to tprun()
+ * @param[in] id
+ *     Index of the thread running the work, 0 is the calling thread
+ * @param[in] nthreads
+ *     The amount of threads running the work
+ */
+typedef void (*TaskFunc)(void *arg, int id, int nthreads);
+
+/*** Function Prototypes ***/
+
+/**
+ * Starts the pool, tprun() calls this with 0 if it was not called yet.
+ *
+ * @param[in] nthreads
+ *     The amount of threads including the calling one,
+ *     0 to use one for every online CPU
+ * @return
+ *     Returns the amount of threads in the pool
+ */
+int tpinit(int nthreads);
+
+/**
+ * Stops and joins all the threads of the pool.
+ */
+void tpfree(void);
+
+/**
+ * Get the amount of threads tprun() will use.
+ *
+ * @return
+ *     Returns the amount of threads, 1 when called from inside a task
+ */
+int tpthreads(void);
+
+/**
+ * Run fn on every thread of the pool and wait for all of them to finish.
+ * Calls made from inside a task run fn on the calling thread only, so
+ * parallel kernels can call each other safely.
+ *
+ * @param[in] fn
+ *     The work to run
+ * @param[in] arg
+ *     Passed through to fn untouched
+ */
+void tprun(TaskFunc fn, void *arg);
+
+/**
+ * Split the range [0, n) evenly over the threads of a task.
+ *
+ * @param[in] n
+ *     The length of the range
+ * @param[in] id
+ * @param[in] nthreads
+ *     As given to the TaskFunc
+ * @param[out] start
+ * @param[out] end
+ *     The part of the range [start, end) that thread id should do
+ */
+void tprange(long n, int id, int nthreads, long *start, long *end);
+
+#endif /* THREADPOOL_H */
@@ -0,0 +1,268 @@
+/**
+ * @file    train.h
+ * @brief   Functions to train linear regression models
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef TRAIN_H
+#define TRAIN_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+
+/*** Constants ***/
+
+/* Rows read from disk at a time by the streaming trainer */
+#define STREAM_CHUNK_ROWS 65536
+
+/* Gradient descent update rules */
+#define GD_SGD      0
+#define GD_MOMENTUM 1
+#define GD_ADAM     2
+
+/* Iterative least squares solvers */
+#define ITER_CG   0
+#define ITER_LSQR 1
+
+/*** Type Definitions ***/
+
+/* Settings of the gradient descent trainer, fill in with gddefaults() */
+typedef struct {
+	int method;      /* GD_SGD, GD_MOMENTUM or GD_ADAM */
+	double rate;     /* Learning rate */
+	double beta1;    /* Momentum, or Adam's first moment decay */
+	double beta2;    /* Adam's second moment decay */
+	double eps;      /* Adam's guard against dividing by zero */
+	int batch;       /* Rows per mini-batch, 0 for the whole data set */
+	int epochs;      /* Passes over the data */
+	unsigned long seed; /* Seed of the shuffle between epochs */
+} GDOptions;
+
+/* Settings of a regularization path, fill in with pathdefaults() */
+typedef struct {
+	double alpha;    /* 1 for lasso, 0 for ridge, elastic net in between */
+	int nlambda;     /* Amount of lambdas on the path */
+	double ratio;    /* Smallest lambda as a fraction of the largest one */
+	double tol;      /* Stop once no coefficient moves the loss this much */
+	int maxiter;     /* Maximum coordinate descent sweeps per lambda */
+} PathOptions;
+
+/* Settings of the iterative solvers, fill in with iterdefaults() */
+typedef struct {
+	int method;      /* ITER_CG or ITER_LSQR */
+	double lambda;   /* Ridge penalty, the same scale as trainridge() */
+	double tol;      /* Relative size of the normal equations residual to stop at */
+	int maxiter;     /* Maximum iterations */
+	int precond;     /* Scale by the column norms, Jacobi preconditioning */
+} IterOptions;
+
+/*** Function Prototypes ***/
+
+/**
+ * Builds the Gram matrix Z^TZ of a data store file chunk by chunk, where
+ * Z = [X y] is every row of the file. Memory use only depends on the
+ * chunk size, the next chunk is read while the current one is added.
+ *
+ * @param[in] path
+ *     The data store file, written with savemat()
+ * @param[in] gram
+ *     ncols x ncols matrix to store Z^TZ in, it is overwritten
+ * @param[in] chunkrows
+ *     The amount of rows to keep in memory at a time,
+ *     0 for STREAM_CHUNK_ROWS
+ * @return
+ *     Returns the amount of rows read
+ *     -1 for an error
+ */
+long gramstream(const char *path, Matrix *gram, long chunkrows);
+
+/**
+ * Solves the normal equations X^TX b = X^Ty for b from the Gram matrix
+ * of Z = [X y].
+ *
+ * @param[in] gram
+ *     The (p+1)x(p+1) Gram matrix Z^TZ
+ * @param[out] coef
+ *     The p coefficients b
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 for an error, e.g. X^TX is singular
+ */
+int gramsolve(const Matrix *gram, double *coef);
+
+/**
+ * Fit a linear model with the LSE method on a data store file that does
+ * not have to fit in memory. The last column of the file is y and all the
+ * other columns are X, add a column of ones to the file for an intercept.
+ *
+ * @param[in] path
+ *     The data store file, written with savemat()
+ * @param[out] coef
+ *     The ncols - 1 coefficients of the model
+ * @param[in] chunkrows
+ *     The amount of rows to keep in memory at a time,
+ *     0 for STREAM_CHUNK_ROWS
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 for an error
+ */
+int trainstream(const char *path, double *coef, long chunkrows);
+
+/**
+ * Fill in the usual settings for a gradient descent update rule.
+ *
+ * @param[out] opt
+ *     The settings to fill in
+ * @param[in] method
+ *     GD_SGD, GD_MOMENTUM or GD_ADAM
+ */
+void gddefaults(GDOptions *opt, int method);
+
+/**
+ * Fit a linear model by minimizing the mean squared error with mini-batch
+ * gradient descent. The gradient X^T(Xb - y) of every batch is found in a
+ * single pass over its rows, split over the thread pool, without forming
+ * the residual or the transpose. Batches are drawn through a shuffled
+ * index, the rows of X are never copied.
+ *
+ * @param[in] x
+ *     The features, one row per sample
+ * @param[in] y
+ *     The targets, x->nrows long
+ * @param[in,out] coef
+ *     The x->ncols coefficients, used as the starting point
+ * @param[in] opt
+ *     The settings, NULL for gddefaults() with GD_ADAM
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 if the training diverged
+ */
+int traingd(const Matrix *x, const double *y, double *coef, const GDOptions *opt);
+
+/**
+ * Fill in the usual settings for a regularization path.
+ *
+ * @param[out] opt
+ *     The settings to fill in
+ * @param[in] alpha
+ *     1 for lasso, 0 for ridge, elastic net in between
+ */
+void pathdefaults(PathOptions *opt, double alpha);
+
+/**
+ * Fit a ridge regression from the Gram matrix of Z = [X y], minimizing
+ * ||y - Xb||^2 / 2n + lambda ||b||^2 / 2 with a Cholesky solve of
+ * (X^TX + n lambda I) b = X^Ty. Every coefficient is penalized, center the
+ * data first if the intercept should not be.
+ *
+ * @param[in] gram
+ *     The (p+1)x(p+1) Gram matrix Z^TZ, e.g. from gramstream() or matsyrk()
+ * @param[in] nrows
+ *     The amount of rows n that went into the Gram matrix
+ * @param[in] lambda
+ *     The strength of the penalty
+ * @param[out] coef
+ *     The p coefficients
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 for an error
+ */
+int trainridge(const Matrix *gram, long nrows, double lambda, double *coef);
+
+/**
+ * Fit the elastic net ||y - Xb||^2 / 2n + lambda (alpha ||b||_1
+ * + (1 - alpha) ||b||^2 / 2) for a whole path of decreasing lambdas.
+ * Uses coordinate descent over the cached Gram matrix, updating the
+ * gradient X^T(y - Xb) only for coefficients that change. Every lambda
+ * starts from the previous solution and only sweeps the coefficients that
+ * survive the strong rule, the rest are checked once at the end.
+ *
+ * @param[in] gram
+ *     The (p+1)x(p+1) Gram matrix Z^TZ of Z = [X y]
+ * @param[in] nrows
+ *     The amount of rows n that went into the Gram matrix
+ * @param[in] opt
+ *     The settings, NULL for pathdefaults() with lasso
+ * @param[out] lambdas
+ *     The opt->nlambda lambdas of the path, largest first
+ * @param[out] coefs
+ *     nlambda x p matrix, row k holds the coefficients for lambdas[k]
+ * @return
+ *     Returns the amount of lambdas fitted
+ *     -1 for an error
+ */
+int trainpath(const Matrix *gram, long nrows, const PathOptions *opt,
+			  double *lambdas, Matrix *coefs);
+
+/**
+ * k-fold cross validation of ridge regression over a list of lambdas,
+ * lambda 0 being plain LSE. The Gram block of every fold is built once,
+ * the training system of a fold is the full Gram matrix minus its block
+ * and the held out error comes from the block alone, so the rows are only
+ * read once however many folds and lambdas there are. The folds are
+ * contiguous runs of rows, which keeps time series in order, and are
+ * built and solved in parallel on the thread pool.
+ *
+ * @param[in] z
+ *     The data Z = [X y], one row per sample with y in the last column
+ * @param[in] nfolds
+ *     The amount of folds, at least 2
+ * @param[in] lambdas
+ *     The ridge penalties to try
+ * @param[in] nlambda
+ *     The amount of lambdas
+ * @param[out] cverr
+ *     The mean squared held out error of every lambda, NULL if not needed
+ * @param[out] coef
+ *     The ncols - 1 coefficients refit on all the rows with the best
+ *     lambda, NULL if not needed
+ * @return
+ *     Returns the index of the lambda with the lowest error
+ *     -1 for an error
+ */
+int traincv(const Matrix *z, int nfolds, const double *lambdas, int nlambda,
+			double *cverr, double *coef);
+
+/**
+ * Fill in the usual settings for the iterative solvers.
+ *
+ * @param[out] opt
+ *     The settings to fill in
+ * @param[in] method
+ *     ITER_CG or ITER_LSQR
+ */
+void iterdefaults(IterOptions *opt, int method);
+
+/**
+ * Fit the ridge regression ||y - Xb||^2 / 2n + lambda ||b||^2 / 2 of
+ * trainridge() without ever forming X^TX, for when p is too large to
+ * factor. X is only touched through products split over the thread pool.
+ *
+ * ITER_CG runs preconditioned conjugate gradients on the normal equations.
+ * Each iteration is one pass over the rows that adds x_i (x_i . v) to find
+ * X^TXv, the same fused pass also yields X^Ty and the diagonal of X^TX on
+ * the first iteration. ITER_LSQR runs Paige and Saunders' LSQR on the
+ * stacked [X; sqrt(n lambda) I], which takes two passes per iteration, one
+ * for Xv and one for X^Tu, but does not square the condition number of X.
+ *
+ * Both stop once ||X^T(y - Xb) - n lambda b|| <= tol ||X^Ty|| for CG, or
+ * its LSQR estimate relative to ||X|| ||y - Xb||.
+ *
+ * @param[in] x
+ *     The features, one row per sample
+ * @param[in] y
+ *     The targets, x->nrows long
+ * @param[in,out] coef
+ *     The x->ncols coefficients, used as the starting point so a refit
+ *     starts from the last solution
+ * @param[in] opt
+ *     The settings, NULL for iterdefaults() with ITER_CG
+ * @return
+ *     Returns the amount of iterations on success
+ *     Anything less than 0 if it did not converge in opt->maxiter
+ */
+int trainiter(const Matrix *x, const double *y, double *coef, const IterOptions *opt);
+
+#endif /* TRAIN_H */
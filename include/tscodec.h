@@ -0,0 +1,115 @@
+/**
+ * @file    tscodec.h
+ * @brief   Compressed time series files of ticks and candles
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+#ifndef TSCODEC_H
+#define TSCODEC_H
+
+/*** Dependencies ***/
+
+#include "matrix.h"
+
+/*** Constants ***/
+
+/* Magic bytes at the start of every compressed time series file */
+#define TSC_MAGIC "TBOTTSC1"
+#define TSC_MAGIC_LEN 8
+
+/* Rows per block, the smallest piece of a file that can be decoded */
+#define TSC_BLOCK_ROWS 4096
+
+/*** Type Definitions ***/
+
+/* Header of a compressed time series file, the block index of nblocks
+ * entries follows directly after it and then the blocks */
+typedef struct {
+	char magic[TSC_MAGIC_LEN];
+	long nrows;
+	long ncols;
+	long blockrows;
+	long nblocks;
+} TscHeader;
+
+/* Where a block is in the file and the timestamps it covers */
+typedef struct {
+	double first;   /* Timestamp of the first row */
+	double last;    /* Timestamp of the last row */
+	long offset;    /* Bytes from the start of the file */
+	long nbytes;
+} TscBlock;
+
+/* A compressed time series file opened for reading ranges on demand */
+typedef struct {
+	int fd;
+	long nrows;
+	long ncols;
+	long blockrows;
+	long nblocks;
+	TscBlock *index;
+} TscFile;
+
+/*** Function Prototypes ***/
+
+/**
+ * Writes a time series to a compressed file in the style of Facebook's
+ * Gorilla. Column 0 holds the timestamps, stored as delta-of-deltas so a
+ * regular interval costs a bit per row. The other columns are stored as
+ * the XOR with the previous value of the column, which only keeps the
+ * bits that changed. Every block of rows stores its columns as separate
+ * streams so they can be decoded in parallel.
+ *
+ * @param[in] path
+ *     The file to write to, it is truncated if it exists
+ * @param[in] mat
+ *     The rows to store, column 0 must be whole and non decreasing
+ *     timestamps, e.g. seconds or milliseconds since the epoch
+ * @param[in] blockrows
+ *     Rows per block, 0 for TSC_BLOCK_ROWS
+ * @return
+ *     Returns 0 on success
+ *     Anything less than 0 for an error
+ */
+int tscsave(const char *path, const Matrix *mat, long blockrows);
+
+/**
+ * Opens a compressed time series file and reads its block index.
+ *
+ * @param[in] path
+ *     The file written with tscsave()
+ * @return
+ *     Returns the pointer to the opened file,
+ *     NULL if the file could not be read, is not a time series file or
+ *     its block index is damaged
+ */
+TscFile *tscopen(const char *path);
+
+/**
+ * Close a compressed time series file.
+ *
+ * @param[in] tf
+ *     The file to close
+ */
+void tscclose(TscFile *tf);
+
+/**
+ * Decodes the rows with from <= timestamp < to. Only the blocks that
+ * overlap the range are read, found with a binary search of the index.
+ * Safe to call from several threads at the same time.
+ *
+ * @param[in] tf
+ *     The opened file
+ * @param[in] from
+ *     The first timestamp to include, -HUGE_VAL for the start of the file
+ * @param[in] to
+ *     The timestamp to stop before, HUGE_VAL for the end of the file
+ * @return
+ *     Returns the pointer to a new matrix of the rows in the range,
+ *     NULL if there are none or the blocks could not be read or are
+ *     damaged
+ */
+Matrix *tscload(const TscFile *tf, double from, double to);
+
+#endif /* TSCODEC_H */
@@ -0,0 +1,233 @@
+/**
+ * @file    alloc.c
+ * @brief   Huge page and NUMA aware memory for big matrices
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "alloc.h"
+#include "error.h"
+#include "logging.h"
+#include "threadpool.h"
+
+/*** System Includes ***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*** Defines ***/
+
+#define PAGE_4K (1UL << 12)
+#define HUGE_2M (1UL << 21)
+#define HUGE_1G (1UL << 30)
+
+/* Room in front of the values for the Mapping, keeps them cache aligned */
+#define ALLOC_HEAD 64
+
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << 26)
+#endif
+
+/* From linux/mempolicy.h, mbind is called without libnuma */
+#define MPOL_BIND_MODE       2
+#define MPOL_INTERLEAVE_MODE 3
+
+/*** Type Definitions ***/
+
+/* Stored right in front of mapped values so freevals() needs no size */
+typedef struct {
+	void *base;
+	size_t len;
+} Mapping;
+
+/* A mapping being touched for the first time by the threads */
+typedef struct {
+	char *base;
+	size_t rowbytes;
+	long nrows;
+} TouchArgs;
+
+/*** Helper Functions ***/
+
+static inline size_t roundup(size_t len, size_t to)
+{
+	return (len + to - 1) / to * to;
+}
+
+/* Bit mask of the online nodes from a list like "0-1,3" */
+static unsigned long onlinenodes(void)
+{
+	FILE *file = fopen("/sys/devices/system/node/online", "r");
+	unsigned long mask = 0;
+	int lo, hi, i;
+	char sep;
+
+	if (!file) return 1;
+	while (fscanf(file, "%d", &lo) == 1) {
+		hi = lo;
+		if (fscanf(file, "%c", &sep) == 1 && sep == '-') {
+			if (fscanf(file, "%d", &hi) != 1) break;
+			if (fscanf(file, "%c", &sep) != 1) sep = '\n';
+		}
+		for (i = lo; i <= hi && i < 64; i++) mask |= 1UL << i;
+		if (sep != ',') break;
+	}
+	fclose(file);
+	return mask ? mask : 1;
+}
+
+/* Interleaves or binds the mapping, before any page of it is touched,
+ * 0 on success and -1 if the pages keep the default placement */
+static int place(void *base, size_t len, int policy)
+{
+	unsigned long nodes = onlinenodes(), mask;
+	int node = ALLOC_NODE(policy), mode;
+
+	if (policy & ALLOC_INTERLEAVE) {
+		mode = MPOL_INTERLEAVE_MODE;
+		mask = nodes;
+	} else {
+		mode = MPOL_BIND_MODE;
+		mask = (node >= 0 && node < 64) ? (1UL << node) & nodes : 0;
+		if (!mask) {
+			LOG_WARN("Node %d is not online, using the default placement\n", node);
+			return -1;
+		}
+	}
+
+	if (syscall(SYS_mbind, base, len, mode, &mask, sizeof(mask) * 8, 0)) {
+		LOG_WARN("mbind failed, using the default placement\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* Writes one byte of every page that starts in the rows of the thread,
+ * the kernel zeroes the page on the fault, the first page with the
+ * Mapping goes to the thread of the first rows */
+static void touchrows(void *arg, int id, int nthreads)
+{
+	TouchArgs *a = arg;
+	long start, end;
+	size_t page, last;
+
+	tprange(a->nrows, id, nthreads, &start, &end);
+	if (start >= end) return;
+	page = start ? roundup(ALLOC_HEAD + start * a->rowbytes, PAGE_4K) : 0;
+	last = ALLOC_HEAD + end * a->rowbytes;
+	for (; page < last; page += PAGE_4K) a->base[page] = 0;
+}
+
+/* 1GB pages only come from the pool reserved at boot, NULL if it is empty */
+static void *map1g(size_t *len)
+{
+	void *base;
+
+	*len = roundup(*len, HUGE_1G);
+	base = mmap(NULL, *len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+	return (base == MAP_FAILED) ? NULL : base;
+}
+
+/* Anonymous memory in ordinary pages, for a NUMA placement on its own */
+static void *map4k(size_t *len)
+{
+	void *base;
+
+	*len = roundup(*len, PAGE_4K);
+	base = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) DIE("mmap");
+	return base;
+}
+
+/* 2MB aligned anonymous memory the kernel is asked to back with huge
+ * pages, an extra 2MB is mapped and the unaligned ends are given back */
+static void *map2m(size_t *len)
+{
+	char *base, *aligned;
+	size_t head;
+
+	*len = roundup(*len, HUGE_2M);
+	base = mmap(NULL, *len + HUGE_2M, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) DIE("mmap");
+
+	aligned = (char *)roundup((size_t)base, HUGE_2M);
+	head = aligned - base;
+	if (head) munmap(base, head);
+	munmap(aligned + *len, HUGE_2M - head);
+
+	if (madvise(aligned, *len, MADV_HUGEPAGE)) {
+		LOG_WARN("Transparent huge pages are not available\n");
+	}
+	return aligned;
+}
+
+/* Zeroed and cache aligned like the mapped values */
+static double *mallocvals(int nrows, int ncols, int *policy)
+{
+	size_t bytes = roundup((size_t)nrows * ncols * sizeof(double), ALLOC_HEAD);
+	double *vals = aligned_alloc(ALLOC_HEAD, bytes ? bytes : ALLOC_HEAD);
+	if (!vals) DIE("aligned_alloc");
+	memset(vals, 0, bytes);
+	*policy = ALLOC_MALLOC;
+	return vals;
+}
+
+/*** Public Functions ***/
+
+double *allocvals(int nrows, int ncols, int *policy)
+{
+	size_t bytes = (size_t)nrows * ncols * sizeof(double);
+	size_t len = bytes + ALLOC_HEAD;
+	Mapping *map;
+	char *base = NULL;
+
+	if (*policy == ALLOC_MALLOC || bytes < ALLOC_MIN_BYTES)
+		return mallocvals(nrows, ncols, policy);
+
+	LOG_INFO("Mapping %zu bytes with policy %#x...\n", bytes, *policy);
+	if ((*policy & ALLOC_PAGES) == ALLOC_HUGE1G && !(base = map1g(&len))) {
+		LOG_WARN("No 1GB pages reserved, using 2MB pages\n");
+		*policy = (*policy & ~ALLOC_PAGES) | ALLOC_HUGE;
+		len = bytes + ALLOC_HEAD;
+	}
+	if (!base) base = (*policy & ALLOC_PAGES) ? map2m(&len) : map4k(&len);
+	if ((*policy & ALLOC_NUMA) && place(base, len, *policy)) {
+		/* Without the placement ordinary pages are what malloc gives */
+		*policy &= ALLOC_PAGES;
+		if (!*policy) {
+			munmap(base, len);
+			return mallocvals(nrows, ncols, policy);
+		}
+	}
+
+	/* The threads fault the pages in, each on its own rows */
+	TouchArgs args = { base, (size_t)ncols * sizeof(double), nrows };
+	if (bytes >= ALLOC_MIN_BYTES * 4) tprun(touchrows, &args);
+	else                              touchrows(&args, 0, 1);
+
+	map = (Mapping *)base;
+	map->base = base;
+	map->len = len;
+
+	LOG_INFO("Mapped %zu bytes\n", len);
+	return (double *)(base + ALLOC_HEAD);
+}
+
+void freevals(double *vals, int policy)
+{
+	if (policy == ALLOC_MALLOC) {
+		free(vals);
+		return;
+	}
+
+	Mapping *map = (Mapping *)((char *)vals - ALLOC_HEAD);
+	munmap(map->base, map->len);
+}
@@ -0,0 +1,146 @@
+/**
+ * @file    bars.c
+ * @brief   Streaming tick to bar resampling at several timeframes
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "bars.h"
+#include "error.h"
+#include "latency.h"
+#include "logging.h"
+
+/*** System Includes ***/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+/*** Helper Functions ***/
+
+/* Append a completed bar to its ring, at row count % cap and cap rows
+ * further, then leave the open bar empty so any next trade starts one */
+static void barclose(BarAgg *agg, int ring, OpenBar *bar)
+{
+	long row = (long)ring * 2 * agg->cap + agg->count[ring] % agg->cap;
+	double *first = &GET(agg->rings, 0, row);
+	double *second = &GET(agg->rings, 0, row + agg->cap);
+	int c;
+
+	first[BAR_TIME] = bar->start;
+	first[BAR_OPEN] = bar->open;
+	first[BAR_HIGH] = bar->high;
+	first[BAR_LOW] = bar->low;
+	first[BAR_CLOSE] = bar->close;
+	first[BAR_VOLUME] = bar->volume;
+	first[BAR_VWAP] = (bar->volume > 0) ? bar->pv / bar->volume : bar->close;
+	for (c = 0; c < BAR_COLS; c++) second[c] = first[c];
+
+	agg->count[ring]++;
+	bar->start = bar->end = -INFINITY;
+}
+
+/*** Public Functions ***/
+
+BarAgg *initbars(int nsyms, int nframes, const double *frames, int cap)
+{
+	LOG_INFO("Creating bars of %d symbols at %d timeframes...\n", nsyms, nframes);
+	assert(nsyms > 0 && nframes > 0 && cap > 0);
+
+	BarAgg *agg = malloc(sizeof(BarAgg));
+	long i;
+	int f;
+	if (!agg) DIE("malloc");
+
+	agg->nsyms = nsyms;
+	agg->nframes = nframes;
+	agg->cap = cap;
+	if (!(agg->frames = malloc(sizeof(double) * nframes))) DIE("malloc");
+	if (!(agg->open = calloc((size_t)nsyms * nframes, sizeof(OpenBar)))) DIE("calloc");
+	if (!(agg->count = calloc((size_t)nsyms * nframes, sizeof(long)))) DIE("calloc");
+	for (f = 0; f < nframes; f++) {
+		assert(frames[f] > 0);
+		agg->frames[f] = frames[f];
+	}
+	for (i = 0; i < (long)nsyms * nframes; i++)
+		agg->open[i].start = agg->open[i].end = -INFINITY;
+	agg->rings = initmat(nsyms * nframes * 2 * cap, BAR_COLS, NULL, 1);
+
+	LOG_INFO("Succesfully created bars\n");
+	return agg;
+}
+
+void freebars(BarAgg *agg)
+{
+	freemat(agg->rings);
+	free(agg->frames);
+	free(agg->open);
+	free(agg->count);
+	free(agg);
+}
+
+void barstick(BarAgg *agg, int sym, double time, double price, double qty)
+{
+	OpenBar *bar = &agg->open[(long)sym * agg->nframes];
+	int f, ring = sym * agg->nframes;
+	assert(sym >= 0 && sym < agg->nsyms);
+
+	for (f = 0; f < agg->nframes; f++, bar++, ring++) {
+		/* Only a trade past the period pays for the division */
+		if (time >= bar->end) {
+			if (bar->end != bar->start) barclose(agg, ring, bar);
+			bar->start = floor(time / agg->frames[f]) * agg->frames[f];
+			bar->end = bar->start + agg->frames[f];
+			bar->open = bar->high = bar->low = price;
+			bar->volume = bar->pv = 0;
+		}
+		if (price > bar->high) bar->high = price;
+		if (price < bar->low) bar->low = price;
+		bar->close = price;
+		bar->volume += qty;
+		bar->pv += price * qty;
+	}
+}
+
+void barsfeed(BarAgg *agg, const Matrix *ticks)
+{
+	LOG_DEBUG("Adding %d ticks to the bars\n", ticks->nrows);
+	assert(ticks->ncols == TICK_COLS);
+	LATENCY_START(start);
+
+	const double *row = ticks->vals;
+	int i;
+	for (i = 0; i < ticks->nrows; i++, row += TICK_COLS)
+		barstick(agg, (int)row[TICK_SYM], row[TICK_TIME], row[TICK_PRICE], row[TICK_QTY]);
+
+	LATENCY_STOP(LAT_DATA, start);
+}
+
+void barsflush(BarAgg *agg, double time)
+{
+	long ring, nrings = (long)agg->nsyms * agg->nframes;
+	OpenBar *bar = agg->open;
+
+	for (ring = 0; ring < nrings; ring++, bar++)
+		if (bar->end != bar->start && time >= bar->end) barclose(agg, ring, bar);
+}
+
+int barslast(const BarAgg *agg, int sym, int frame, int k, Matrix *view)
+{
+	int ring = sym * agg->nframes + frame;
+	long next = agg->count[ring] % agg->cap;
+	assert(sym >= 0 && sym < agg->nsyms && frame >= 0 && frame < agg->nframes);
+	assert(k >= 0 && k <= agg->cap);
+
+	if (k > agg->count[ring]) k = agg->count[ring];
+
+	/* The rows before next + cap are the newest bars whether or not the
+	 * ring has wrapped, both copies of a row are the same bar */
+	view->nrows = k;
+	view->ncols = BAR_COLS;
+	view->vals = &GET(agg->rings, 0, (long)ring * 2 * agg->cap + next + agg->cap - k);
+	view->alloc = 0;
+	return k;
+}
@@ -0,0 +1,387 @@
+/**
+ * @file    batch.c
+ * @brief   Batches of small same-size matrices solved all at once
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "batch.h"
+#include "error.h"
+#include "latency.h"
+#include "logging.h"
+#include "threadpool.h"
+
+/*** System Includes ***/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+/* Alignment of the values, one cache line */
+#define BATCH_ALIGN 64
+
+/* Below this much work (stride * n^3) the tiles are done serially */
+#define BATCH_PARALLEL_WORK (1L << 22)
+
+/*** Helper Functions ***/
+
+/* Count the failed lanes and report them to the caller */
+static int countbad(const int *bad, int count, int *status)
+{
+	int b, nbad = 0;
+	for (b = 0; b < count; b++) {
+		nbad += bad[b];
+		if (status) status[b] = bad[b] ? -1 : 0;
+	}
+	return nbad;
+}
+
+/* The kernels work on one tile of BATCH_LANES matrices at a time, a tile
+ * of 16x16 matrices is 16KB of contiguous memory so it stays in L1 for the
+ * whole factorization. The lane loops have a fixed trip count and compile
+ * to plain vector code */
+
+static void lutile(double *a, int n, int *piv, int *bad)
+{
+	int i, j, k, b, p;
+	double best[BATCH_LANES], inv[BATCH_LANES], temp;
+	double *akk, *aik, *akj, *aij, *ap;
+
+	for (k = 0; k < n; k++, piv += BATCH_LANES) {
+		/* Every lane picks its own pivot, branch free so it vectorizes */
+		akk = LANES(a, n, k, k);
+		for (b = 0; b < BATCH_LANES; b++) {
+			best[b] = fabs(akk[b]);
+			piv[b] = k;
+		}
+		for (i = k + 1; i < n; i++) {
+			aik = LANES(a, n, k, i);
+			for (b = 0; b < BATCH_LANES; b++) {
+				p = fabs(aik[b]) > best[b];
+				best[b] = p ? fabs(aik[b]) : best[b];
+				piv[b] = p ? i : piv[b];
+			}
+		}
+
+		/* The swaps differ per lane, they are only O(n) per column */
+		for (b = 0; b < BATCH_LANES; b++) {
+			if ((p = piv[b]) == k) continue;
+			for (j = 0; j < n; j++) {
+				akj = LANES(a, n, j, k) + b;
+				ap = LANES(a, n, j, p) + b;
+				temp = *akj; *akj = *ap; *ap = temp;
+			}
+		}
+
+		/* A pivot below EPSILON marks the lane and leaves its values finite */
+		for (b = 0; b < BATCH_LANES; b++) {
+			bad[b] |= (best[b] <= EPSILON);
+			inv[b] = (best[b] <= EPSILON) ? 0 : 1 / akk[b];
+		}
+
+		for (i = k + 1; i < n; i++) {
+			aik = LANES(a, n, k, i);
+			for (b = 0; b < BATCH_LANES; b++) aik[b] *= inv[b];
+			for (j = k + 1; j < n; j++) {
+				akj = LANES(a, n, j, k);
+				aij = LANES(a, n, j, i);
+				for (b = 0; b < BATCH_LANES; b++) aij[b] -= aik[b] * akj[b];
+			}
+		}
+	}
+}
+
+static void lusolvetile(const double *lu, int n, const int *piv, double *x, int m)
+{
+	int i, j, k, b, p;
+	double inv[BATCH_LANES], temp;
+	const double *l, *d;
+	double *xi, *xk;
+
+	for (k = 0; k < n; k++, piv += BATCH_LANES)
+		for (b = 0; b < BATCH_LANES; b++) {
+			if ((p = piv[b]) == k) continue;
+			for (j = 0; j < m; j++) {
+				xk = LANES(x, m, j, k) + b;
+				xi = LANES(x, m, j, p) + b;
+				temp = *xk; *xk = *xi; *xi = temp;
+			}
+		}
+
+	/* Forward with the unit lower triangle */
+	for (i = 1; i < n; i++)
+		for (k = 0; k < i; k++) {
+			l = LANES(lu, n, k, i);
+			for (j = 0; j < m; j++) {
+				xi = LANES(x, m, j, i);
+				xk = LANES(x, m, j, k);
+				for (b = 0; b < BATCH_LANES; b++) xi[b] -= l[b] * xk[b];
+			}
+		}
+
+	/* Back with the upper triangle */
+	for (i = n - 1; i >= 0; i--) {
+		for (k = i + 1; k < n; k++) {
+			l = LANES(lu, n, k, i);
+			for (j = 0; j < m; j++) {
+				xi = LANES(x, m, j, i);
+				xk = LANES(x, m, j, k);
+				for (b = 0; b < BATCH_LANES; b++) xi[b] -= l[b] * xk[b];
+			}
+		}
+		d = LANES(lu, n, i, i);
+		for (b = 0; b < BATCH_LANES; b++) inv[b] = (fabs(d[b]) <= EPSILON) ? 0 : 1 / d[b];
+		for (j = 0; j < m; j++) {
+			xi = LANES(x, m, j, i);
+			for (b = 0; b < BATCH_LANES; b++) xi[b] *= inv[b];
+		}
+	}
+}
+
+static void choltile(double *a, int n, int *bad)
+{
+	int i, j, k, b;
+	double inv[BATCH_LANES];
+	double *ajj, *aij, *ajk, *aik;
+
+	for (j = 0; j < n; j++) {
+		ajj = LANES(a, n, j, j);
+		for (k = 0; k < j; k++) {
+			ajk = LANES(a, n, k, j);
+			for (b = 0; b < BATCH_LANES; b++) ajj[b] -= ajk[b] * ajk[b];
+		}
+
+		/* A lane that is not positive definite is marked and carries on
+		 * with a unit pivot so the other lanes are not held back */
+		for (b = 0; b < BATCH_LANES; b++) {
+			bad[b] |= !(ajj[b] > 0);
+			ajj[b] = (ajj[b] > 0) ? sqrt(ajj[b]) : 1;
+			inv[b] = 1 / ajj[b];
+		}
+
+		for (i = j + 1; i < n; i++) {
+			aij = LANES(a, n, j, i);
+			for (k = 0; k < j; k++) {
+				aik = LANES(a, n, k, i);
+				ajk = LANES(a, n, k, j);
+				for (b = 0; b < BATCH_LANES; b++) aij[b] -= aik[b] * ajk[b];
+			}
+			for (b = 0; b < BATCH_LANES; b++) aij[b] *= inv[b];
+			memset(LANES(a, n, i, j), 0, sizeof(double) * BATCH_LANES);
+		}
+	}
+}
+
+static void cholsolvetile(const double *l, int n, double *x, int m)
+{
+	int i, j, k, b;
+	const double *lik;
+	double *xi, *xk;
+
+	/* Forward with L */
+	for (i = 0; i < n; i++) {
+		for (k = 0; k < i; k++) {
+			lik = LANES(l, n, k, i);
+			for (j = 0; j < m; j++) {
+				xi = LANES(x, m, j, i);
+				xk = LANES(x, m, j, k);
+				for (b = 0; b < BATCH_LANES; b++) xi[b] -= lik[b] * xk[b];
+			}
+		}
+		lik = LANES(l, n, i, i);
+		for (j = 0; j < m; j++) {
+			xi = LANES(x, m, j, i);
+			for (b = 0; b < BATCH_LANES; b++) xi[b] /= lik[b];
+		}
+	}
+
+	/* Back with L^T, column i of L^T is row i of L */
+	for (i = n - 1; i >= 0; i--) {
+		lik = LANES(l, n, i, i);
+		for (j = 0; j < m; j++) {
+			xi = LANES(x, m, j, i);
+			for (b = 0; b < BATCH_LANES; b++) xi[b] /= lik[b];
+		}
+		for (k = 0; k < i; k++) {
+			lik = LANES(l, n, k, i);
+			for (j = 0; j < m; j++) {
+				xi = LANES(x, m, j, i);
+				xk = LANES(x, m, j, k);
+				for (b = 0; b < BATCH_LANES; b++) xk[b] -= lik[b] * xi[b];
+			}
+		}
+	}
+}
+
+/* Tiles are independent, big batches deal them out over the thread pool */
+typedef struct {
+	int op;
+	MatBatch *mat;
+	MatBatch *vec;
+	int *pivots;
+	int *bad;
+} BatchArgs;
+
+enum { BATCH_LU, BATCH_LUSOLVE, BATCH_CHOL, BATCH_CHOLSOLVE };
+
+static void batchtiles(void *arg, int id, int nthreads)
+{
+	BatchArgs *a = arg;
+	long start, end, t;
+
+	int n = a->mat->nrows;
+	int m = a->vec ? a->vec->ncols : 0;
+
+	tprange(a->mat->stride / BATCH_LANES, id, nthreads, &start, &end);
+	for (t = start; t < end; t++) {
+		int *piv = a->pivots ? &a->pivots[t * n * BATCH_LANES] : NULL;
+		int *bad = a->bad ? &a->bad[t * BATCH_LANES] : NULL;
+		double *mat = TILE(a->mat, t);
+		double *vec = a->vec ? TILE(a->vec, t) : NULL;
+
+		switch (a->op) {
+		case BATCH_LU:        lutile(mat, n, piv, bad); break;
+		case BATCH_LUSOLVE:   lusolvetile(mat, n, piv, vec, m); break;
+		case BATCH_CHOL:      choltile(mat, n, bad); break;
+		case BATCH_CHOLSOLVE: cholsolvetile(mat, n, vec, m); break;
+		}
+	}
+}
+
+static void runtiles(BatchArgs *args)
+{
+	long n = args->mat->nrows;
+	if ((long)args->mat->stride * n * n * n >= BATCH_PARALLEL_WORK)
+		tprun(batchtiles, args);
+	else
+		batchtiles(args, 0, 1);
+}
+
+/*** Public Functions ***/
+
+MatBatch *initbatch(int count, int nrows, int ncols)
+{
+	LOG_INFO("Initializing batch of %d %dx%d matrices...\n", count, nrows, ncols);
+	assert(count > 0 && nrows > 0 && ncols > 0);
+
+	MatBatch *batch = malloc(sizeof(MatBatch));
+	if (!batch) DIE("malloc");
+
+	batch->count = count;
+	batch->stride = (count + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+	batch->nrows = nrows;
+	batch->ncols = ncols;
+
+	/* The stride is a multiple of 8 doubles so the size is whole cache lines */
+	size_t size = sizeof(double) * batch->stride * nrows * ncols;
+	if (!(batch->vals = aligned_alloc(BATCH_ALIGN, size))) DIE("aligned_alloc");
+	memset(batch->vals, 0, size);
+
+	LOG_INFO("Finished initializing batch\n");
+	return batch;
+}
+
+void freebatch(MatBatch *batch)
+{
+	free(batch->vals);
+	free(batch);
+}
+
+void batchset(MatBatch *batch, int b, const Matrix *mat)
+{
+	assert(b >= 0 && b < batch->count);
+	assert(mat->nrows == batch->nrows && mat->ncols == batch->ncols);
+
+	int x, y;
+	for (y = 0; y < mat->nrows; y++)
+		for (x = 0; x < mat->ncols; x++)
+			BGET(batch, b, x, y) = GET(mat, x, y);
+}
+
+void batchget(Matrix *res, const MatBatch *batch, int b)
+{
+	assert(b >= 0 && b < batch->count);
+	assert(res->nrows == batch->nrows && res->ncols == batch->ncols);
+
+	int x, y;
+	for (y = 0; y < res->nrows; y++)
+		for (x = 0; x < res->ncols; x++)
+			GET(res, x, y) = BGET(batch, b, x, y);
+}
+
+int batchlu(MatBatch *batch, int *pivots, int *status)
+{
+	LOG_INFO("LU decomposition of %d %dx%d matrices...\n",
+			 batch->count, batch->nrows, batch->ncols);
+	assert(batch->nrows == batch->ncols);
+	LATENCY_START(start);
+
+	int *bad = calloc(batch->stride, sizeof(int));
+	if (!bad) DIE("calloc");
+
+	BatchArgs args = { BATCH_LU, batch, NULL, pivots, bad };
+	runtiles(&args);
+
+	int nbad = countbad(bad, batch->count, status);
+	free(bad);
+
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Finished LU decomposition, %d singular\n", nbad);
+	return nbad;
+}
+
+void batchlusolve(const MatBatch *lu, const int *pivots, MatBatch *vec)
+{
+	assert(lu->nrows == lu->ncols && vec->nrows == lu->nrows);
+	assert(vec->count == lu->count);
+
+	BatchArgs args = { BATCH_LUSOLVE, (MatBatch *)lu, vec, (int *)pivots, NULL };
+	runtiles(&args);
+}
+
+int batchchol(MatBatch *batch, int *status)
+{
+	LOG_INFO("Cholesky decomposition of %d %dx%d matrices...\n",
+			 batch->count, batch->nrows, batch->ncols);
+	assert(batch->nrows == batch->ncols);
+	LATENCY_START(start);
+
+	int *bad = calloc(batch->stride, sizeof(int));
+	if (!bad) DIE("calloc");
+
+	BatchArgs args = { BATCH_CHOL, batch, NULL, NULL, bad };
+	runtiles(&args);
+
+	int nbad = countbad(bad, batch->count, status);
+	free(bad);
+
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Finished Cholesky decomposition, %d not positive definite\n", nbad);
+	return nbad;
+}
+
+void batchcholsolve(const MatBatch *chol, MatBatch *vec)
+{
+	assert(chol->nrows == chol->ncols && vec->nrows == chol->nrows);
+	assert(vec->count == chol->count);
+
+	BatchArgs args = { BATCH_CHOLSOLVE, (MatBatch *)chol, vec, NULL, NULL };
+	runtiles(&args);
+}
+
+int batchsolve(MatBatch *mat, MatBatch *vec, int *status)
+{
+	int *pivots = malloc(sizeof(int) * mat->nrows * mat->stride);
+	if (!pivots) DIE("malloc");
+
+	int nbad = batchlu(mat, pivots, status);
+	batchlusolve(mat, pivots, vec);
+
+	free(pivots);
+	return nbad;
+}
@@ -0,0 +1,335 @@
+/**
+ * @file    bench_matrix.c
+ * @brief   Benchmarks the matrix.c functions and reports their tail latency,
+ *          run it with "make bench MODE=release" for meaningful numbers.
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "matrix.h"
+#include "batch.h"
+#include "symmat.h"
+#include "portfolio.h"
+#include "alloc.h"
+#include "latency.h"
+#include "logging.h"
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+#define JSON_FILE "./bench_latency.json"
+
+/* Systems solved per call in the batched benchmarks */
+#define BATCH_COUNT 1024
+
+/* Calls per recorded sample for the small sizes, one call is below the
+ * resolution of the clock */
+#define SMALL_CALLS 100
+
+/* Run stmt reps times, recording every run, then print the percentiles */
+#define BENCH(name, n, reps, stmt) do {                                   \
+	int _r;                                                               \
+	lathistreset(hist);                                                   \
+	for (_r = 0; _r < (reps); _r++) {                                     \
+		long _t = latnow();                                               \
+		stmt;                                                             \
+		lathistrecord(hist, latnow() - _t);                               \
+	}                                                                     \
+	printreport(name, n, hist);                                           \
+} while (0)
+
+/*** Helper Functions ***/
+
+static Matrix *randmat(int nrows, int ncols)
+{
+	Matrix *mat = initmat(nrows, ncols, NULL, 1);
+	int i;
+	for (i = 0; i < nrows * ncols; i++)
+		mat->vals[i] = (double)rand() / RAND_MAX * 2 - 1;
+	return mat;
+}
+
+/* The runtime sized loops the fixed size kernels replace, as a baseline */
+static void loopmult(Matrix *res, const Matrix *mat1, const Matrix *mat2)
+{
+	int r, x, y;
+	double sum;
+	for (y = 0; y < res->nrows; y++)
+		for (x = 0; x < res->ncols; x++) {
+			sum = 0;
+			for (r = 0; r < mat1->ncols; r++) sum += GET(mat1, r, y) * GET(mat2, x, r);
+			GET(res, x, y) = sum;
+		}
+}
+
+static void printreport(const char *name, int n, const LatHist *hist)
+{
+	printf("%-13s %5d %12ld %12ld %12ld %12ld\n", name, n,
+		   lathistpercentile(hist, 50), lathistpercentile(hist, 99),
+		   lathistpercentile(hist, 99.9), (long)hist->max);
+}
+
+/*** Benchmarks ***/
+
+int main(void)
+{
+	static const int sizes[] = { 4, 16, 64, 256 };
+	static const int reps[]  = { 10000, 2000, 100, 5 };
+	LatHist *hist = malloc(sizeof(LatHist));
+	Matrix *a, *b, *c, *work;
+	FILE *json;
+	size_t i;
+	int n;
+
+	if (!hist) DIE("malloc");
+	srand(42);
+	initLogFile();
+
+	printf("%-13s %5s %12s %12s %12s %12s\n", "function", "n",
+		   "p50 (ns)", "p99 (ns)", "p99.9 (ns)", "max (ns)");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		n = sizes[i];
+		a = randmat(n, n);
+		b = randmat(n, n);
+		c = initmat(n, n, NULL, 1);
+		work = initmat(n, n, NULL, 1);
+
+		BENCH("matmult", n, reps[i], matmult(c, a, b));
+		BENCH("matT", n, reps[i], matT(c, a));
+		BENCH("matTip", n, reps[i], matTip(work));
+		BENCH("rref", n, reps[i],
+			  memcpy(work->vals, a->vals, sizeof(double) * n * n); rref(work));
+		BENCH("matrank", n, reps[i], matrank(a));
+
+		freemat(a);
+		freemat(b);
+		freemat(c);
+		freemat(work);
+	}
+
+	/* Fixed size kernels, every sample is SMALL_CALLS calls. solinv() with
+	 * an lu buffer takes the general path, so it is the baseline for solve */
+	static const int fixed[] = { 2, 3, 4, 6, 8 };
+	Matrix *lu;
+	double y[8], x[8];
+	int call;
+
+	for (i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) {
+		n = fixed[i];
+		a = randmat(n, n);
+		b = randmat(n, n);
+		work = initmat(n, n, NULL, 1);
+		lu = initmat(n, n, NULL, 1);
+		for (call = 0; call < n; call++) y[call] = (double)rand() / RAND_MAX;
+
+		BENCH("loops x100", n, 10000,
+			  for (call = 0; call < SMALL_CALLS; call++) loopmult(work, a, b));
+		BENCH("matmult x100", n, 10000,
+			  for (call = 0; call < SMALL_CALLS; call++) matmult(work, a, b));
+		BENCH("matT x100", n, 10000,
+			  for (call = 0; call < SMALL_CALLS; call++) matT(work, a));
+		BENCH("matinv x100", n, 10000,
+			  for (call = 0; call < SMALL_CALLS; call++) matinv(work, a));
+		BENCH("general x100", n, 10000,
+			  for (call = 0; call < SMALL_CALLS; call++) {
+				  memcpy(lu->vals, a->vals, sizeof(double) * n * n);
+				  solinv(a, lu, x, y);
+			  });
+		BENCH("solinv x100", n, 10000,
+			  for (call = 0; call < SMALL_CALLS; call++) solinv(a, NULL, x, y));
+
+		freemat(a);
+		freemat(b);
+		freemat(work);
+		freemat(lu);
+	}
+
+	/* Many small systems, one solinv() call each against one batched call */
+	static const int small[] = { 4, 8, 16 };
+	MatBatch *mats, *rhs, *lus, *vecs;
+	Matrix **sys;
+	double *ys, *xs;
+	int k;
+
+	if (!(sys = malloc(sizeof(Matrix *) * BATCH_COUNT))) DIE("malloc");
+	for (i = 0; i < sizeof(small) / sizeof(small[0]); i++) {
+		n = small[i];
+		mats = initbatch(BATCH_COUNT, n, n);
+		rhs = initbatch(BATCH_COUNT, n, 1);
+		lus = initbatch(BATCH_COUNT, n, n);
+		vecs = initbatch(BATCH_COUNT, n, 1);
+		if (!(ys = malloc(sizeof(double) * n * BATCH_COUNT))) DIE("malloc");
+		if (!(xs = malloc(sizeof(double) * n * BATCH_COUNT))) DIE("malloc");
+		for (k = 0; k < BATCH_COUNT; k++) {
+			sys[k] = randmat(n, n);
+			batchset(mats, k, sys[k]);
+		}
+		for (k = 0; k < n * BATCH_COUNT; k++) {
+			ys[k] = (double)rand() / RAND_MAX;
+			BGET(rhs, k / n, 0, k % n) = ys[k];
+		}
+
+		BENCH("solinv x1k", n, 100,
+			  for (k = 0; k < BATCH_COUNT; k++)
+				  solinv(sys[k], NULL, &xs[k * n], &ys[k * n]));
+		BENCH("batch x1k", n, 100,
+			  memcpy(lus->vals, mats->vals, sizeof(double) * n * n * mats->stride);
+			  memcpy(vecs->vals, rhs->vals, sizeof(double) * n * rhs->stride);
+			  batchsolve(lus, vecs, NULL));
+
+		for (k = 0; k < BATCH_COUNT; k++) freemat(sys[k]);
+		freebatch(mats);
+		freebatch(rhs);
+		freebatch(lus);
+		freebatch(vecs);
+		free(ys);
+		free(xs);
+	}
+	free(sys);
+
+	/* Classical blocked product against Strassen-Winograd around the
+	 * crossover, the sizes where Strassen-Winograd starts to win */
+	static const int large[] = { 256, 512, 1024, 2048 };
+	static const int lreps[] = { 20, 10, 5, 2 };
+	int cross = matcrossover(0);
+
+	for (i = 0; i < sizeof(large) / sizeof(large[0]); i++) {
+		n = large[i];
+		a = randmat(n, n);
+		b = randmat(n, n);
+		c = initmat(n, n, NULL, 1);
+
+		matcrossover(0);
+		BENCH("classical", n, lreps[i], matmult(c, a, b));
+		matcrossover(n / 4);
+		BENCH("strassen n/4", n, lreps[i], matmult(c, a, b));
+		matcrossover(n / 2);
+		BENCH("strassen n/2", n, lreps[i], matmult(c, a, b));
+
+		freemat(a);
+		freemat(b);
+		freemat(c);
+	}
+	matcrossover(cross);
+
+	/* Rank-k updates of a covariance sized matrix, full against packed */
+	static const int wide[] = { 500, 2000 };
+	SymMatrix *sym;
+
+	for (i = 0; i < sizeof(wide) / sizeof(wide[0]); i++) {
+		n = wide[i];
+		a = randmat(64, n);
+		c = initmat(n, n, NULL, 1);
+		sym = initsym(n);
+
+		BENCH("matsyrk k64", n, 20, matsyrk(c, a));
+		BENCH("symrankk k64", n, 20, symrankk(sym, 1, a));
+
+		freemat(a);
+		freemat(c);
+		freesym(sym);
+	}
+
+	/* Long only rebalances with a 2% cap per asset, from scratch against
+	 * warm started from the same problem's last solution */
+	static const int universe[] = { 500, 2000 };
+	Portfolio *port;
+	double *mu;
+
+	for (i = 0; i < sizeof(universe) / sizeof(universe[0]); i++) {
+		n = universe[i];
+		a = randmat(2 * n, n);
+		sym = initsym(n);
+		port = initport(n);
+		if (!(mu = malloc(sizeof(double) * n))) DIE("malloc");
+		symrankk(sym, 1e-4 / n, a);
+		for (k = 0; k < n; k++) {
+			SGET(sym, k, k) += 1e-4;
+			mu[k] = 0.01 * rand() / RAND_MAX;
+			port->hi[k] = 0.02;
+		}
+
+		BENCH("portfolio", n, 5, port->solved = 0; portsolve(port, sym, mu, 100));
+		BENCH("port warm", n, 20, portsolve(port, sym, mu, 100));
+
+		freemat(a);
+		freesym(sym);
+		freeport(port);
+		free(mu);
+	}
+
+	/* Scoring with the coefficients wrapped in an n x 1 Matrix against the
+	 * GEMV and batched kernels, one live row and a history of 100000 rows
+	 * against 8 models. n is the amount of features */
+	static const int feats[] = { 16, 256 };
+	Matrix *feat, *coefs, *scores, vec = { 0, 1, NULL, 0 }, one;
+
+	for (i = 0; i < sizeof(feats) / sizeof(feats[0]); i++) {
+		n = feats[i];
+		feat = randmat(100000, n);
+		coefs = randmat(8, n);
+		scores = initmat(100000, 8, NULL, 1);
+		vec.nrows = n;
+		vec.vals = coefs->vals;
+		one.nrows = 1;
+		one.ncols = n;
+		one.vals = feat->vals;
+		Matrix res = { 1, 1, scores->vals, 0 };
+
+		BENCH("matmult row", n, 10000, for (k = 0; k < SMALL_CALLS; k++) matmult(&res, &one, &vec));
+		BENCH("matdot row", n, 10000,
+			  for (k = 0; k < SMALL_CALLS; k++) scores->vals[k] = matdot(one.vals, coefs->vals, n));
+		Matrix col = { 100000, 1, scores->vals, 0 };
+		BENCH("matmult hist", n, 5, matmult(&col, feat, &vec));
+		BENCH("matgemv hist", n, 5, matgemv(scores->vals, feat, coefs->vals, 0));
+		BENCH("predict 8", n, 5, matpredict(scores, feat, coefs));
+
+		freemat(feat);
+		freemat(coefs);
+		freemat(scores);
+	}
+
+	/* A 256MB matrix from each allocation policy, the cost of mapping and
+	 * first touching it and of a GEMV each way through it. n is the
+	 * amount of columns */
+	static const int policies[] = { ALLOC_MALLOC, ALLOC_HUGE, ALLOC_HUGE | ALLOC_INTERLEAVE };
+	static const char *names[][3] = {
+		{ "malloc init", "malloc gemv", "malloc gemvT" },
+		{ "huge init", "huge gemv", "huge gemvT" },
+		{ "interlv init", "interlv gemv", "interlv gemvT" },
+	};
+	double *in = malloc(sizeof(double) * 32768), *out = malloc(sizeof(double) * 32768);
+	if (!in || !out) DIE("malloc");
+	for (k = 0; k < 32768; k++) in[k] = (double)rand() / RAND_MAX;
+	n = 1024;
+
+	for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+		BENCH(names[i][0], n, 5, freemat(initmatalloc(32768, n, policies[i])));
+		a = initmatalloc(32768, n, policies[i]);
+		for (k = 0; k < 32768 * n; k++) a->vals[k] = in[k % 32768];
+
+		BENCH(names[i][1], n, 20, matgemv(out, a, in, 0));
+		BENCH(names[i][2], n, 20, matgemv(out, a, in, 1));
+		freemat(a);
+	}
+	free(in);
+	free(out);
+
+	/* Per stage latency recorded inside the library itself */
+	latreport();
+	if ((json = fopen(JSON_FILE, "w"))) {
+		latjson(json);
+		fclose(json);
+		printf("Stage latencies written to %s\n", JSON_FILE);
+	}
+
+	free(hist);
+	closeLogFile();
+	return EXIT_SUCCESS;
+}
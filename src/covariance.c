@@ -0,0 +1,308 @@
+/**
+ * @file    covariance.c
+ * @brief   Streaming covariance of many assets, updated bar by bar
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "covariance.h"
+#include "error.h"
+#include "latency.h"
+#include "logging.h"
+
+/*** System Includes ***/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Helper Functions ***/
+
+static CovEst *initcov(int n, double decay, int window)
+{
+	assert(n > 0);
+
+	CovEst *est = calloc(1, sizeof(CovEst));
+	if (!est) DIE("calloc");
+
+	est->n = n;
+	est->decay = decay;
+	est->window = window;
+	est->m2 = initsym(n);
+	if (!(est->mean = calloc(n, sizeof(double)))) DIE("calloc");
+	if (!(est->shift = calloc(n, sizeof(double)))) DIE("calloc");
+	if (!(est->s3 = calloc(n, sizeof(double)))) DIE("calloc");
+	if (window) est->ring = initmat(window, n, NULL, 1);
+
+	return est;
+}
+
+/* Forget every bar, the ring and shift are left alone */
+static void covreset(CovEst *est)
+{
+	est->weight = est->weight2 = 0;
+	est->s2 = est->s4 = 0;
+	memset(est->mean, 0, sizeof(double) * est->n);
+	memset(est->s3, 0, sizeof(double) * est->n);
+	memset(est->m2->vals, 0, sizeof(double) * SIDX(0, est->n));
+}
+
+static void growscratch(CovEst *est, int rows)
+{
+	if (rows <= est->cap) return;
+
+	free(est->scratch);
+	free(est->wts);
+	est->cap = rows;
+	est->scratch = malloc(sizeof(double) * rows * est->n);
+	est->wts = malloc(sizeof(double) * rows);
+	if (!est->scratch || !est->wts) DIE("malloc");
+}
+
+/* Adds (sign 1) or removes (sign -1) k weighted bars from the moments
+ * around the shift that the shrinkage needs */
+static void covmoments(CovEst *est, const double *rows, int k, const double *w, double sign)
+{
+	int i, j, n = est->n;
+	double q, d, sw;
+	const double *row;
+
+	for (i = 0; i < k; i++) {
+		row = &rows[(size_t)i * n];
+		q = 0;
+		for (j = 0; j < n; j++) {
+			d = row[j] - est->shift[j];
+			q += d * d;
+		}
+		sw = sign * w[i];
+		for (j = 0; j < n; j++) est->s3[j] += sw * q * (row[j] - est->shift[j]);
+		est->s2 += sw * q;
+		est->s4 += sw * q * q;
+		est->weight2 += sign * w[i] * w[i];
+	}
+}
+
+/* Merges (sign 1) or unmerges (sign -1) k weighted bars with the mean and
+ * M2 of the others. The deviations of the bars from their own mean plus
+ * the scaled difference of the two means go in as one rank k + 1 update */
+static void covmerge(CovEst *est, const double *rows, int k, const double *w, double sign)
+{
+	int i, j, n = est->n;
+	double wb = 0, wn, sw, delta, scale;
+	double *d, *mb;
+
+	growscratch(est, k + 1);
+	mb = &est->scratch[(size_t)k * n];
+
+	memset(mb, 0, sizeof(double) * n);
+	for (i = 0; i < k; i++) {
+		wb += w[i];
+		for (j = 0; j < n; j++) mb[j] += w[i] * rows[(size_t)i * n + j];
+	}
+	for (j = 0; j < n; j++) mb[j] /= wb;
+
+	for (i = 0; i < k; i++) {
+		sw = sqrt(w[i]);
+		d = &est->scratch[(size_t)i * n];
+		for (j = 0; j < n; j++) d[j] = sw * (rows[(size_t)i * n + j] - mb[j]);
+	}
+
+	if (sign > 0) {
+		wn = est->weight + wb;
+		scale = sqrt(est->weight * wb / wn);
+		for (j = 0; j < n; j++) {
+			delta = mb[j] - est->mean[j];
+			est->mean[j] += delta * wb / wn;
+			mb[j] = scale * delta;
+		}
+	} else {
+		wn = est->weight - wb;
+		if (wn <= EPSILON * est->weight) {
+			covreset(est);
+			return;
+		}
+		scale = sqrt(wn * wb / est->weight);
+		for (j = 0; j < n; j++) {
+			est->mean[j] = (est->weight * est->mean[j] - wb * mb[j]) / wn;
+			mb[j] = scale * (mb[j] - est->mean[j]);
+		}
+	}
+	est->weight = wn;
+
+	Matrix view = { k + 1, n, est->scratch, 0 };
+	symrankk(est->m2, sign, &view);
+}
+
+/* Both steps for rows [r0, r0 + k) of the ring, every weight 1 */
+static void ringmerge(CovEst *est, int r0, int k, double sign)
+{
+	int i;
+
+	growscratch(est, k + 1);
+	for (i = 0; i < k; i++) est->wts[i] = 1;
+	covmoments(est, &GET(est->ring, 0, r0), k, est->wts, sign);
+	covmerge(est, &GET(est->ring, 0, r0), k, est->wts, sign);
+}
+
+/* Rows [from, from + k) of the ring, in the at most two pieces that wrap */
+static void ringspan(CovEst *est, int from, int k, double sign)
+{
+	int first = (from + k <= est->window) ? k : est->window - from;
+	if (first > 0) ringmerge(est, from, first, sign);
+	if (k > first) ringmerge(est, 0, k - first, sign);
+}
+
+static void ewmaupdate(CovEst *est, const Matrix *bars)
+{
+	int i, k = bars->nrows;
+	size_t j, len = SIDX(0, est->n);
+	double f = pow(est->decay, k);
+
+	/* Age the older bars by k, then add the batch with its own decay */
+	est->weight *= f;
+	est->weight2 *= f * f;
+	est->s2 *= f;
+	est->s4 *= f;
+	for (j = 0; j < (size_t)est->n; j++) est->s3[j] *= f;
+	for (j = 0; j < len; j++) est->m2->vals[j] *= f;
+
+	growscratch(est, k + 1);
+	for (i = k - 1, f = 1; i >= 0; i--, f *= est->decay) est->wts[i] = f;
+	covmoments(est, bars->vals, k, est->wts, 1);
+	covmerge(est, bars->vals, k, est->wts, 1);
+}
+
+static void windowupdate(CovEst *est, const Matrix *bars)
+{
+	int i, k = bars->nrows, win = est->window, n = est->n;
+	int inwin = (est->count < win) ? est->count : win;
+	const double *rows = bars->vals;
+
+	/* A batch as long as the window replaces all of it */
+	if (k >= win) {
+		rows += (size_t)(k - win) * n;
+		memcpy(est->ring->vals, rows, sizeof(double) * win * n);
+		est->head = 0;
+		est->fresh = 0;
+		covreset(est);
+		ringspan(est, 0, win, 1);
+		return;
+	}
+
+	int drop = inwin + k - win;
+	if (drop > 0) {
+		ringspan(est, est->head, drop, -1);
+		est->head = (est->head + drop) % win;
+		inwin -= drop;
+	}
+
+	int at = (est->head + inwin) % win;
+	for (i = 0; i < k; i++)
+		memcpy(&GET(est->ring, 0, (at + i) % win), &rows[(size_t)i * n], sizeof(double) * n);
+	ringspan(est, at, k, 1);
+	inwin += k;
+
+	/* Recompute from the bars in the ring once the downdates add up */
+	if ((est->fresh += k) >= (long)COV_REFRESH_WINDOWS * win) {
+		LOG_DEBUG("Recomputing the window covariance from its %d bars\n", inwin);
+		covreset(est);
+		ringspan(est, est->head, inwin, 1);
+		est->fresh = 0;
+	}
+}
+
+/*** Public Functions ***/
+
+CovEst *initcovewma(int n, double decay)
+{
+	LOG_INFO("Creating exponentially weighted covariance of %d assets...\n", n);
+	assert(decay > 0 && decay <= 1);
+	return initcov(n, decay, 0);
+}
+
+CovEst *initcovwindow(int n, int window)
+{
+	LOG_INFO("Creating covariance of %d assets over %d bars...\n", n, window);
+	assert(window > 1);
+	return initcov(n, 1, window);
+}
+
+void freecov(CovEst *est)
+{
+	freesym(est->m2);
+	if (est->ring) freemat(est->ring);
+	free(est->mean);
+	free(est->shift);
+	free(est->s3);
+	free(est->scratch);
+	free(est->wts);
+	free(est);
+}
+
+void covupdate(CovEst *est, const Matrix *bars)
+{
+	assert(bars->ncols == est->n && bars->nrows > 0);
+	LATENCY_START(start);
+
+	/* The moments for the shrinkage are taken around the first bar, close
+	 * to the mean so their sums do not cancel */
+	if (!est->count) memcpy(est->shift, bars->vals, sizeof(double) * est->n);
+
+	if (est->window) windowupdate(est, bars);
+	else             ewmaupdate(est, bars);
+	est->count += bars->nrows;
+
+	LATENCY_STOP(LAT_FEATURE, start);
+}
+
+void covget(const CovEst *est, SymMatrix *res)
+{
+	assert(res->n == est->n && est->weight > 0);
+
+	size_t i, len = SIDX(0, est->n);
+	for (i = 0; i < len; i++) res->vals[i] = est->m2->vals[i] / est->weight;
+}
+
+double covshrink(const CovEst *est, SymMatrix *res)
+{
+	int i, j, n = est->n;
+	double trace = 0, norm = 0, m2 = 0, s3mu = 0, quad = 0;
+	double w = est->weight, v;
+	double *mu = malloc(sizeof(double) * n);
+	double *tmp = malloc(sizeof(double) * n);
+	if (!mu || !tmp) DIE("malloc");
+
+	covget(est, res);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < i; j++) norm += 2 * SGET(res, j, i) * SGET(res, j, i);
+		v = SGET(res, i, i);
+		norm += v * v;
+		trace += v;
+	}
+
+	/* Sum of w |x - mean|^4 from the moments around the shift */
+	for (i = 0; i < n; i++) {
+		mu[i] = est->mean[i] - est->shift[i];
+		m2 += mu[i] * mu[i];
+		s3mu += est->s3[i] * mu[i];
+	}
+	symmv(est->m2, mu, tmp);
+	for (i = 0; i < n; i++) quad += mu[i] * tmp[i];
+	double fourth = est->s4 - 4 * s3mu + 2 * est->s2 * m2 + 4 * quad + w * m2 * m2;
+
+	/* Distance of S to the target, and the variance of S per bar */
+	double target = trace / n;
+	double d2 = (norm - n * target * target) / n;
+	double b2 = (fourth / w - norm) / (w * w / est->weight2 * n);
+	double shrink = (d2 > 0) ? fmin(fmax(b2, 0), d2) / d2 : 1;
+
+	for (i = 0; i < (int)SIDX(0, n); i++) res->vals[i] *= 1 - shrink;
+	for (i = 0; i < n; i++) SGET(res, i, i) += shrink * target;
+
+	free(mu);
+	free(tmp);
+	return shrink;
+}
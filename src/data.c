@@ -0,0 +1,175 @@
+/**
+ * @file    data.c
+ * @brief   Functions to store and read market data on the local computer
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "data.h"
+#include "error.h"
+#include "logging.h"
+
+/*** System Includes ***/
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*** Helper Functions ***/
+
+/* Write all len bytes to fd, retrying on short writes */
+static int writeall(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = write(fd, p, len)) <= 0) return EXIT_FAILURE;
+		p += n;
+		len -= n;
+	}
+	return EXIT_SUCCESS;
+}
+
+/* Read exactly len bytes from fd at offset, retrying on short reads */
+static int readall(int fd, void *buf, size_t len, off_t offset)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = pread(fd, p, len, offset)) <= 0) return EXIT_FAILURE;
+		p += n;
+		len -= n;
+		offset += n;
+	}
+	return EXIT_SUCCESS;
+}
+
+/*** Public Functions ***/
+
+int savemat(const char *path, const Matrix *mat)
+{
+	LOG_INFO("Saving %dx%d matrix to %s...\n", mat->nrows, mat->ncols, path);
+
+	DataHeader head;
+	int fd;
+	size_t bsize = (size_t)mat->nrows * mat->ncols * sizeof(double);
+
+	memcpy(head.magic, DATA_MAGIC, DATA_MAGIC_LEN);
+	head.nrows = mat->nrows;
+	head.ncols = mat->ncols;
+
+	fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0) {
+		LOG_ERROR("Could not open %s for writing\n", path);
+		return -1;
+	}
+
+	if (writeall(fd, &head, sizeof(head)) || writeall(fd, mat->vals, bsize)) {
+		LOG_ERROR("Failed to write matrix to %s\n", path);
+		close(fd);
+		return -1;
+	}
+
+	close(fd);
+	LOG_INFO("Finished saving matrix\n");
+	return EXIT_SUCCESS;
+}
+
+/* Opens path and checks its header, returns the fd or -1 */
+static int openstore(const char *path, DataHeader *head)
+{
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		LOG_ERROR("Could not open %s for reading\n", path);
+		return -1;
+	}
+
+	if (readall(fd, head, sizeof(DataHeader), 0)
+		|| memcmp(head->magic, DATA_MAGIC, DATA_MAGIC_LEN)
+		|| head->nrows <= 0 || head->ncols <= 0) {
+		LOG_ERROR("%s is not a valid data store file\n", path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+Matrix *loadmat(const char *path)
+{
+	LOG_INFO("Loading matrix from %s...\n", path);
+
+	DataHeader head;
+	Matrix *mat;
+	int fd;
+
+	if ((fd = openstore(path, &head)) < 0) return NULL;
+
+	/* The header is long, a Matrix is int, bigger stores are read by rows */
+	if (head.nrows > INT_MAX || head.ncols > INT_MAX) {
+		LOG_ERROR("%s is too big to load as one matrix\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	mat = initmat(head.nrows, head.ncols, NULL, 1);
+	if (readall(fd, mat->vals, (size_t)head.nrows * head.ncols * sizeof(double),
+				sizeof(head))) {
+		LOG_ERROR("%s is truncated\n", path);
+		freemat(mat);
+		close(fd);
+		return NULL;
+	}
+
+	close(fd);
+	LOG_INFO("Loaded %ldx%ld matrix\n", head.nrows, head.ncols);
+	return mat;
+}
+
+DataFile *opendata(const char *path)
+{
+	LOG_INFO("Opening data store file %s...\n", path);
+
+	DataHeader head;
+	DataFile *df;
+	int fd;
+
+	if ((fd = openstore(path, &head)) < 0) return NULL;
+
+	/* The rows are read front to back, let the kernel read ahead further */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if (!(df = malloc(sizeof(DataFile)))) DIE("malloc");
+	df->fd = fd;
+	df->nrows = head.nrows;
+	df->ncols = head.ncols;
+
+	LOG_INFO("Opened %ldx%ld data store file\n", df->nrows, df->ncols);
+	return df;
+}
+
+void closedata(DataFile *df)
+{
+	close(df->fd);
+	free(df);
+}
+
+long readrows(const DataFile *df, double *buf, long row, long count)
+{
+	if (row >= df->nrows) return 0;
+	if (row + count > df->nrows) count = df->nrows - row;
+
+	size_t rowsize = df->ncols * sizeof(double);
+	if (readall(df->fd, buf, count * rowsize, sizeof(DataHeader) + row * rowsize)) {
+		LOG_ERROR("Failed to read %ld rows from row %ld\n", count, row);
+		return -1;
+	}
+	return count;
+}
@@ -0,0 +1,340 @@
+/**
+ * @file    exchange.c
+ * @brief   Local matching engine to trade against when there is no network
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "exchange.h"
+#include "error.h"
+#include "latency.h"
+#include "logging.h"
+
+/*** System Includes ***/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+#define SLOT_BITS 32
+#define SLOT_MASK ((1L << SLOT_BITS) - 1)
+#define OTHER(side) (1 - (side))
+
+/*** Helper Functions ***/
+
+/* Lowest level >= from with resting orders, -1 if there is none */
+static int nextlevel(const OrderBook *book, int side, int from)
+{
+	const uint64_t *bits = book->nonempty[side];
+	int w = from >> 6;
+	if (from >= book->nlevels) return -1;
+
+	uint64_t word = bits[w] & (~0ULL << (from & 63));
+	while (!word) {
+		if (++w >= book->nwords) return -1;
+		word = bits[w];
+	}
+	return w * 64 + __builtin_ctzll(word);
+}
+
+/* Highest level <= from with resting orders, -1 if there is none */
+static int prevlevel(const OrderBook *book, int side, int from)
+{
+	const uint64_t *bits = book->nonempty[side];
+	int w = from >> 6;
+	if (from < 0) return -1;
+
+	uint64_t word = bits[w] & (~0ULL >> (63 - (from & 63)));
+	while (!word) {
+		if (--w < 0) return -1;
+		word = bits[w];
+	}
+	return w * 64 + 63 - __builtin_clzll(word);
+}
+
+/* Best level of a side after the level at lvl emptied */
+static inline int bestafter(const OrderBook *book, int side, int lvl)
+{
+	return (side == SIDE_BUY) ? prevlevel(book, side, lvl - 1)
+							  : nextlevel(book, side, lvl + 1);
+}
+
+static inline void linkorder(OrderBook *book, Order *order)
+{
+	int lvl = order->price - book->minprice;
+	int side = order->side;
+	PriceLevel *level = &book->levels[side][lvl];
+
+	order->next = NULL;
+	order->prev = level->tail;
+	if (level->tail) level->tail->next = order;
+	else             level->head = order;
+	level->tail = order;
+	level->qty += order->qty;
+
+	book->nonempty[side][lvl >> 6] |= 1ULL << (lvl & 63);
+	if (book->best[side] < 0
+		|| (side == SIDE_BUY && lvl > book->best[side])
+		|| (side == SIDE_SELL && lvl < book->best[side]))
+		book->best[side] = lvl;
+}
+
+static inline void unlinkorder(OrderBook *book, Order *order)
+{
+	int lvl = order->price - book->minprice;
+	int side = order->side;
+	PriceLevel *level = &book->levels[side][lvl];
+
+	if (order->prev) order->prev->next = order->next;
+	else             level->head = order->next;
+	if (order->next) order->next->prev = order->prev;
+	else             level->tail = order->prev;
+	level->qty -= order->qty;
+
+	if (!level->head) {
+		book->nonempty[side][lvl >> 6] &= ~(1ULL << (lvl & 63));
+		if (book->best[side] == lvl) book->best[side] = bestafter(book, side, lvl);
+	}
+}
+
+static inline void freeorder(OrderBook *book, Order *order)
+{
+	order->id = 0;
+	order->next = book->freelist;
+	book->freelist = order;
+}
+
+/* Resting quantity an order at price could take from the other side,
+ * counted until it reaches qty */
+static long crossing(const OrderBook *book, int side, long price, long qty)
+{
+	int other = OTHER(side), lvl = book->best[other];
+	long avail = 0, lvlprice;
+
+	while (lvl >= 0 && avail < qty) {
+		lvlprice = book->minprice + lvl;
+		if ((side == SIDE_BUY) ? lvlprice > price : lvlprice < price) break;
+		avail += book->levels[other][lvl].qty;
+		lvl = bestafter(book, other, lvl);
+	}
+	return avail;
+}
+
+/* Match qty against the resting orders of the other side, returns what is left */
+static long match(OrderBook *book, long taker, int side, int type, long price, long qty)
+{
+	int other = OTHER(side);
+	int lvl;
+	long trade, lvlprice;
+	Order *maker;
+	PriceLevel *level;
+	Fill fill;
+
+	fill.taker = taker;
+	fill.side = side;
+	fill.tick = book->tick;
+	fill.latency = 0;
+
+	while (qty > 0 && (lvl = book->best[other]) >= 0) {
+		lvlprice = book->minprice + lvl;
+		if (type != ORDER_MARKET) {
+			if (side == SIDE_BUY && lvlprice > price) break;
+			if (side == SIDE_SELL && lvlprice < price) break;
+		}
+
+		/* Take from the front of the FIFO until the level or the order is done */
+		level = &book->levels[other][lvl];
+		while (qty > 0 && (maker = level->head)) {
+			trade = (maker->qty < qty) ? maker->qty : qty;
+			maker->qty -= trade;
+			level->qty -= trade;
+			qty -= trade;
+
+			/* Only orders sent in reaction to a replayed tick have a latency */
+			if (book->tick >= 0) {
+				fill.latency = latnow() - book->tickns;
+				latrecord(LAT_ORDER, fill.latency);
+			}
+			if (book->onfill) {
+				fill.maker = maker->id;
+				fill.price = lvlprice;
+				fill.qty = trade;
+				book->onfill(&fill, book->fillarg);
+			}
+
+			if (maker->qty == 0) {
+				unlinkorder(book, maker);
+				freeorder(book, maker);
+			}
+		}
+	}
+
+	return qty;
+}
+
+/*** Public Functions ***/
+
+OrderBook *initbook(long minprice, int nlevels, int capacity)
+{
+	LOG_INFO("Creating order book with %d levels from %ld and %d orders...\n",
+			 nlevels, minprice, capacity);
+	assert(nlevels > 0 && capacity > 0);
+
+	OrderBook *book = calloc(1, sizeof(OrderBook));
+	if (!book) DIE("calloc");
+
+	book->minprice = minprice;
+	book->nlevels = nlevels;
+	book->nwords = (nlevels + 63) / 64;
+	book->capacity = capacity;
+	book->tick = -1;
+
+	int s, i;
+	for (s = 0; s < 2; s++) {
+		book->levels[s] = calloc(nlevels, sizeof(PriceLevel));
+		book->nonempty[s] = calloc(book->nwords, sizeof(uint64_t));
+		if (!book->levels[s] || !book->nonempty[s]) DIE("calloc");
+		book->best[s] = -1;
+	}
+
+	/* Thread every order onto the free list up front */
+	book->pool = calloc(capacity, sizeof(Order));
+	if (!book->pool) DIE("calloc");
+	for (i = capacity - 1; i >= 0; i--) freeorder(book, &book->pool[i]);
+
+	LOG_INFO("Succesfully created order book\n");
+	return book;
+}
+
+void freebook(OrderBook *book)
+{
+	int s;
+	for (s = 0; s < 2; s++) {
+		free(book->levels[s]);
+		free(book->nonempty[s]);
+	}
+	free(book->pool);
+	free(book);
+}
+
+void bookonfill(OrderBook *book, FillCallback onfill, void *arg)
+{
+	book->onfill = onfill;
+	book->fillarg = arg;
+}
+
+long bookorder(OrderBook *book, int side, int type, long price, long qty)
+{
+	Order *order = NULL, **link;
+	long id, left;
+
+	if (qty <= 0 || (side != SIDE_BUY && side != SIDE_SELL)) {
+		LOG_WARN("Rejected order with side %d and quantity %ld\n", side, qty);
+		return -1;
+	}
+	if (type != ORDER_LIMIT && type != ORDER_MARKET && type != ORDER_IOC) {
+		LOG_WARN("Rejected order of unknown type %d\n", type);
+		return -1;
+	}
+	if (type != ORDER_MARKET
+		&& (price < book->minprice || price >= book->minprice + book->nlevels)) {
+		LOG_WARN("Rejected order with price %ld outside of the ladder\n", price);
+		return -1;
+	}
+
+	/* Only a limit order can rest, with every slot taken it is only
+	 * accepted if it fills completely */
+	if (type == ORDER_LIMIT && !(order = book->freelist)
+		&& crossing(book, side, price, qty) < qty) {
+		LOG_WARN("Rejected order, all %d order slots are resting\n", book->capacity);
+		return -1;
+	}
+
+	/* Ids carry the pool slot the order would rest in so that cancelling
+	 * never has to search, orders that can not rest have no slot */
+	id = (++book->seq << SLOT_BITS) | (order ? order - book->pool : SLOT_MASK);
+	left = match(book, id, side, type, price, qty);
+
+	/* The slot is only taken now, the makers match() freed are in front */
+	if (left > 0 && type == ORDER_LIMIT) {
+		assert(order);
+		for (link = &book->freelist; *link != order; link = &(*link)->next);
+		*link = order->next;
+		order->id = id;
+		order->side = side;
+		order->price = price;
+		order->qty = left;
+		linkorder(book, order);
+	}
+
+	return id;
+}
+
+int bookcancel(OrderBook *book, long id)
+{
+	long slot = id & SLOT_MASK;
+	if (id <= 0 || slot >= book->capacity || book->pool[slot].id != id) return -1;
+
+	Order *order = &book->pool[slot];
+	unlinkorder(book, order);
+	freeorder(book, order);
+	return EXIT_SUCCESS;
+}
+
+long bookbest(const OrderBook *book, int side)
+{
+	int lvl;
+	assert(side == SIDE_BUY || side == SIDE_SELL);
+
+	lvl = book->best[side];
+	return (lvl < 0) ? -1 : book->minprice + lvl;
+}
+
+long bookdepth(const OrderBook *book, int side, long price)
+{
+	long lvl = price - book->minprice;
+	assert(side == SIDE_BUY || side == SIDE_SELL);
+	if (lvl < 0 || lvl >= book->nlevels) return 0;
+	return book->levels[side][lvl].qty;
+}
+
+long bookqty(const OrderBook *book, long id)
+{
+	long slot = id & SLOT_MASK;
+	if (id <= 0 || slot >= book->capacity || book->pool[slot].id != id) return 0;
+	return book->pool[slot].qty;
+}
+
+long bookreplay(OrderBook *book, const Matrix *events, TickCallback ontick, void *arg)
+{
+	LOG_INFO("Replaying %d market events...\n", events->nrows);
+	if (events->ncols != REPLAY_COLS) {
+		LOG_ERROR("Replay needs %d columns, got %d\n", REPLAY_COLS, events->ncols);
+		return -1;
+	}
+
+	const double *row;
+	long i;
+	for (i = 0; i < events->nrows; i++) {
+		row = &events->vals[i * events->ncols];
+
+		/* The tick arrives when the market's own order has hit the book */
+		LATENCY_START(start);
+		book->tick = -1;
+		bookorder(book, (int)row[REPLAY_SIDE], (int)row[REPLAY_TYPE],
+				  (long)row[REPLAY_PRICE], (long)row[REPLAY_QTY]);
+		LATENCY_STOP(LAT_DATA, start);
+
+		book->tick = i;
+		book->tickns = latnow();
+		if (ontick) ontick(book, row, arg);
+	}
+	book->tick = -1;
+
+	LOG_INFO("Finished replaying %ld market events\n", i);
+	return i;
+}
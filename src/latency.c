@@ -0,0 +1,209 @@
+/**
+ * @file    latency.c
+ * @brief   HDR style latency histograms to report tail latency per stage
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "latency.h"
+#include "error.h"
+#include "logging.h"
+
+/*** System Includes ***/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*** Type Definitions ***/
+
+/* The histograms of one thread, kept on a list so they can be merged */
+typedef struct LatThread {
+	LatHist hist[LAT_NSTAGES];
+	struct LatThread *next;
+} LatThread;
+
+/*** File Variables ***/
+
+static const char *stagenames[LAT_NSTAGES] = {
+	"data", "feature", "predict", "order", "solve", "train"
+};
+
+static pthread_mutex_t threadslock = PTHREAD_MUTEX_INITIALIZER;
+static LatThread *threads = NULL;
+static _Thread_local LatThread *local = NULL;
+
+/*** Helper Functions ***/
+
+static inline int bucketidx(uint64_t v)
+{
+	if (v < LAT_SUB_COUNT) return v;
+
+	int bucket = 63 - __builtin_clzll(v) - LAT_SUB_BITS + 1;
+	int sub = v >> bucket;
+	return (bucket + 1) * LAT_SUB_HALF + sub - LAT_SUB_HALF;
+}
+
+/* Highest value that lands in the same bucket as index idx */
+static inline uint64_t bucketvalue(int idx)
+{
+	if (idx < LAT_SUB_COUNT) return idx;
+
+	int bucket = idx / LAT_SUB_HALF - 1;
+	uint64_t sub = idx % LAT_SUB_HALF + LAT_SUB_HALF;
+	return ((sub + 1) << bucket) - 1;
+}
+
+/* Counters are only written by their own thread, the relaxed atomics let
+ * latmerge() read them while that thread keeps on recording */
+static inline void bump(uint64_t *c, uint64_t v)
+{
+	__atomic_store_n(c, *c + v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t peek(const uint64_t *c)
+{
+	return __atomic_load_n(c, __ATOMIC_RELAXED);
+}
+
+/*** Public Functions ***/
+
+void lathistreset(LatHist *hist)
+{
+	memset(hist, 0, sizeof(LatHist));
+	hist->min = UINT64_MAX;
+}
+
+void lathistrecord(LatHist *hist, long ns)
+{
+	uint64_t v = (ns < 0) ? 0 : ns;
+	if (v >= (1ULL << LAT_MAX_BITS)) v = (1ULL << LAT_MAX_BITS) - 1;
+
+	bump(&hist->counts[bucketidx(v)], 1);
+	bump(&hist->total, 1);
+	bump(&hist->sum, v);
+	if (v < hist->min) __atomic_store_n(&hist->min, v, __ATOMIC_RELAXED);
+	if (v > hist->max) __atomic_store_n(&hist->max, v, __ATOMIC_RELAXED);
+}
+
+void lathistmerge(LatHist *dst, const LatHist *src)
+{
+	int i;
+	uint64_t v;
+
+	for (i = 0; i < LAT_NBUCKETS; i++) dst->counts[i] += peek(&src->counts[i]);
+	dst->total += peek(&src->total);
+	dst->sum += peek(&src->sum);
+	if ((v = peek(&src->min)) < dst->min) dst->min = v;
+	if ((v = peek(&src->max)) > dst->max) dst->max = v;
+}
+
+long lathistpercentile(const LatHist *hist, double p)
+{
+	if (hist->total == 0) return 0;
+	if (p >= 100) return hist->max;
+
+	/* Amount of values at or below the percentile, at least one */
+	uint64_t want = (uint64_t)(p / 100 * hist->total + 0.5);
+	uint64_t seen = 0;
+	int i;
+
+	if (want == 0) want = 1;
+	for (i = 0; i < LAT_NBUCKETS; i++) {
+		seen += hist->counts[i];
+		if (seen >= want) break;
+	}
+
+	/* Never report more than what was actually recorded */
+	uint64_t v = bucketvalue(i);
+	return (v > hist->max) ? hist->max : v;
+}
+
+long latnow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void latrecord(int stage, long ns)
+{
+	if (!local) {
+		int s;
+		if (!(local = malloc(sizeof(LatThread)))) DIE("malloc");
+		for (s = 0; s < LAT_NSTAGES; s++) lathistreset(&local->hist[s]);
+
+		pthread_mutex_lock(&threadslock);
+		local->next = threads;
+		threads = local;
+		pthread_mutex_unlock(&threadslock);
+	}
+	lathistrecord(&local->hist[stage], ns);
+}
+
+void latmerge(LatHist *res, int stage)
+{
+	LatThread *t;
+
+	lathistreset(res);
+	pthread_mutex_lock(&threadslock);
+	for (t = threads; t; t = t->next) lathistmerge(res, &t->hist[stage]);
+	pthread_mutex_unlock(&threadslock);
+}
+
+void latreport(void)
+{
+	LatHist *hist = malloc(sizeof(LatHist));
+	int s;
+	if (!hist) DIE("malloc");
+
+	for (s = 0; s < LAT_NSTAGES; s++) {
+		latmerge(hist, s);
+		if (!hist->total) continue;
+		LOG_STAT("%-8s n=%lu p50=%ldns p99=%ldns p99.9=%ldns max=%luns\n",
+				 stagenames[s], (unsigned long)hist->total,
+				 lathistpercentile(hist, 50), lathistpercentile(hist, 99),
+				 lathistpercentile(hist, 99.9), (unsigned long)hist->max);
+	}
+	free(hist);
+}
+
+int latjson(FILE *f)
+{
+	LatHist *hist = malloc(sizeof(LatHist));
+	int s, first = 1;
+	if (!hist) DIE("malloc");
+
+	fprintf(f, "{");
+	for (s = 0; s < LAT_NSTAGES; s++) {
+		latmerge(hist, s);
+		if (!hist->total) continue;
+		fprintf(f, "%s\n  \"%s\": { \"count\": %lu, \"min\": %lu, \"mean\": %.1f, "
+				"\"p50\": %ld, \"p90\": %ld, \"p99\": %ld, \"p99.9\": %ld, "
+				"\"max\": %lu }",
+				first ? "" : ",", stagenames[s], (unsigned long)hist->total,
+				(unsigned long)hist->min, (double)hist->sum / hist->total,
+				lathistpercentile(hist, 50), lathistpercentile(hist, 90),
+				lathistpercentile(hist, 99), lathistpercentile(hist, 99.9),
+				(unsigned long)hist->max);
+		first = 0;
+	}
+	fprintf(f, "\n}\n");
+	free(hist);
+
+	return ferror(f) ? -1 : EXIT_SUCCESS;
+}
+
+void latreset(void)
+{
+	LatThread *t;
+	int s;
+
+	pthread_mutex_lock(&threadslock);
+	for (t = threads; t; t = t->next)
+		for (s = 0; s < LAT_NSTAGES; s++) lathistreset(&t->hist[s]);
+	pthread_mutex_unlock(&threadslock);
+}
@@ -74,6 +74,7 @@ void logm(const char *msgtype, const char *file, int line, const char *format, .
 	else if (strcmp(msgtype, "INFO") == 0)   color = ASCII_GREEN;
 	else if (strcmp(msgtype, "WARN") == 0)   color = ASCII_YELLOW;
 	else if (strcmp(msgtype, "ERROR") == 0)  color = ASCII_RED;
+	else                                     color = ASCII_CYAN;
 
 	/* Form header */
 	int headlen = snprintf(buf, MAX_MESSAGE_LENGTH, "%s[%s] [%s] [%s:%d]\x1b[0m ",
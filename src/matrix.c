@@ -8,11 +8,16 @@
 /*** Includes ***/
 
 #include "matrix.h"
+#include "alloc.h"
 #include "error.h"
+#include "latency.h"
 #include "logging.h"
+#include "threadpool.h"
 
 /*** System Includes ***/
 
+#include <float.h>
+#include <limits.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stddef.h>
@@ -24,6 +29,43 @@
 
 #define SWAP(temp, row1, row2) temp = *row1; *row1 = *row2; *row2 = temp
 
+/* Tile size of the blocked kernels, a 64x64 tile of doubles is 32KB */
+#define BLOCK 64
+
+/* Jacobi SVD gives up after this many sweeps, it normally needs under 15 */
+#define JACOBI_MAX_SWEEPS 60
+
+/* Below this much work per round the Jacobi rotations are done serially */
+#define JACOBI_PARALLEL_WORK (1 << 16)
+
+/* Below this many multiply-adds a GEMM runs on the calling thread */
+#define GEMM_PARALLEL_WORK (1L << 18)
+
+/* Below this many multiply-adds a matrix-vector product or a batch of
+ * predictions runs on the calling thread */
+#define GEMV_PARALLEL_WORK (1L << 16)
+
+/* Rows scored together against every model by matpredict(), each model's
+ * coefficients are loaded once for all of them */
+#define PREDICT_ROWS 4
+
+/* Default size from which square products use Strassen-Winograd */
+#define STRASSEN_CROSSOVER 512
+
+/* Transposes with at least this many values use the thread pool */
+#define TRANS_PARALLEL_SIZE (1L << 20)
+
+/* Largest n with its own unrolled n x n kernels */
+#define FIXED_MAX 8
+
+/* Every loop in the fixed size kernels has a trip count known at compile
+ * time, this asks the compiler to unroll it completely */
+#define UNROLL _Pragma("GCC unroll 8")
+
+/*** File Variables ***/
+
+static int crossover = STRASSEN_CROSSOVER;
+
 /*** Helper Functions ***/
 
 #ifdef DEBUG
@@ -51,12 +93,6 @@ void logmat(const Matrix *mat)
 #define LOGMAT(mat)
 #endif
 
-/* Decomposes a into a new matrix using lu */
-int _LU_decomposition(const Matrix *mat, Matrix *lu)
-{
-	return EXIT_SUCCESS;
-}
-
 /*** Row Operations ***/
 
 /* Row index starts at 0 */
@@ -111,6 +147,792 @@ static inline void scaleRow(const Matrix *mat, int r, double k, int from)
 	}
 }
 
+/*** Decompositions ***/
+
+/* Decomposes lu in place into L and U using partial pivoting, L has an
+ * implicit diagonal of 1. Row y was swapped with row pivots[y] */
+static int ludecomp(Matrix *lu, int *pivots)
+{
+	double pivot, current, l;
+	int x, y, i, next, n = lu->nrows;
+
+	for (x = 0; x < n; x++) {
+
+		/* Find the biggest pivot*/
+		i = x;
+		pivot = GET(lu, x, x);
+		for (next = x + 1; next < n; next++) {
+			current = GET(lu, x, next);
+			if (fabs(pivot) < fabs(current)) {
+				i = next;
+				pivot = current;
+			}
+		}
+		LOG_DEBUG("Found best pivot in (%d, %d), with value %.2f\n", x, i, pivot);
+
+		if (fabs(pivot) <= EPSILON) {
+			LOG_WARN("zero pivot detected, singular matrix, decomposition won't work\n");
+			return EXIT_FAILURE;
+		}
+		pivots[x] = i;
+		swapRow(lu, x, i, 0);
+
+		/* Reduce U with row operation and set L element */
+		for (y = x + 1; y < n; y++) {
+			l = GET(lu, x, y) / pivot;
+			GET(lu, x, y) = l;
+			if (l != 0 && x + 1 < n) scaleAddToRow(lu, y, -l, x, x + 1);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/* Solves LUx = Pb in place, vec holds b on entry and x on exit */
+static void lusolve(const Matrix *lu, const int *pivots, double *vec)
+{
+	double temp, sum;
+	int x, y, n = lu->nrows;
+
+	for (y = 0; y < n; y++)
+		if (pivots[y] != y) { temp = vec[y]; vec[y] = vec[pivots[y]]; vec[pivots[y]] = temp; }
+
+	/* Forward substitution with the unit lower triangle */
+	for (y = 1; y < n; y++) {
+		sum = vec[y];
+		for (x = 0; x < y; x++) sum -= GET(lu, x, y) * vec[x];
+		vec[y] = sum;
+	}
+
+	/* Back substitution with the upper triangle */
+	for (y = n - 1; y >= 0; y--) {
+		sum = vec[y];
+		for (x = y + 1; x < n; x++) sum -= GET(lu, x, y) * vec[x];
+		vec[y] = sum / GET(lu, y, y);
+	}
+}
+
+/* Dot product of the first len elements of two rows */
+static inline double rowdot(const double *a, const double *b, int len)
+{
+	double sum = 0;
+	int i;
+	for (i = 0; i < len; i++) sum += a[i] * b[i];
+	return sum;
+}
+
+/*** Parallel Kernels ***/
+
+typedef struct {
+	Matrix *res;
+	const Matrix *mat;
+	double *partial; /* One ncols x ncols accumulator per thread */
+} SyrkArgs;
+
+/* Adds rows [r0, r1) of mat^T mat to the tile (i0..i1, j0..j1) of res,
+ * the rows of mat are read contiguously so the inner loop vectorizes */
+static inline void syrktile(double *res, int ldr, const Matrix *mat, long r0, long r1,
+							int i0, int i1, int j0, int j1)
+{
+	const double *row;
+	double a;
+	long r;
+	int i, j;
+
+	for (r = r0; r < r1; r++) {
+		row = &mat->vals[r * mat->ncols];
+		for (i = i0; i < i1; i++) {
+			a = row[i];
+			double * restrict out = &res[i * ldr];
+			for (j = j0; j < j1 && j <= i; j++) out[j] += a * row[j];
+		}
+	}
+}
+
+/* Narrow matrices: every thread adds its share of the rows to a private
+ * accumulator, the accumulators are added together afterwards */
+static void syrkrows(void *arg, int id, int nthreads)
+{
+	SyrkArgs *a = arg;
+	int n = a->mat->ncols;
+	double *acc = &a->partial[(size_t)id * n * n];
+	long start, end, r0;
+
+	tprange(a->mat->nrows, id, nthreads, &start, &end);
+	for (r0 = start; r0 < end; r0 += BLOCK * 4)
+		syrktile(acc, n, a->mat, r0, (r0 + BLOCK * 4 < end) ? r0 + BLOCK * 4 : end,
+				 0, n, 0, n);
+}
+
+/* Wide matrices: the lower triangle tiles of res are dealt out to the
+ * threads, so every tile has one owner and nothing has to be reduced */
+static void syrktiles(void *arg, int id, int nthreads)
+{
+	SyrkArgs *a = arg;
+	int n = a->mat->ncols;
+	int nb = (n + BLOCK - 1) / BLOCK;
+	int bi, bj, t = 0;
+	long r0, r1;
+
+	for (bi = 0; bi < nb; bi++) {
+		for (bj = 0; bj <= bi; bj++, t++) {
+			if (t % nthreads != id) continue;
+			for (r0 = 0; r0 < a->mat->nrows; r0 += BLOCK * 4) {
+				r1 = (r0 + BLOCK * 4 < a->mat->nrows) ? r0 + BLOCK * 4 : a->mat->nrows;
+				syrktile(a->res->vals, n, a->mat, r0, r1,
+						 bi * BLOCK, (bi + 1) * BLOCK < n ? (bi + 1) * BLOCK : n,
+						 bj * BLOCK, (bj + 1) * BLOCK < n ? (bj + 1) * BLOCK : n);
+			}
+		}
+	}
+}
+
+typedef struct {
+	const Matrix *lu;
+	const int *perm;   /* Row i of P is the unit row perm[i] */
+	Matrix *res;
+} InvArgs;
+
+/* Solves LUX = P for blocks of columns of X, every block is independent
+ * and is swept row by row so the updates run along contiguous memory */
+static void invcols(void *arg, int id, int nthreads)
+{
+	InvArgs *a = arg;
+	const Matrix *lu = a->lu;
+	Matrix *res = a->res;
+	int n = lu->nrows;
+	int nb = (n + BLOCK - 1) / BLOCK;
+	int blk, c0, w, i, k, c;
+	double l, *xi;
+	const double *xk;
+
+	for (blk = id; blk < nb; blk += nthreads) {
+		c0 = blk * BLOCK;
+		w = (c0 + BLOCK < n) ? BLOCK : n - c0;
+
+		for (i = 0; i < n; i++) {
+			xi = &GET(res, c0, i);
+			memset(xi, 0, sizeof(double) * w);
+			if (a->perm[i] >= c0 && a->perm[i] < c0 + w) xi[a->perm[i] - c0] = 1;
+		}
+
+		/* Forward with the unit lower triangle */
+		for (i = 1; i < n; i++) {
+			xi = &GET(res, c0, i);
+			for (k = 0; k < i; k++) {
+				if ((l = GET(lu, k, i)) == 0) continue;
+				xk = &GET(res, c0, k);
+				for (c = 0; c < w; c++) xi[c] -= l * xk[c];
+			}
+		}
+
+		/* Back with the upper triangle */
+		for (i = n - 1; i >= 0; i--) {
+			xi = &GET(res, c0, i);
+			for (k = i + 1; k < n; k++) {
+				if ((l = GET(lu, k, i)) == 0) continue;
+				xk = &GET(res, c0, k);
+				for (c = 0; c < w; c++) xi[c] -= l * xk[c];
+			}
+			l = 1 / GET(lu, i, i);
+			for (c = 0; c < w; c++) xi[c] *= l;
+		}
+	}
+}
+
+/* One round of the one-sided Jacobi SVD */
+typedef struct {
+	double *w;         /* Rows being made orthogonal, nrows x len */
+	double *q;         /* The rotations so far, nrows x nrows */
+	int nrows;
+	int len;
+	const int *pairs;  /* Disjoint pairs of rows, two ints per pair */
+	int npairs;
+	int rotated;
+} JacobiArgs;
+
+/* Rotate rows i and j of w so they are orthogonal, and q with them */
+static int jacobirotate(JacobiArgs *a, int i, int j)
+{
+	double *wi = &a->w[(size_t)i * a->len];
+	double *wj = &a->w[(size_t)j * a->len];
+	double *qi = &a->q[(size_t)i * a->nrows];
+	double *qj = &a->q[(size_t)j * a->nrows];
+	double alpha = rowdot(wi, wi, a->len);
+	double beta = rowdot(wj, wj, a->len);
+	double gamma = rowdot(wi, wj, a->len);
+	double zeta, t, c, s, x, y;
+	int k;
+
+	if (gamma == 0 || fabs(gamma) <= DBL_EPSILON * a->len * sqrt(alpha * beta))
+		return 0;
+
+	zeta = (beta - alpha) / (2 * gamma);
+	t = ((zeta >= 0) ? 1 : -1) / (fabs(zeta) + sqrt(1 + zeta * zeta));
+	c = 1 / sqrt(1 + t * t);
+	s = c * t;
+
+	for (k = 0; k < a->len; k++) {
+		x = wi[k]; y = wj[k];
+		wi[k] = c * x - s * y;
+		wj[k] = s * x + c * y;
+	}
+	for (k = 0; k < a->nrows; k++) {
+		x = qi[k]; y = qj[k];
+		qi[k] = c * x - s * y;
+		qj[k] = s * x + c * y;
+	}
+	return 1;
+}
+
+static void jacobiround(void *arg, int id, int nthreads)
+{
+	JacobiArgs *a = arg;
+	long start, end, p;
+	int rotated = 0;
+
+	tprange(a->npairs, id, nthreads, &start, &end);
+	for (p = start; p < end; p++)
+		rotated |= jacobirotate(a, a->pairs[2 * p], a->pairs[2 * p + 1]);
+	if (rotated) __atomic_store_n(&a->rotated, 1, __ATOMIC_RELAXED);
+}
+
+/* C += alpha * A * B on row-major arrays with leading dimensions */
+typedef struct {
+	int m, n, k;
+	double alpha;
+	const double *a;
+	int lda;
+	const double *b;
+	int ldb;
+	double *c;
+	int ldc;
+} GemmArgs;
+
+/* Rows [i0, i1) of C, a BLOCK x BLOCK tile of B is reused by every row
+ * while it is in cache and the inner loop runs along rows of B and C */
+static void gemmrows(const GemmArgs *g, int i0, int i1)
+{
+	int i, j, p, jj, pp, jw, pend;
+	double aip, *crow;
+	const double *brow;
+
+	for (pp = 0; pp < g->k; pp += BLOCK) {
+		pend = (pp + BLOCK < g->k) ? pp + BLOCK : g->k;
+		for (jj = 0; jj < g->n; jj += BLOCK) {
+			jw = (jj + BLOCK < g->n) ? BLOCK : g->n - jj;
+			for (i = i0; i < i1; i++) {
+				crow = &g->c[(size_t)i * g->ldc + jj];
+				for (p = pp; p < pend; p++) {
+					aip = g->alpha * g->a[(size_t)i * g->lda + p];
+					if (aip == 0) continue;
+					brow = &g->b[(size_t)p * g->ldb + jj];
+					for (j = 0; j < jw; j++) crow[j] += aip * brow[j];
+				}
+			}
+		}
+	}
+}
+
+static void gemmtask(void *arg, int id, int nthreads)
+{
+	GemmArgs *g = arg;
+	long start, end;
+
+	tprange(g->m, id, nthreads, &start, &end);
+	if (start < end) gemmrows(g, start, end);
+}
+
+static void gemm(int m, int n, int k, double alpha, const double *a, int lda,
+				 const double *b, int ldb, double *c, int ldc)
+{
+	GemmArgs g = { m, n, k, alpha, a, lda, b, ldb, c, ldc };
+
+	if (m <= 0 || n <= 0 || k <= 0) return;
+	if ((long)m * n * k >= GEMM_PARALLEL_WORK) tprun(gemmtask, &g);
+	else gemmrows(&g, 0, m);
+}
+
+typedef struct {
+	double *res;
+	const Matrix *mat;
+	const double *vec;
+	double *partial;   /* One ncols accumulator per thread for mat^T vec */
+} GemvArgs;
+
+/* Every thread owns its rows of res */
+static void gemvrows(void *arg, int id, int nthreads)
+{
+	GemvArgs *g = arg;
+	long y, start, end;
+	int n = g->mat->ncols;
+
+	tprange(g->mat->nrows, id, nthreads, &start, &end);
+	for (y = start; y < end; y++) g->res[y] = matdot(&g->mat->vals[y * n], g->vec, n);
+}
+
+/* mat^T vec as a sum of scaled rows, so it still reads mat along rows */
+static void gemvcols(void *arg, int id, int nthreads)
+{
+	GemvArgs *g = arg;
+	long y, start, end;
+	int x, n = g->mat->ncols;
+	double * restrict acc = g->partial ? &g->partial[id * n] : g->res;
+	const double *row;
+
+	memset(acc, 0, sizeof(double) * n);
+	tprange(g->mat->nrows, id, nthreads, &start, &end);
+	for (y = start; y < end; y++) {
+		row = &g->mat->vals[y * n];
+		for (x = 0; x < n; x++) acc[x] += g->vec[y] * row[x];
+	}
+}
+
+typedef struct {
+	Matrix *res;
+	const Matrix *x;
+	const Matrix *coefs;
+} PredictArgs;
+
+/* PREDICT_ROWS rows of x against every model, the four sums share each
+ * load of a coefficient and vectorize along the features */
+static void predictrows(void *arg, int id, int nthreads)
+{
+	PredictArgs *a = arg;
+	int m, j, p = a->x->ncols, nmodels = a->coefs->nrows;
+	long y, k, start, end;
+	long nblk = (a->x->nrows + PREDICT_ROWS - 1) / PREDICT_ROWS;
+	double s0, s1, s2, s3, c;
+	const double *w, *r0, *r1, *r2, *r3;
+
+	tprange(nblk, id, nthreads, &start, &end);
+	for (k = start; k < end; k++) {
+		y = k * PREDICT_ROWS;
+		if (y + PREDICT_ROWS > a->x->nrows) {
+			for (; y < a->x->nrows; y++)
+				for (m = 0; m < nmodels; m++)
+					GET(a->res, m, y) = matdot(&GET(a->x, 0, y), &GET(a->coefs, 0, m), p);
+			break;
+		}
+
+		r0 = &GET(a->x, 0, y);
+		r1 = r0 + p;
+		r2 = r1 + p;
+		r3 = r2 + p;
+		for (m = 0; m < nmodels; m++) {
+			w = &GET(a->coefs, 0, m);
+			s0 = s1 = s2 = s3 = 0;
+			for (j = 0; j < p; j++) {
+				c = w[j];
+				s0 += r0[j] * c;
+				s1 += r1[j] * c;
+				s2 += r2[j] * c;
+				s3 += r3[j] * c;
+			}
+			GET(a->res, m, y) = s0;
+			GET(a->res, m, y + 1) = s1;
+			GET(a->res, m, y + 2) = s2;
+			GET(a->res, m, y + 3) = s3;
+		}
+	}
+}
+
+/* Bump allocator for the Strassen-Winograd temporaries, allocated once
+ * for the whole product and handed out level by level */
+typedef struct {
+	double *base;
+	size_t used;
+	size_t size;
+} Arena;
+
+static double *arenaget(Arena *arena, size_t len)
+{
+	assert(arena->used + len <= arena->size);
+	double *p = arena->base + arena->used;
+	arena->used += len;
+	return p;
+}
+
+/* Doubles of scratch the serial recursion needs for an n x n product */
+static size_t winoneed(int n)
+{
+	size_t h = n / 2;
+	if (n < crossover) return 0;
+	if (n & 1) return winoneed(n - 1);
+	return 2 * h * h + winoneed(h);
+}
+
+/* d = x + sign * y on n x n blocks */
+static void blockadd(int n, double *d, int ldd, const double *x, int ldx,
+					 const double *y, int ldy, double sign)
+{
+	int i, j;
+	for (i = 0; i < n; i++)
+		for (j = 0; j < n; j++)
+			d[(size_t)i * ldd + j] = x[(size_t)i * ldx + j] + sign * y[(size_t)i * ldy + j];
+}
+
+/* C = AB with the n-1 x n-1 leading block of C already holding the
+ * product of the leading blocks, adds the last row and column */
+static void peelfix(int n, const double *a, int lda, const double *b, int ldb,
+					double *c, int ldc)
+{
+	int i, m = n - 1;
+
+	gemm(m, m, 1, 1, &a[m], lda, &b[(size_t)m * ldb], ldb, c, ldc);
+	for (i = 0; i < m; i++) c[(size_t)i * ldc + m] = 0;
+	memset(&c[(size_t)m * ldc], 0, sizeof(double) * n);
+	gemm(m, 1, n, 1, a, lda, &b[m], ldb, &c[m], ldc);
+	gemm(1, n, n, 1, &a[(size_t)m * lda], lda, b, ldb, &c[(size_t)m * ldc], ldc);
+}
+
+/* C = AB for n x n blocks, with the two temporary schedule of Boyer, Dumas,
+ * Pernet and Zhou so a level only needs 2 (n/2)^2 of scratch */
+static void winograd(int n, const double *a, int lda, const double *b, int ldb,
+					 double *c, int ldc, Arena *arena)
+{
+	int i, h = n / 2;
+	size_t mark = arena->used;
+
+	if (n < crossover) {
+		for (i = 0; i < n; i++) memset(&c[(size_t)i * ldc], 0, sizeof(double) * n);
+		gemm(n, n, n, 1, a, lda, b, ldb, c, ldc);
+		return;
+	}
+	if (n & 1) {
+		winograd(n - 1, a, lda, b, ldb, c, ldc, arena);
+		peelfix(n, a, lda, b, ldb, c, ldc);
+		return;
+	}
+
+	const double *a11 = a, *a12 = a + h, *a21 = a + (size_t)h * lda, *a22 = a21 + h;
+	const double *b11 = b, *b12 = b + h, *b21 = b + (size_t)h * ldb, *b22 = b21 + h;
+	double *c11 = c, *c12 = c + h, *c21 = c + (size_t)h * ldc, *c22 = c21 + h;
+	double *x = arenaget(arena, (size_t)h * h);
+	double *y = arenaget(arena, (size_t)h * h);
+
+	blockadd(h, x, h, a11, lda, a21, lda, -1);           /* S3 = A11 - A21 */
+	blockadd(h, y, h, b22, ldb, b12, ldb, -1);           /* T3 = B22 - B12 */
+	winograd(h, x, h, y, h, c21, ldc, arena);            /* P7 = S3 T3 */
+	blockadd(h, x, h, a21, lda, a22, lda, 1);            /* S1 = A21 + A22 */
+	blockadd(h, y, h, b12, ldb, b11, ldb, -1);           /* T1 = B12 - B11 */
+	winograd(h, x, h, y, h, c22, ldc, arena);            /* P5 = S1 T1 */
+	blockadd(h, x, h, x, h, a11, lda, -1);               /* S2 = S1 - A11 */
+	blockadd(h, y, h, b22, ldb, y, h, -1);               /* T2 = B22 - T1 */
+	winograd(h, x, h, y, h, c12, ldc, arena);            /* P6 = S2 T2 */
+	blockadd(h, x, h, a12, lda, x, h, -1);               /* S4 = A12 - S2 */
+	winograd(h, x, h, b22, ldb, c11, ldc, arena);        /* P3 = S4 B22 */
+	winograd(h, a11, lda, b11, ldb, x, h, arena);        /* P1 = A11 B11 */
+	blockadd(h, c12, ldc, x, h, c12, ldc, 1);            /* U2 = P1 + P6 */
+	blockadd(h, c21, ldc, c12, ldc, c21, ldc, 1);        /* U3 = U2 + P7 */
+	blockadd(h, c12, ldc, c12, ldc, c22, ldc, 1);        /* U4 = U2 + P5 */
+	blockadd(h, c22, ldc, c21, ldc, c22, ldc, 1);        /* U7 = U3 + P5 */
+	blockadd(h, c12, ldc, c12, ldc, c11, ldc, 1);        /* U5 = U4 + P3 */
+	blockadd(h, y, h, y, h, b21, ldb, -1);               /* T4 = T2 - B21 */
+	winograd(h, a22, lda, y, h, c11, ldc, arena);        /* P4 = A22 T4 */
+	blockadd(h, c21, ldc, c21, ldc, c11, ldc, -1);       /* U6 = U3 - P4 */
+	winograd(h, a12, lda, b21, ldb, c11, ldc, arena);    /* P2 = A12 B21 */
+	blockadd(h, c11, ldc, x, h, c11, ldc, 1);            /* U1 = P1 + P2 */
+
+	arena->used = mark;
+}
+
+/* The seven products of the top level, run as tasks on the thread pool */
+typedef struct {
+	int h;
+	const double *lhs[7];
+	const double *rhs[7];
+	int ldl[7];
+	int ldr[7];
+	double *dst[7];
+	int ldd[7];
+	Arena *arenas;
+} WinoArgs;
+
+static void winotask(void *arg, int id, int nthreads)
+{
+	WinoArgs *w = arg;
+	int p;
+	for (p = id; p < 7; p += nthreads)
+		winograd(w->h, w->lhs[p], w->ldl[p], w->rhs[p], w->ldr[p],
+				 w->dst[p], w->ldd[p], &w->arenas[id]);
+}
+
+/* C = AB for n x n matrices above the crossover */
+static void strassen(int n, const double *a, const double *b, double *c)
+{
+	int nthreads = tpthreads();
+	int m = n & ~1, h = m / 2;
+	int t, i, j;
+	Arena arena;
+
+	if (nthreads == 1) {
+		arena.size = winoneed(n);
+		arena.used = 0;
+		if (!(arena.base = malloc(sizeof(double) * (arena.size + 1)))) DIE("malloc");
+		winograd(n, a, n, b, n, c, n, &arena);
+		free(arena.base);
+		return;
+	}
+
+	/* The sums and three of the products get their own blocks, the other
+	 * four products go straight into C, every thread gets its own arena */
+	size_t hh = (size_t)h * h, sub = winoneed(h);
+	Arena *arenas = malloc(sizeof(Arena) * nthreads);
+	double *work = malloc(sizeof(double) * (11 * hh + nthreads * sub + 1));
+	if (!arenas || !work) DIE("malloc");
+	for (t = 0; t < nthreads; t++) {
+		arenas[t].base = work + 11 * hh + t * sub;
+		arenas[t].used = 0;
+		arenas[t].size = sub;
+	}
+
+	const double *a11 = a, *a12 = a + h, *a21 = a + (size_t)h * n, *a22 = a21 + h;
+	const double *b11 = b, *b12 = b + h, *b21 = b + (size_t)h * n, *b22 = b21 + h;
+	double *c11 = c, *c12 = c + h, *c21 = c + (size_t)h * n, *c22 = c21 + h;
+	double *s1 = work, *s2 = s1 + hh, *s3 = s2 + hh, *s4 = s3 + hh;
+	double *t1 = s4 + hh, *t2 = t1 + hh, *t3 = t2 + hh, *t4 = t3 + hh;
+	double *p1 = t4 + hh, *p5 = p1 + hh, *p6 = p5 + hh;
+
+	blockadd(h, s1, h, a21, n, a22, n, 1);
+	blockadd(h, s2, h, s1, h, a11, n, -1);
+	blockadd(h, s3, h, a11, n, a21, n, -1);
+	blockadd(h, s4, h, a12, n, s2, h, -1);
+	blockadd(h, t1, h, b12, n, b11, n, -1);
+	blockadd(h, t2, h, b22, n, t1, h, -1);
+	blockadd(h, t3, h, b22, n, b12, n, -1);
+	blockadd(h, t4, h, t2, h, b21, n, -1);
+
+	WinoArgs args = {
+		h,
+		{ a11, a12, s4, a22, s1, s2, s3 },
+		{ b11, b21, b22, t4, t1, t2, t3 },
+		{ n, n, h, n, h, h, h },
+		{ n, n, n, h, h, h, h },
+		{ p1, c11, c12, c21, p5, p6, c22 },
+		{ h, n, n, n, h, h, n },
+		arenas
+	};
+	tprun(winotask, &args);
+
+	/* C11 = P1 + P2, C12 = U2 + P5 + P3, C21 = U2 + P7 - P4, C22 = U2 + P7 + P5 */
+	double u2, p7;
+	for (i = 0; i < h; i++)
+		for (j = 0; j < h; j++) {
+			size_t ci = (size_t)i * n + j, pi = (size_t)i * h + j;
+			u2 = p1[pi] + p6[pi];
+			p7 = c22[ci];
+			c11[ci] += p1[pi];
+			c12[ci] += u2 + p5[pi];
+			c21[ci] = u2 + p7 - c21[ci];
+			c22[ci] = u2 + p7 + p5[pi];
+		}
+
+	if (m != n) peelfix(n, a, n, b, n, c, n);
+	free(work);
+	free(arenas);
+}
+
+/* Out of place transpose of a rows x cols row-major matrix */
+typedef struct {
+	double *res;
+	const double *mat;
+	int nrows;
+	int ncols;
+} TransArgs;
+
+/* 4x4 tile, the loads and stores are written out so the compiler keeps
+ * the tile in registers and shuffles it instead of going through memory */
+static inline void trans4x4(double *restrict dst, int dstride,
+							const double *restrict src, int sstride)
+{
+	double a0 = src[0], a1 = src[1], a2 = src[2], a3 = src[3];
+	src += sstride;
+	double b0 = src[0], b1 = src[1], b2 = src[2], b3 = src[3];
+	src += sstride;
+	double c0 = src[0], c1 = src[1], c2 = src[2], c3 = src[3];
+	src += sstride;
+	double d0 = src[0], d1 = src[1], d2 = src[2], d3 = src[3];
+
+	dst[0] = a0; dst[1] = b0; dst[2] = c0; dst[3] = d0;
+	dst += dstride;
+	dst[0] = a1; dst[1] = b1; dst[2] = c1; dst[3] = d1;
+	dst += dstride;
+	dst[0] = a2; dst[1] = b2; dst[2] = c2; dst[3] = d2;
+	dst += dstride;
+	dst[0] = a3; dst[1] = b3; dst[2] = c3; dst[3] = d3;
+}
+
+/* Transpose rows [r0, r1) and columns [c0, c1), halving the longer side
+ * until the piece fits in cache */
+static void transrec(const TransArgs *a, int r0, int r1, int c0, int c1)
+{
+	int r, c, rows = r1 - r0, cols = c1 - c0;
+
+	if (rows > BLOCK || cols > BLOCK) {
+		if (rows >= cols) {
+			transrec(a, r0, r0 + rows / 2, c0, c1);
+			transrec(a, r0 + rows / 2, r1, c0, c1);
+		} else {
+			transrec(a, r0, r1, c0, c0 + cols / 2);
+			transrec(a, r0, r1, c0 + cols / 2, c1);
+		}
+		return;
+	}
+
+	for (r = r0; r + 4 <= r1; r += 4) {
+		for (c = c0; c + 4 <= c1; c += 4)
+			trans4x4(&a->res[(size_t)c * a->nrows + r], a->nrows,
+					 &a->mat[(size_t)r * a->ncols + c], a->ncols);
+		for (; c < c1; c++) {
+			a->res[(size_t)c * a->nrows + r]     = a->mat[(size_t)r * a->ncols + c];
+			a->res[(size_t)c * a->nrows + r + 1] = a->mat[(size_t)(r + 1) * a->ncols + c];
+			a->res[(size_t)c * a->nrows + r + 2] = a->mat[(size_t)(r + 2) * a->ncols + c];
+			a->res[(size_t)c * a->nrows + r + 3] = a->mat[(size_t)(r + 3) * a->ncols + c];
+		}
+	}
+	for (; r < r1; r++)
+		for (c = c0; c < c1; c++)
+			a->res[(size_t)c * a->nrows + r] = a->mat[(size_t)r * a->ncols + c];
+}
+
+/* Each thread transposes a band of whole rows, split on multiples of 4 */
+static void transrows(void *arg, int id, int nthreads)
+{
+	TransArgs *a = arg;
+	long start, end;
+
+	tprange((a->nrows + 3) / 4, id, nthreads, &start, &end);
+	start *= 4;
+	end = (end * 4 < a->nrows) ? end * 4 : a->nrows;
+	if (start < end) transrec(a, start, end, 0, a->ncols);
+}
+
+/*** Fixed Size Kernels ***/
+
+/* Generates the n x n multiply, transpose, inverse and solve for one N,
+ * the matrices are plain row-major arrays of N * N doubles */
+#define DEFINE_FIXED(N)                                                      \
+static void mult##N(double *restrict c, const double *restrict a,           \
+					const double *restrict b)                                \
+{                                                                            \
+	double row[N];                                                           \
+	int i, j, k;                                                             \
+	UNROLL for (i = 0; i < N; i++) {                                         \
+		UNROLL for (j = 0; j < N; j++) row[j] = a[i * N] * b[j];             \
+		UNROLL for (k = 1; k < N; k++)                                       \
+			UNROLL for (j = 0; j < N; j++) row[j] += a[i * N + k] * b[k * N + j]; \
+		UNROLL for (j = 0; j < N; j++) c[i * N + j] = row[j];                \
+	}                                                                        \
+}                                                                            \
+                                                                             \
+static void trans##N(double *restrict c, const double *restrict a)          \
+{                                                                            \
+	int i, j;                                                                \
+	UNROLL for (i = 0; i < N; i++)                                           \
+		UNROLL for (j = 0; j < N; j++) c[j * N + i] = a[i * N + j];          \
+}                                                                            \
+                                                                             \
+/* Gauss-Jordan on [A | I] with partial pivoting */                         \
+static int inv##N(double *restrict c, const double *restrict a)             \
+{                                                                            \
+	double m[N * N], t, p;                                                   \
+	int i, j, k, piv;                                                        \
+	UNROLL for (i = 0; i < N * N; i++) {                                     \
+		m[i] = a[i];                                                         \
+		c[i] = (i % (N + 1) == 0);                                           \
+	}                                                                        \
+	UNROLL for (k = 0; k < N; k++) {                                         \
+		piv = k;                                                             \
+		UNROLL for (i = k + 1; i < N; i++)                                   \
+			if (fabs(m[i * N + k]) > fabs(m[piv * N + k])) piv = i;          \
+		if (fabs(m[piv * N + k]) <= EPSILON) return -1;                      \
+		if (piv != k)                                                        \
+			UNROLL for (j = 0; j < N; j++) {                                 \
+				t = m[k * N + j]; m[k * N + j] = m[piv * N + j]; m[piv * N + j] = t; \
+				t = c[k * N + j]; c[k * N + j] = c[piv * N + j]; c[piv * N + j] = t; \
+			}                                                                \
+		p = 1 / m[k * N + k];                                                \
+		UNROLL for (j = 0; j < N; j++) {                                     \
+			m[k * N + j] *= p;                                               \
+			c[k * N + j] *= p;                                               \
+		}                                                                    \
+		UNROLL for (i = 0; i < N; i++) {                                     \
+			if (i == k) continue;                                            \
+			t = m[i * N + k];                                                \
+			UNROLL for (j = 0; j < N; j++) {                                 \
+				m[i * N + j] -= t * m[k * N + j];                            \
+				c[i * N + j] -= t * c[k * N + j];                            \
+			}                                                                \
+		}                                                                    \
+	}                                                                        \
+	return EXIT_SUCCESS;                                                     \
+}                                                                            \
+                                                                             \
+/* LU with partial pivoting, x may be the same array as y */                \
+static int solve##N(double *x, const double *restrict a, const double *y)   \
+{                                                                            \
+	double m[N * N], v[N], t, l;                                             \
+	int i, j, k, piv;                                                        \
+	UNROLL for (i = 0; i < N * N; i++) m[i] = a[i];                          \
+	UNROLL for (i = 0; i < N; i++) v[i] = y[i];                              \
+	UNROLL for (k = 0; k < N; k++) {                                         \
+		piv = k;                                                             \
+		UNROLL for (i = k + 1; i < N; i++)                                   \
+			if (fabs(m[i * N + k]) > fabs(m[piv * N + k])) piv = i;          \
+		if (fabs(m[piv * N + k]) <= EPSILON) return -1;                      \
+		if (piv != k) {                                                      \
+			UNROLL for (j = k; j < N; j++) {                                 \
+				t = m[k * N + j]; m[k * N + j] = m[piv * N + j]; m[piv * N + j] = t; \
+			}                                                                \
+			t = v[k]; v[k] = v[piv]; v[piv] = t;                             \
+		}                                                                    \
+		UNROLL for (i = k + 1; i < N; i++) {                                 \
+			l = m[i * N + k] / m[k * N + k];                                 \
+			UNROLL for (j = k + 1; j < N; j++) m[i * N + j] -= l * m[k * N + j]; \
+			v[i] -= l * v[k];                                                \
+		}                                                                    \
+	}                                                                        \
+	UNROLL for (i = N - 1; i >= 0; i--) {                                    \
+		t = v[i];                                                            \
+		UNROLL for (j = i + 1; j < N; j++) t -= m[i * N + j] * v[j];         \
+		v[i] = t / m[i * N + i];                                             \
+	}                                                                        \
+	UNROLL for (i = 0; i < N; i++) x[i] = v[i];                              \
+	return EXIT_SUCCESS;                                                     \
+}
+
+DEFINE_FIXED(2)
+DEFINE_FIXED(3)
+DEFINE_FIXED(4)
+DEFINE_FIXED(5)
+DEFINE_FIXED(6)
+DEFINE_FIXED(7)
+DEFINE_FIXED(8)
+
+/* Indexed by n, NULL where there is no fixed size kernel */
+static void (*const multfixed[FIXED_MAX + 1])(double *restrict, const double *restrict,
+											   const double *restrict) = {
+	NULL, NULL, mult2, mult3, mult4, mult5, mult6, mult7, mult8
+};
+static void (*const transfixed[FIXED_MAX + 1])(double *restrict, const double *restrict) = {
+	NULL, NULL, trans2, trans3, trans4, trans5, trans6, trans7, trans8
+};
+static int (*const invfixed[FIXED_MAX + 1])(double *restrict, const double *restrict) = {
+	NULL, NULL, inv2, inv3, inv4, inv5, inv6, inv7, inv8
+};
+static int (*const solvefixed[FIXED_MAX + 1])(double *, const double *restrict,
+											   const double *) = {
+	NULL, NULL, solve2, solve3, solve4, solve5, solve6, solve7, solve8
+};
+
+/* n if the matrix is n x n with a fixed size kernel, else 0 */
+static inline int fixedsize(const Matrix *mat)
+{
+	return (mat->nrows == mat->ncols && mat->nrows >= 2 && mat->nrows <= FIXED_MAX)
+		   ? mat->nrows : 0;
+}
+
 /*** Public Functions ***/
 
 Matrix *initmat(int nrows, int ncols, const double *data, int byrow)
@@ -122,12 +944,13 @@ Matrix *initmat(int nrows, int ncols, const double *data, int byrow)
 	if (!mat) DIE("malloc");
 
 	/* Allocate memory for the matrix values */
-	int bsize = nrows * ncols * sizeof(double);
+	size_t bsize = (size_t)nrows * ncols * sizeof(double);
 	double *vals = malloc(bsize);
 	if (!vals) { free(mat); DIE("malloc"); }
 
 	mat->ncols = ncols;
 	mat->nrows = nrows;
+	mat->alloc = ALLOC_MALLOC;
 
 	LOG_DEBUG("Copying data...\n");
 	int i;
@@ -155,9 +978,25 @@ Matrix *initmat(int nrows, int ncols, const double *data, int byrow)
 	return mat;
 }
 
+Matrix *initmatalloc(int nrows, int ncols, int policy)
+{
+	LOG_INFO("Creating a %dx%d Matrix with policy %#x...\n", nrows, ncols, policy);
+
+	Matrix *mat = malloc(sizeof(Matrix));
+	if (!mat) DIE("malloc");
+
+	mat->nrows = nrows;
+	mat->ncols = ncols;
+	mat->alloc = policy;
+	mat->vals = allocvals(nrows, ncols, &mat->alloc);
+
+	LOG_INFO("Succesfully created matrix\n");
+	return mat;
+}
+
 void freemat(Matrix *mat)
 {
-	free(mat->vals);
+	freevals(mat->vals, mat->alloc);
 	free(mat);
 }
 
@@ -193,115 +1032,444 @@ int matmult(Matrix *res, const Matrix *mat1, const Matrix *mat2)
 	LOG_INFO("Multiplying matrices of size %dx%d and %dx%d together...\n", 
 			 mat1->nrows, mat1->ncols, mat2->nrows, mat2->ncols);
 
-	int r, x, y;
-	double sum;
+	int n;
 
-	/* TODO: Can try and write this in assembly */
 	assert(mat1->nrows == res->nrows && mat2->ncols == res->ncols);
-	for (x = 0; x < res->ncols; x++) {
-		for (y = 0; y < res->nrows; y++){
-
-			LOG_DEBUG("Calculating element (%d, %d) of result matrix\n", x, y);
+	assert(mat1->ncols == mat2->nrows);
+	if ((n = fixedsize(mat1)) && n == fixedsize(mat2)) {
+		multfixed[n](res->vals, mat1->vals, mat2->vals);
+		LOG_INFO("Finished multiplying together matrices\n");
+		return EXIT_SUCCESS;
+	}
 
-			/* Row and col dot product */
-			sum = 0;
-			LOG_DEBUG("sum = %.2f\n", sum);
-			for (r = 0; r < mat1->ncols; r++) {
-				LOG_DEBUG("sum += %.2f * %.2f\n", GET(mat1, r, y), GET(mat2, x, r));
-				sum += GET(mat1, r, y) * GET(mat2, x, r);
-			}
-			LOG_INFO("Element (%d, %d) = %.2f\n", x, y, sum);
-			GET(res, x, y) = sum;
-		}
+	n = res->nrows;
+	if (n >= crossover && n == res->ncols && n == mat1->ncols) {
+		strassen(n, mat1->vals, mat2->vals, res->vals);
+		LOG_INFO("Finished multiplying together matrices with Strassen-Winograd\n");
+		return EXIT_SUCCESS;
 	}
+
+	memset(res->vals, 0, sizeof(double) * res->nrows * res->ncols);
+	gemm(res->nrows, res->ncols, mat1->ncols, 1, mat1->vals, mat1->ncols,
+		 mat2->vals, mat2->ncols, res->vals, res->ncols);
 	LOG_INFO("Finished multiplying together matrices\n");
 
 	return EXIT_SUCCESS;
 }
 
+double matdot(const double *a, const double *b, int len)
+{
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	int i;
+
+	/* Four independent sums, so every add does not wait on the last one */
+	for (i = 0; i + 4 <= len; i += 4) {
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+	for (; i < len; i++) s0 += a[i] * b[i];
+	return (s0 + s1) + (s2 + s3);
+}
+
+int matgemv(double *res, const Matrix *mat, const double *vec, int trans)
+{
+	LOG_INFO("Multiplying %sMatrix of size %dx%d with a vector...\n",
+			 trans ? "transposed " : "", mat->nrows, mat->ncols);
+
+	GemvArgs args = { res, mat, vec, NULL };
+	int nthreads = tpthreads(), t, x, n = mat->ncols;
+	int parallel = (long)mat->nrows * n >= GEMV_PARALLEL_WORK && nthreads > 1;
+
+	if (!trans) {
+		if (parallel) tprun(gemvrows, &args);
+		else          gemvrows(&args, 0, 1);
+	} else if (!parallel) {
+		gemvcols(&args, 0, 1);
+	} else {
+		/* Every thread sums its own rows, then the sums are added */
+		if (!(args.partial = malloc(sizeof(double) * n * nthreads))) DIE("malloc");
+		tprun(gemvcols, &args);
+		memcpy(res, args.partial, sizeof(double) * n);
+		for (t = 1; t < nthreads; t++)
+			for (x = 0; x < n; x++) res[x] += args.partial[t * n + x];
+		free(args.partial);
+	}
+
+	LOG_INFO("Finished matrix-vector product\n");
+	return EXIT_SUCCESS;
+}
+
+int matpredict(Matrix *res, const Matrix *x, const Matrix *coefs)
+{
+	LOG_INFO("Scoring %d rows of %d features against %d models...\n",
+			 x->nrows, x->ncols, coefs->nrows);
+	assert(res->nrows == x->nrows && res->ncols == coefs->nrows);
+	assert(x->ncols == coefs->ncols);
+	LATENCY_START(start);
+
+	PredictArgs args = { res, x, coefs };
+
+	if (x->nrows == 1 && coefs->nrows == 1)
+		res->vals[0] = matdot(x->vals, coefs->vals, x->ncols);
+	else if ((long)x->nrows * x->ncols * coefs->nrows >= GEMV_PARALLEL_WORK)
+		tprun(predictrows, &args);
+	else
+		predictrows(&args, 0, 1);
+
+	LATENCY_STOP(LAT_PREDICT, start);
+	LOG_INFO("Finished scoring\n");
+	return EXIT_SUCCESS;
+}
+
+int matcrossover(int n)
+{
+	int old = (crossover == INT_MAX) ? 0 : crossover;
+	crossover = (n > 0) ? n : INT_MAX;
+	return old;
+}
+
 int matT(Matrix *res, const Matrix *mat)
 {
 	LOG_INFO("Transposing Matrix of size %dx%d...\n", mat->nrows, mat->ncols);
-	assert((mat->nrows == res->nrows) && (mat->nrows == res->nrows));
-
-	int x, y, idx = 0;
-	for (x = 0; x < mat->ncols; x++) {
-		for (y = 0; y < mat->nrows; y++) {
-			LOG_DEBUG("res->vals[%d] = %.2f, with` mat (%d, %d)\n",
-					  idx, GET(mat, x, y), x, y);
-			res->vals[idx++] = GET(mat, x, y);
-		}
+	if (res == mat) return matTip(res);
+	assert(res->nrows == mat->ncols && res->ncols == mat->nrows);
+
+	int n;
+	if ((n = fixedsize(mat))) {
+		transfixed[n](res->vals, mat->vals);
+		LOG_INFO("Finished transposing matrix\n");
+		return EXIT_SUCCESS;
 	}
 
+	TransArgs args = { res->vals, mat->vals, mat->nrows, mat->ncols };
+	if ((long)mat->nrows * mat->ncols >= TRANS_PARALLEL_SIZE) tprun(transrows, &args);
+	else transrec(&args, 0, mat->nrows, 0, mat->ncols);
+
 	LOG_INFO("Finished transposing matrix\n");
 	return EXIT_SUCCESS;
 }
 
+int matTip(Matrix *mat)
+{
+	LOG_INFO("Transposing Matrix of size %dx%d in place...\n", mat->nrows, mat->ncols);
+
+	int m = mat->nrows, n = mat->ncols;
+	double *a = mat->vals;
+
+	if (m == n) {
+		int bi, bj, i, j, iend, jend;
+		double temp;
+
+		/* Swap every block above the diagonal with its mirror, a pair of
+		 * BLOCK x BLOCK blocks fits in cache together */
+		for (bi = 0; bi < n; bi += BLOCK) {
+			iend = (bi + BLOCK < n) ? bi + BLOCK : n;
+			for (bj = bi; bj < n; bj += BLOCK) {
+				jend = (bj + BLOCK < n) ? bj + BLOCK : n;
+				for (i = bi; i < iend; i++)
+					for (j = (bi == bj) ? i + 1 : bj; j < jend; j++) {
+						temp = a[(size_t)i * n + j];
+						a[(size_t)i * n + j] = a[(size_t)j * n + i];
+						a[(size_t)j * n + i] = temp;
+					}
+			}
+		}
+	} else if (m > 1 && n > 1) {
+		/* Value k = i * n + j moves to j * m + i = k * m mod (mn - 1), the
+		 * first and last values stay put */
+		size_t len = (size_t)m * n - 1;
+		size_t start, k, next;
+		unsigned long *done = calloc(len / 64 + 1, sizeof(unsigned long));
+		double carry, temp;
+		if (!done) DIE("calloc");
+
+		for (start = 1; start < len; start++) {
+			if (done[start / 64] & (1UL << (start % 64))) continue;
+
+			carry = a[start];
+			k = start;
+			do {
+				next = (k * m) % len;
+				temp = a[next];
+				a[next] = carry;
+				carry = temp;
+				done[next / 64] |= 1UL << (next % 64);
+				k = next;
+			} while (k != start);
+		}
+		free(done);
+	}
+
+	mat->nrows = n;
+	mat->ncols = m;
+	LOG_INFO("Finished transposing matrix in place\n");
+	return EXIT_SUCCESS;
+}
+
+int matsyrk(Matrix *res, const Matrix *mat)
+{
+	LOG_INFO("Adding the transpose product of a %dx%d matrix to the result...\n",
+			 mat->nrows, mat->ncols);
+	assert(res->nrows == mat->ncols && res->ncols == mat->ncols);
+
+	SyrkArgs args = { res, mat, NULL };
+	int n = mat->ncols;
+	int nthreads = tpthreads();
+	int nb = (n + BLOCK - 1) / BLOCK;
+	int t, i, j;
+
+	if (nb * (nb + 1) / 2 >= 2 * nthreads || nthreads == 1
+		|| mat->nrows < (long)BLOCK * nthreads) {
+		tprun(syrktiles, &args);
+	} else {
+		size_t size = (size_t)n * n;
+		if (!(args.partial = calloc(size * nthreads, sizeof(double)))) DIE("calloc");
+		tprun(syrkrows, &args);
+		for (t = 0; t < nthreads; t++)
+			for (i = 0; i < n; i++)
+				for (j = 0; j <= i; j++)
+					GET(res, j, i) += args.partial[t * size + i * n + j];
+		free(args.partial);
+	}
+
+	/* Only the lower triangle was updated, mirror it */
+	for (i = 0; i < n; i++)
+		for (j = 0; j < i; j++)
+			GET(res, i, j) = GET(res, j, i);
+
+	LOG_INFO("Finished symmetric rank-k update\n");
+	return EXIT_SUCCESS;
+}
+
 int rref(Matrix *mat)
 {
 	LOG_INFO("Finding rref and rank of Matrix %dx%d\n", mat->nrows, mat->ncols);
 	LOGMAT(mat);
+	LATENCY_START(start);
 
-	double *row, rowi, k, pivot, current;
-	int y, i, next, j = 0, rank = 0;
+	int m = mat->nrows, n = mat->ncols;
+	int j0, j1, w, j, x, y, i, k, best, rank = 0;
+	int pivcols[BLOCK];
+	double pivot, scale, *row, *prow;
 
-	/* loop over all rows */
-	for (y = 0; y < mat->nrows; y++) {
-		if (j >= mat->ncols) break;
-		row = &GET(mat, j, y);
+	/* The panel before elimination, with the same row swaps applied, and
+	 * room for the update. Not needed when the matrix is a single panel */
+	Matrix *orig = NULL, *pivblk = NULL, *pivinv = NULL, *rest = NULL;
+	double *top = NULL;
+	if (n > BLOCK) {
+		orig = initmat(m, BLOCK, NULL, 1);
+		pivblk = initmat(BLOCK, BLOCK, NULL, 1);
+		pivinv = initmat(BLOCK, BLOCK, NULL, 1);
+		rest = initmat(m, BLOCK, NULL, 1);
+		if (!(top = malloc(sizeof(double) * BLOCK * n))) DIE("malloc");
+	}
 
-		/* Find the biggest pivot*/
-		i = y;
-		pivot = *row;
-		for (next = y; next < mat->nrows; next++) {
-			current = GET(mat, j, next);
-			if (fabs(pivot) < fabs(current)) {
-				i = next;
-				pivot = current;
+	for (j0 = 0; j0 < n && rank < m; j0 = j1) {
+		j1 = (j0 + BLOCK < n) ? j0 + BLOCK : n;
+		w = j1 - j0;
+		if (orig)
+			for (y = 0; y < m; y++)
+				memcpy(&GET(orig, 0, y), &GET(mat, j0, y), sizeof(double) * w);
+
+		/* Gauss-Jordan on the panel only, swapping whole rows */
+		k = 0;
+		for (j = j0; j < j1 && rank + k < m; j++) {
+			y = rank + k;
+			best = y;
+			for (i = y + 1; i < m; i++)
+				if (fabs(GET(mat, j, i)) > fabs(GET(mat, j, best))) best = i;
+			if (fabs(pivot = GET(mat, j, best)) <= EPSILON) continue;
+
+			swapRow(mat, y, best, 0);
+			if (orig) swapRow(orig, y, best, 0);
+
+			prow = &GET(mat, 0, y);
+			scale = 1 / pivot;
+			for (i = j; i < j1; i++) prow[i] *= scale;
+			for (i = 0; i < m; i++) {
+				if (i == y || (scale = GET(mat, j, i)) == 0) continue;
+				row = &GET(mat, 0, i);
+				for (x = j; x < j1; x++) row[x] -= scale * prow[x];
 			}
+			pivcols[k++] = j - j0;
 		}
-		LOG_DEBUG("Found best pivot in (%d, %d), with value %.2f\n", j, i, pivot);
-
-		/* Make sure pivot is large enough then reduce pivot to 1*/
-		LOG_DEBUG("Checking that pivot is bigger than EPSILON = %f...\n", EPSILON);
-		if (fabs(pivot) > EPSILON) {
-			swapRow(mat, y, i, j);
-			k = 1 / pivot;
-			scaleRow(mat, y, k, j);
-		} else {
-			LOG_DEBUG("Row of zero detected, moving on to next column\n");
-			j++;
-			y--;
-			continue;
+		LOG_DEBUG("Panel at column %d has %d pivots\n", j0, k);
+
+		/* The panel turned the pivot columns into unit vectors, which is
+		 * X_P = B^-1 X_P and X_rest -= C X_P on the trailing columns, with
+		 * B the pivot rows and C the other rows of the unreduced panel */
+		if (k && j1 < n) {
+			int nt = n - j1;
+			pivblk->nrows = pivblk->ncols = pivinv->nrows = pivinv->ncols = k;
+			for (y = 0; y < k; y++)
+				for (i = 0; i < k; i++)
+					GET(pivblk, i, y) = GET(orig, pivcols[i], rank + y);
+			if (matinv(pivinv, pivblk)) {
+				LOG_ERROR("Pivot block at column %d can't be inverted\n", j0);
+				rank = -1;
+				break;
+			}
+
+			rest->ncols = k;
+			for (y = 0; y < m; y++)
+				for (i = 0; i < k; i++)
+					GET(rest, i, y) = GET(orig, pivcols[i], y);
+
+			memset(top, 0, sizeof(double) * k * nt);
+			gemm(k, nt, k, 1, pivinv->vals, k, &GET(mat, j1, rank), n, top, nt);
+
+			/* The pivot rows are rows [rank, rank + k), skip them */
+			gemm(rank, nt, k, -1, rest->vals, k, top, nt, &GET(mat, j1, 0), n);
+			gemm(m - rank - k, nt, k, -1, &GET(rest, 0, rank + k), k, top, nt,
+				 &GET(mat, j1, rank + k), n);
+			for (y = 0; y < k; y++)
+				memcpy(&GET(mat, j1, rank + y), &top[(size_t)y * nt], sizeof(double) * nt);
+			rest->ncols = BLOCK;
 		}
+		rank += k;
+	}
 
-		/* Try and reduce all values in col j to 0 except current rows one */
-		LOG_INFO("Reducing column %d to zero except for row %d column\n", j, y);
-		for (i = 0; i < mat->nrows; i++) {
-			if (y == i) continue;
+	if (orig) {
+		freemat(orig);
+		freemat(pivblk);
+		freemat(pivinv);
+		freemat(rest);
+		free(top);
+	}
 
-			LOG_DEBUG("mat(%d,%d) = %.2f\n", j, i, GET(mat, j, i));
-			rowi = GET(mat, j, i);
-			LOG_INFO("r%d = r%d - %.2f * r%d\n", i, i, rowi, y);
-			scaleAddToRow(mat, i, -rowi, y, j);
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Finished rref with rank %d\n", rank);
+	return rank;
+}
+
+int matrank(const Matrix *mat)
+{
+	LOG_INFO("Finding the rank of a %dx%d Matrix...\n", mat->nrows, mat->ncols);
+	LATENCY_START(start);
+
+	int m = mat->nrows, n = mat->ncols;
+	int i, j, x, best, rank = 0;
+	double big = 0, tol, l, *row, *prow;
+	Matrix *work = initmat(m, n, mat->vals, 1);
+
+	/* The tolerance is EPSILON relative to the largest value, so the rank
+	 * does not depend on the units of the features */
+	for (i = 0; i < m * n; i++) big = fmax(big, fabs(work->vals[i]));
+	tol = EPSILON * big;
+
+	/* Row echelon form only, the rows above the pivot are left alone which
+	 * is about a third of the work of Gauss-Jordan */
+	for (j = 0; j < n && rank < m; j++) {
+		best = rank;
+		for (i = rank + 1; i < m; i++)
+			if (fabs(GET(work, j, i)) > fabs(GET(work, j, best))) best = i;
+		if (fabs(GET(work, j, best)) <= tol) continue;
+
+		swapRow(work, rank, best, j);
+		prow = &GET(work, 0, rank);
+		for (i = rank + 1; i < m; i++) {
+			row = &GET(work, 0, i);
+			if ((l = row[j] / prow[j]) == 0) continue;
+			for (x = j + 1; x < n; x++) row[x] -= l * prow[x];
 		}
-		LOG_INFO("Finished reducing column %d\n", j);
-		j++;
 		rank++;
 	}
 
+	freemat(work);
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Finished finding rank %d\n", rank);
 	return rank;
 }
 
+int matchol(Matrix *mat)
+{
+	LOG_INFO("Cholesky decomposition of %dx%d Matrix...\n", mat->nrows, mat->ncols);
+	assert(mat->nrows == mat->ncols);
+
+	int i, j, n = mat->nrows;
+	double d, *rowi, *rowj;
+
+	/* Row by row, so every sum is a dot product of two contiguous rows */
+	for (j = 0; j < n; j++) {
+		rowj = &GET(mat, 0, j);
+		d = rowj[j] - rowdot(rowj, rowj, j);
+		if (d <= EPSILON) {
+			LOG_WARN("Matrix is not positive definite at column %d\n", j);
+			return -1;
+		}
+		rowj[j] = sqrt(d);
+		memset(&rowj[j + 1], 0, sizeof(double) * (n - j - 1));
+
+		for (i = j + 1; i < n; i++) {
+			rowi = &GET(mat, 0, i);
+			rowi[j] = (rowi[j] - rowdot(rowi, rowj, j)) / rowj[j];
+		}
+	}
+
+	LOG_INFO("Finished Cholesky decomposition\n");
+	return EXIT_SUCCESS;
+}
+
+void soltri(const Matrix *mat, double *vec, int trans)
+{
+	int i, k, n = mat->nrows;
+	const double *row;
+
+	if (!trans) {
+		for (i = 0; i < n; i++) {
+			row = &GET(mat, 0, i);
+			vec[i] = (vec[i] - rowdot(row, vec, i)) / row[i];
+		}
+	} else {
+		/* Walk the rows of L backwards instead of its columns */
+		for (i = n - 1; i >= 0; i--) {
+			row = &GET(mat, 0, i);
+			vec[i] /= row[i];
+			for (k = 0; k < i; k++) vec[k] -= row[k] * vec[i];
+		}
+	}
+}
+
+int solchol(const Matrix *mat, Matrix *chol, double *res, const double *vec)
+{
+	LOG_INFO("Solve A:%dx%d Ax=y for x, using Cholesky decomposition\n",
+			 mat->nrows, mat->ncols);
+	assert(mat->nrows == mat->ncols);
+	assert((mat != chol) && ((chol ? chol->vals : NULL) != mat->vals));
+	LATENCY_START(start);
+
+	int cholf = !chol, err;
+	if (!chol) chol = initmat(mat->nrows, mat->ncols, mat->vals, 1);
+
+	if (!(err = matchol(chol))) {
+		if (res != vec) memcpy(res, vec, sizeof(double) * mat->nrows);
+		soltri(chol, res, 0);
+		soltri(chol, res, 1);
+	}
+
+	if (cholf) freemat(chol);
+	if (!err) LATENCY_STOP(LAT_SOLVE, start);
+	return err ? -1 : EXIT_SUCCESS;
+}
+
 int solinv(const Matrix *mat, Matrix *lu, double *res, const double *vec)
 {
 	LOG_INFO("Solve A:%dx%d Ax=y for x, using LU decomposition\n", mat->nrows, mat->ncols);
 	LOGMAT(mat);
 	assert(mat->nrows == mat->ncols);
 	assert((mat != lu) && ((lu ? lu->vals : NULL) != mat->vals));
+	LATENCY_START(start);
+
+	int luf, err, n;
 
-	double *row, rowi, k, pivot, current;
-	int y, x = 0, i, next, luf;
+	/* Small systems are solved on the stack unless the factors are wanted */
+	if (!lu && (n = fixedsize(mat))) {
+		if ((err = solvefixed[n](res, mat->vals, vec))) return -1;
+		LATENCY_STOP(LAT_SOLVE, start);
+		return EXIT_SUCCESS;
+	}
 
 	/* Store L and U together with implicit diagonal 1 for L */
 	luf = !lu;
@@ -309,38 +1477,219 @@ int solinv(const Matrix *mat, Matrix *lu, double *res, const double *vec)
 	if (!lu) return EXIT_FAILURE;
 
 	/* My Pivot vector to keep track of the swaps */
-	int *pivots = malloc(sizeof(size_t) * mat->nrows);
-	if (!pivots) { freemat(lu); return EXIT_FAILURE;}
+	int *pivots = malloc(sizeof(int) * mat->nrows);
+	if (!pivots) { if (luf) freemat(lu); return EXIT_FAILURE; }
 
-	/* Form the L and U matrices */
-	for (y = 0; y < lu->nrows; y++) {
+	/* Form the L and U matrices then substitute forwards and back */
+	if (!(err = ludecomp(lu, pivots))) {
+		if (res != vec) memcpy(res, vec, sizeof(double) * mat->nrows);
+		lusolve(lu, pivots, res);
+	}
 
-		/* Find the biggest pivot*/
-		i = y;
-		pivot = GET(lu, x, y);
-		for (next = y; next < mat->nrows; next++) {
-			current = GET(lu, x, next);
-			if (fabs(pivot) < fabs(current)) {
-				i = next;
-				pivot = current;
+	free(pivots);
+	if (luf) freemat(lu);
+	if (!err) LATENCY_STOP(LAT_SOLVE, start);
+	return err ? -1 : EXIT_SUCCESS;
+}
+
+int matinv(Matrix *res, Matrix *mat)
+{
+	LOG_INFO("Finding the inverse of a %dx%d Matrix...\n", mat->nrows, mat->ncols);
+	assert(mat->nrows == mat->ncols);
+	assert(res->nrows == mat->nrows && res->ncols == mat->ncols && res != mat);
+	LATENCY_START(start);
+
+	int n = mat->nrows;
+	int i, err, temp;
+
+	if (fixedsize(mat)) {
+		if (invfixed[n](res->vals, mat->vals)) {
+			LOG_WARN("Matrix is singular, it has no inverse\n");
+			return -1;
+		}
+		LATENCY_STOP(LAT_SOLVE, start);
+		LOG_INFO("Finished finding the inverse\n");
+		return EXIT_SUCCESS;
+	}
+
+	Matrix *lu = initmat(n, n, mat->vals, 1);
+	int *pivots = malloc(sizeof(int) * n);
+	int *perm = malloc(sizeof(int) * n);
+	if (!pivots || !perm) DIE("malloc");
+
+	if (!(err = ludecomp(lu, pivots))) {
+		/* Replay the row swaps on the identity */
+		for (i = 0; i < n; i++) perm[i] = i;
+		for (i = 0; i < n; i++) {
+			temp = perm[i];
+			perm[i] = perm[pivots[i]];
+			perm[pivots[i]] = temp;
+		}
+
+		InvArgs args = { lu, perm, res };
+		if (n > BLOCK) tprun(invcols, &args);
+		else           invcols(&args, 0, 1);
+	}
+
+	freemat(lu);
+	free(pivots);
+	free(perm);
+
+	if (err) {
+		LOG_WARN("Matrix is singular, it has no inverse\n");
+		return -1;
+	}
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Finished finding the inverse\n");
+	return EXIT_SUCCESS;
+}
+
+int matsvd(const Matrix *mat, int k, Matrix *u, double *s, Matrix *v)
+{
+	LOG_INFO("Singular value decomposition of a %dx%d Matrix...\n",
+			 mat->nrows, mat->ncols);
+	LATENCY_START(start);
+
+	int m = mat->nrows, n = mat->ncols;
+	int tall = m >= n;
+	int nr = tall ? n : m;        /* Rows to make orthogonal */
+	int len = tall ? m : n;       /* Length of those rows */
+	int even = nr + (nr & 1);     /* Round robin needs an even count */
+	int i, j, r, sweep, rank, temp;
+	double tol;
+
+	if (k <= 0 || k > nr) k = nr;
+	assert(!u || (u->nrows == m && u->ncols == k));
+	assert(!v || (v->nrows == n && v->ncols == k));
+
+	/* Rows of W are the columns of A, or its rows if A is wide, so every
+	 * rotation works on contiguous memory */
+	double *w = malloc(sizeof(double) * nr * len);
+	double *q = calloc((size_t)nr * nr, sizeof(double));
+	double *norms = malloc(sizeof(double) * nr);
+	int *order = malloc(sizeof(int) * nr);
+	int *ring = malloc(sizeof(int) * even);
+	int *pairs = malloc(sizeof(int) * even);
+	if (!w || !q || !norms || !order || !ring || !pairs) DIE("malloc");
+
+	if (tall) {
+		for (i = 0; i < m; i++)
+			for (j = 0; j < n; j++)
+				w[(size_t)j * m + i] = GET(mat, j, i);
+	} else {
+		memcpy(w, mat->vals, sizeof(double) * m * n);
+	}
+	for (i = 0; i < nr; i++) q[(size_t)i * nr + i] = 1;
+	for (i = 0; i < even; i++) ring[i] = i;
+
+	JacobiArgs args = { w, q, nr, len, pairs, 0, 1 };
+	int parallel = (long)nr * len >= JACOBI_PARALLEL_WORK;
+
+	for (sweep = 0; sweep < JACOBI_MAX_SWEEPS && args.rotated; sweep++) {
+		args.rotated = 0;
+
+		/* Round robin, every pair of rows meets once per sweep */
+		for (r = 0; r < even - 1; r++) {
+			args.npairs = 0;
+			for (i = 0; i < even / 2; i++) {
+				if (ring[i] >= nr || ring[even - 1 - i] >= nr) continue;
+				pairs[2 * args.npairs] = ring[i];
+				pairs[2 * args.npairs + 1] = ring[even - 1 - i];
+				args.npairs++;
 			}
+			if (parallel) tprun(jacobiround, &args);
+			else          jacobiround(&args, 0, 1);
+
+			/* Keep ring[0] in place and turn the rest one step */
+			temp = ring[even - 1];
+			for (i = even - 1; i > 1; i--) ring[i] = ring[i - 1];
+			if (even > 1) ring[1] = temp;
 		}
-		LOG_DEBUG("Found best pivot in (%d, %d), with value %.2f\n", x, i, pivot);
+		LOG_DEBUG("Finished Jacobi sweep %d\n", sweep);
+	}
+	if (args.rotated) {
+		LOG_WARN("Jacobi SVD did not converge in %d sweeps\n", sweep);
+	}
 
-		/* Make sure pivot is large enough then reduce pivot to 1*/
-		LOG_DEBUG("Checking that pivot is bigger than EPSILON = %f...\n", EPSILON);
-		if (fabs(pivot) > EPSILON) {
-			pivots[y] = i;
-			swapRow(mat, y, i, x);
-			k = 1 / pivot;
-		} else {
-			LOG_WARN("zero pivot detected, singular matrix, decomposition won't work\n");
-			return EXIT_FAILURE;
+	/* The lengths of the rows are the singular values, sort them big to small */
+	for (i = 0; i < nr; i++) {
+		norms[i] = sqrt(rowdot(&w[(size_t)i * len], &w[(size_t)i * len], len));
+		order[i] = i;
+	}
+	for (i = 1; i < nr; i++)
+		for (j = i; j > 0 && norms[order[j]] > norms[order[j - 1]]; j--) {
+			temp = order[j]; order[j] = order[j - 1]; order[j - 1] = temp;
 		}
 
-		/* Reduce U with row operation and set L element */
+	tol = (m > n ? m : n) * norms[order[0]] * DBL_EPSILON;
+	for (rank = 0; rank < nr && norms[order[rank]] > tol; rank++);
+
+	/* Normalised rows of W are one set of singular vectors, rows of Q the other */
+	Matrix *wvec = tall ? u : v;
+	Matrix *qvec = tall ? v : u;
+	double scale;
+	for (r = 0; r < k; r++) {
+		i = order[r];
+		s[r] = norms[i];
+		scale = (norms[i] > tol) ? 1 / norms[i] : 0;
+		if (wvec)
+			for (j = 0; j < len; j++) GET(wvec, r, j) = w[(size_t)i * len + j] * scale;
+		if (qvec)
+			for (j = 0; j < nr; j++) GET(qvec, r, j) = q[(size_t)i * nr + j];
 	}
 
-	if (!luf) freemat(lu);
+	free(w);
+	free(q);
+	free(norms);
+	free(order);
+	free(ring);
+	free(pairs);
+
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Finished SVD with rank %d after %d sweeps\n", rank, sweep);
+	return rank;
+}
+
+int matginv(Matrix *res, Matrix *mat)
+{
+	LOG_INFO("Finding the psuodoinverse of a %dx%d Matrix...\n", mat->nrows, mat->ncols);
+	assert(res->nrows == mat->ncols && res->ncols == mat->nrows);
+
+	int m = mat->nrows, n = mat->ncols;
+	int k = (m < n) ? m : n;
+	int i, j, l, rank;
+	double scale, *row;
+	const double *ul;
+
+	Matrix *u = initmat(m, k, NULL, 1);
+	Matrix *v = initmat(n, k, NULL, 1);
+	Matrix *ut = initmat(k, m, NULL, 1);
+	double *s = malloc(sizeof(double) * k);
+	if (!s) DIE("malloc");
+
+	if ((rank = matsvd(mat, k, u, s, v)) >= 0) {
+		for (i = 0; i < m; i++)
+			for (l = 0; l < k; l++)
+				GET(ut, i, l) = GET(u, l, i);
+
+		/* A+ = V S+ U^T, summed one outer product per non-zero value */
+		memset(res->vals, 0, sizeof(double) * n * m);
+		for (l = 0; l < rank; l++) {
+			ul = &GET(ut, 0, l);
+			for (i = 0; i < n; i++) {
+				scale = GET(v, l, i) / s[l];
+				row = &GET(res, 0, i);
+				for (j = 0; j < m; j++) row[j] += scale * ul[j];
+			}
+		}
+	}
+
+	freemat(u);
+	freemat(v);
+	freemat(ut);
+	free(s);
+
+	if (rank < 0) return -1;
+	LOG_INFO("Finished psuodoinverse of rank %d\n", rank);
 	return EXIT_SUCCESS;
 }
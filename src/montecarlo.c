@@ -0,0 +1,299 @@
+/**
+ * @file    montecarlo.c
+ * @brief   Parallel bootstrap resampling of returns and regression fits
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "montecarlo.h"
+#include "symmat.h"
+#include "error.h"
+#include "latency.h"
+#include "logging.h"
+#include "threadpool.h"
+
+/*** System Includes ***/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Type Definitions ***/
+
+typedef struct McArgs McArgs;
+
+/* Computes the statistic of resample r from its rows idx */
+typedef void (*McStat)(McArgs *a, const long *idx, long r, void *scratch);
+
+/* One statistic over all the resamples, split over the threads */
+struct McArgs {
+	const McOptions *opt;
+	long n;
+	McStat stat;
+	const double *returns;
+	const Matrix *x;
+	const double *y;
+	double *out;
+	int err;        /* Set by any thread whose fit fails */
+};
+
+/*** Helper Functions ***/
+
+/* splitmix64, expands a seed into the state of the generators */
+static inline uint64_t splitmix(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static double sharpeof(McArgs *a, const long *idx)
+{
+	double mean = 0, var = 0, d, r;
+	long i;
+
+	/* Welford, stable for returns far from 0 */
+	for (i = 0; i < a->n; i++) {
+		r = a->returns[idx[i]];
+		d = r - mean;
+		mean += d / (i + 1);
+		var += d * (r - mean);
+	}
+	var /= a->n - 1;
+	return (var > 0) ? mean / sqrt(var) : 0;
+}
+
+static void statsharpe(McArgs *a, const long *idx, long r, void *scratch)
+{
+	(void)scratch;
+	a->out[r] = sharpeof(a, idx);
+}
+
+static void statdrawdown(McArgs *a, const long *idx, long r, void *scratch)
+{
+	double cum = 0, peak = 0, worst = 0;
+	long i;
+	(void)scratch;
+
+	for (i = 0; i < a->n; i++) {
+		cum += a->returns[idx[i]];
+		if (cum > peak) peak = cum;
+		if (peak - cum > worst) worst = peak - cum;
+	}
+	a->out[r] = worst;
+}
+
+/* Gram matrix of the drawn rows, a row drawn twice is added twice */
+static void statcoef(McArgs *a, const long *idx, long r, void *scratch)
+{
+	SymMatrix *gram = scratch;
+	int j, p = a->x->ncols;
+	double *coef = &a->out[r * p];
+	const double *row;
+	long i;
+
+	memset(gram->vals, 0, sizeof(double) * SIDX(0, p));
+	memset(coef, 0, sizeof(double) * p);
+	for (i = 0; i < a->n; i++) {
+		row = &GET(a->x, 0, idx[i]);
+		symrank1(gram, 1, row);
+		for (j = 0; j < p; j++) coef[j] += a->y[idx[i]] * row[j];
+	}
+
+	if (symchol(gram)) {
+		__atomic_store_n(&a->err, -1, __ATOMIC_RELAXED);
+		return;
+	}
+	symcholsolve(gram, coef);
+}
+
+/* Resample r goes to thread r % nthreads, which is seeded by r alone so
+ * the split does not change the result */
+static void mctask(void *arg, int id, int nthreads)
+{
+	McArgs *a = arg;
+	long r, *idx = malloc(sizeof(long) * a->n);
+	SymMatrix *gram = (a->stat == statcoef) ? initsym(a->x->ncols) : NULL;
+	if (!idx) DIE("malloc");
+
+	for (r = id; r < a->opt->nresample; r += nthreads) {
+		mcresample(idx, a->n, a->opt, r);
+		a->stat(a, idx, r, gram);
+	}
+
+	free(idx);
+	if (gram) freesym(gram);
+}
+
+static int cmpdouble(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/*** Public Functions ***/
+
+void mcseed(McRng *rng, unsigned long seed, long stream)
+{
+	uint64_t state = seed, mix = stream;
+	int i, l;
+
+	/* Mix the stream in through its own hash, nearby streams of nearby
+	 * seeds start from unrelated states */
+	state ^= splitmix(&mix);
+	for (l = 0; l < MC_LANES; l++)
+		for (i = 0; i < 4; i++) rng->s[i][l] = splitmix(&state);
+}
+
+void mcnext(McRng *rng, uint64_t *out)
+{
+	uint64_t t[MC_LANES];
+	int l;
+
+	/* xoshiro256** on every lane, the loops vectorize across the lanes */
+	for (l = 0; l < MC_LANES; l++) {
+		out[l] = rotl(rng->s[1][l] * 5, 7) * 9;
+		t[l] = rng->s[1][l] << 17;
+	}
+	for (l = 0; l < MC_LANES; l++) {
+		rng->s[2][l] ^= rng->s[0][l];
+		rng->s[3][l] ^= rng->s[1][l];
+		rng->s[1][l] ^= rng->s[2][l];
+		rng->s[0][l] ^= rng->s[3][l];
+		rng->s[2][l] ^= t[l];
+		rng->s[3][l] = rotl(rng->s[3][l], 45);
+	}
+}
+
+void mcdefaults(McOptions *opt)
+{
+	opt->nresample = 2000;
+	opt->block = 1;
+	opt->seed = 0;
+}
+
+void mcresample(long *idx, long n, const McOptions *opt, long r)
+{
+	McOptions defaults;
+	if (!opt) {
+		mcdefaults(&defaults);
+		opt = &defaults;
+	}
+
+	McRng rng;
+	uint64_t draws[MC_LANES];
+	long i = 0, k, start, block = (opt->block > 1) ? opt->block : 1;
+	int l;
+
+	mcseed(&rng, opt->seed, r);
+	while (i < n) {
+		mcnext(&rng, draws);
+		for (l = 0; l < MC_LANES && i < n; l++) {
+			/* The top 53 bits as a uniform double, scaled to a row */
+			start = (long)((draws[l] >> 11) * 0x1p-53 * n);
+			for (k = 0; k < block && i < n; k++, i++)
+				idx[i] = (start + k < n) ? start + k : start + k - n;
+		}
+	}
+}
+
+int mcsharpe(const double *returns, long n, const McOptions *opt, double *sharpe)
+{
+	McOptions defaults;
+	if (!opt) {
+		mcdefaults(&defaults);
+		opt = &defaults;
+	}
+	LOG_INFO("Bootstrapping the Sharpe ratio of %ld returns %d times...\n", n, opt->nresample);
+	if (n < 2) {
+		LOG_ERROR("Can't bootstrap %ld returns\n", n);
+		return -1;
+	}
+	LATENCY_START(start);
+
+	McArgs args = { opt, n, statsharpe, returns, NULL, NULL, sharpe, 0 };
+	tprun(mctask, &args);
+
+	LATENCY_STOP(LAT_TRAIN, start);
+	LOG_INFO("Finished bootstrap\n");
+	return EXIT_SUCCESS;
+}
+
+int mcdrawdown(const double *returns, long n, const McOptions *opt, double *drawdown)
+{
+	McOptions defaults;
+	if (!opt) {
+		mcdefaults(&defaults);
+		opt = &defaults;
+	}
+	LOG_INFO("Bootstrapping the drawdown of %ld returns %d times...\n", n, opt->nresample);
+	if (n < 1) {
+		LOG_ERROR("Can't bootstrap %ld returns\n", n);
+		return -1;
+	}
+	LATENCY_START(start);
+
+	McArgs args = { opt, n, statdrawdown, returns, NULL, NULL, drawdown, 0 };
+	tprun(mctask, &args);
+
+	LATENCY_STOP(LAT_TRAIN, start);
+	LOG_INFO("Finished bootstrap\n");
+	return EXIT_SUCCESS;
+}
+
+int mccoef(const Matrix *x, const double *y, const McOptions *opt, Matrix *coefs)
+{
+	McOptions defaults;
+	if (!opt) {
+		mcdefaults(&defaults);
+		opt = &defaults;
+	}
+	LOG_INFO("Bootstrapping the fit of %dx%d %d times...\n", x->nrows, x->ncols, opt->nresample);
+	assert(coefs->nrows == opt->nresample && coefs->ncols == x->ncols);
+	LATENCY_START(start);
+
+	McArgs args = { opt, x->nrows, statcoef, NULL, x, y, coefs->vals, 0 };
+	tprun(mctask, &args);
+
+	if (args.err) {
+		LOG_WARN("A resample of the rows is singular\n");
+		return -1;
+	}
+	LATENCY_STOP(LAT_TRAIN, start);
+	LOG_INFO("Finished bootstrap\n");
+	return EXIT_SUCCESS;
+}
+
+void mcinterval(const double *stats, int count, int stride, double level, double *lo, double *hi)
+{
+	assert(count > 0 && level > 0 && level < 1);
+
+	double *sorted = malloc(sizeof(double) * count);
+	double pos, frac;
+	int i, k;
+	if (!sorted) DIE("malloc");
+
+	for (i = 0; i < count; i++) sorted[i] = stats[(long)i * stride];
+	qsort(sorted, count, sizeof(double), cmpdouble);
+
+	/* Linear between the two closest order statistics */
+	pos = (1 - level) / 2 * (count - 1);
+	k = (int)pos;
+	frac = pos - k;
+	*lo = sorted[k] + ((k + 1 < count) ? frac * (sorted[k + 1] - sorted[k]) : 0);
+	pos = (1 + level) / 2 * (count - 1);
+	k = (int)pos;
+	frac = pos - k;
+	*hi = sorted[k] + ((k + 1 < count) ? frac * (sorted[k + 1] - sorted[k]) : 0);
+
+	free(sorted);
+}
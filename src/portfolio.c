@@ -0,0 +1,348 @@
+/**
+ * @file    portfolio.c
+ * @brief   Mean-variance portfolio weights from an active-set QP solver
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "portfolio.h"
+#include "error.h"
+#include "latency.h"
+#include "logging.h"
+
+/*** System Includes ***/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Helper Functions ***/
+
+/* Starts from the last weights, or 0 on a cold start, moved inside the
+ * limits. What is left over or missing of the budget goes to or comes from
+ * the assets with the best or worst returns first, so a cold start is a
+ * vertex with at most one free asset */
+static int feasible(Portfolio *port, const double *c, double *w)
+{
+	int i, best, n = port->n;
+	double excess = -port->budget, room;
+
+	for (i = 0; i < n; i++) {
+		w[i] = port->solved ? port->weights[i] : 0;
+		w[i] = fmin(fmax(w[i], port->lo[i]), port->hi[i]);
+		excess += w[i];
+	}
+
+	while (fabs(excess) > EPSILON) {
+		best = -1;
+		for (i = 0; i < n; i++) {
+			if ((excess < 0) ? w[i] >= port->hi[i] : w[i] <= port->lo[i]) continue;
+			if (best < 0 || ((excess < 0) ? c[i] > c[best] : c[i] < c[best])) best = i;
+		}
+		if (best < 0) {
+			LOG_WARN("The limits do not allow a budget of %g\n", port->budget);
+			return -1;
+		}
+
+		if (excess < 0) {
+			room = port->hi[best] - w[best];
+			w[best] = (room <= -excess) ? port->hi[best] : w[best] - excess;
+			excess += fmin(room, -excess);
+		} else {
+			room = w[best] - port->lo[best];
+			w[best] = (room <= excess) ? port->lo[best] : w[best] - excess;
+			excess -= fmin(room, excess);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if (w[i] <= port->lo[i]) {
+			w[i] = port->lo[i];
+			port->state[i] = PORT_LOWER;
+		} else if (w[i] >= port->hi[i]) {
+			w[i] = port->hi[i];
+			port->state[i] = PORT_UPPER;
+		} else {
+			port->state[i] = PORT_FREE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/* Factors the block of cov of the free assets from scratch */
+static int factor(Portfolio *port, const SymMatrix *cov)
+{
+	int i, p, q;
+	double *row;
+
+	port->nfree = 0;
+	for (i = 0; i < port->n; i++)
+		if (port->state[i] == PORT_FREE) port->order[port->nfree++] = i;
+
+	for (p = 0; p < port->nfree; p++) {
+		row = &port->chol->vals[SIDX(0, p)];
+		for (q = 0; q <= p; q++) row[q] = SGET(cov, port->order[q], port->order[p]);
+	}
+
+	SymMatrix view = { port->nfree, port->chol->vals };
+	return port->nfree ? symchol(&view) : EXIT_SUCCESS;
+}
+
+/* Adds asset j as the last row of the factor, a triangular solve for the
+ * new row and a square root for its diagonal */
+static int addfree(Portfolio *port, const SymMatrix *cov, int j)
+{
+	int p, nf = port->nfree;
+	double d, *row = &port->chol->vals[SIDX(0, nf)];
+	SymMatrix view = { nf, port->chol->vals };
+
+	for (p = 0; p < nf; p++) row[p] = SGET(cov, j, port->order[p]);
+	symsoltri(&view, row, 0);
+
+	d = SGET(cov, j, j);
+	for (p = 0; p < nf; p++) d -= row[p] * row[p];
+	if (d <= EPSILON) {
+		LOG_WARN("Asset %d is a combination of the free assets\n", j);
+		return -1;
+	}
+
+	row[nf] = sqrt(d);
+	port->order[nf] = j;
+	port->nfree++;
+	port->state[j] = PORT_FREE;
+	return EXIT_SUCCESS;
+}
+
+/* Takes row and column k out of the factor. The rows below k shift up a
+ * place, and their block picks up the part of column k it lost with a
+ * rank-1 update by Givens rotations */
+static void dropfree(Portfolio *port, int k)
+{
+	int i, j, nf = port->nfree, m = nf - 1 - k;
+	double *x = port->work, *src, *dst, r, c, s, lj;
+	double *vals = port->chol->vals;
+
+	for (i = k + 1; i < nf; i++) {
+		src = &vals[SIDX(0, i)];
+		dst = &vals[SIDX(0, i - 1)];
+		x[i - k - 1] = src[k];
+		memmove(dst, src, sizeof(double) * k);
+		memmove(&dst[k], &src[k + 1], sizeof(double) * (i - k));
+	}
+
+	for (j = 0; j < m; j++) {
+		lj = vals[SIDX(k + j, k + j)];
+		r = hypot(lj, x[j]);
+		c = r / lj;
+		s = x[j] / lj;
+		vals[SIDX(k + j, k + j)] = r;
+		for (i = j + 1; i < m; i++) {
+			double *lij = &vals[SIDX(k + j, k + i)];
+			*lij = (*lij + s * x[i]) / c;
+			x[i] = c * x[i] - s * *lij;
+		}
+	}
+
+	memmove(&port->order[k], &port->order[k + 1], sizeof(int) * m);
+	port->nfree--;
+}
+
+/* The step p_F to the minimum over the free assets with the others held
+ * at their limits. KKT: cov_FF p_F = -g_F - nu 1 and sum(p_F) = the budget
+ * still missing, both solves go through the factor. Returns nu */
+static double substep(Portfolio *port, const double *g, double missing, double *step)
+{
+	int p, nf = port->nfree;
+	double *b = port->work, suma = 0, sumb = 0, nu;
+	SymMatrix view = { nf, port->chol->vals };
+
+	for (p = 0; p < nf; p++) {
+		step[p] = -g[port->order[p]];
+		b[p] = 1;
+	}
+	symcholsolve(&view, step);
+	symcholsolve(&view, b);
+	for (p = 0; p < nf; p++) {
+		suma += step[p];
+		sumb += b[p];
+	}
+
+	nu = (suma - missing) / sumb;
+	for (p = 0; p < nf; p++) step[p] -= nu * b[p];
+	return nu;
+}
+
+/* g += cov dw for a dw that is only non zero on the free assets */
+static void gradstep(const Portfolio *port, const SymMatrix *cov, const double *dw, double *g)
+{
+	int i, j, p;
+	const double *row;
+
+	for (p = 0; p < port->nfree; p++) {
+		j = port->order[p];
+		if (dw[p] == 0) continue;
+		row = &cov->vals[SIDX(0, j)];
+		for (i = 0; i <= j; i++) g[i] += row[i] * dw[p];
+		for (i = j + 1; i < cov->n; i++) g[i] += cov->vals[SIDX(j, i)] * dw[p];
+	}
+}
+
+/*** Public Functions ***/
+
+Portfolio *initport(int n)
+{
+	LOG_INFO("Creating portfolio of %d assets...\n", n);
+	assert(n > 0);
+
+	Portfolio *port = calloc(1, sizeof(Portfolio));
+	if (!port) DIE("calloc");
+
+	port->n = n;
+	port->budget = 1;
+	port->lo = calloc(n, sizeof(double));
+	port->hi = malloc(sizeof(double) * n);
+	port->weights = calloc(n, sizeof(double));
+	port->state = calloc(n, sizeof(int));
+	port->order = malloc(sizeof(int) * n);
+	port->work = malloc(sizeof(double) * n);
+	if (!port->lo || !port->hi || !port->weights || !port->state
+		|| !port->order || !port->work) DIE("malloc");
+	port->chol = initsym(n);
+
+	int i;
+	for (i = 0; i < n; i++) port->hi[i] = HUGE_VAL;
+
+	return port;
+}
+
+void freeport(Portfolio *port)
+{
+	freesym(port->chol);
+	free(port->lo);
+	free(port->hi);
+	free(port->weights);
+	free(port->state);
+	free(port->order);
+	free(port->work);
+	free(port);
+}
+
+int portsolve(Portfolio *port, const SymMatrix *cov, const double *mu, double gamma)
+{
+	LOG_INFO("Solving portfolio of %d assets%s...\n", port->n,
+			 port->solved ? " from the last solution" : "");
+	assert(cov->n == port->n && gamma > 0);
+	LATENCY_START(start);
+
+	int i, p, best, limit = PORT_FREE, n = port->n, maxiter = PORT_MAX_ITER * n + 10;
+	double alpha, t, nu, worst, lambda, missing;
+	double *w = malloc(sizeof(double) * n);
+	double *c = malloc(sizeof(double) * n);
+	double *g = malloc(sizeof(double) * n);
+	double *step = malloc(sizeof(double) * n);
+	if (!w || !c || !g || !step) DIE("malloc");
+
+	for (i = 0; i < n; i++) c[i] = mu[i] / gamma;
+	port->iters = 0;
+	if (feasible(port, c, w) || factor(port, cov)) goto fail;
+
+	/* The gradient cov w - c, kept up to date as the free assets move */
+	symmv(cov, w, g);
+	for (i = 0; i < n; i++) g[i] -= c[i];
+
+	while (port->iters <= maxiter) {
+		missing = port->budget;
+		for (i = 0; i < n; i++) missing -= w[i];
+		nu = port->nfree ? substep(port, g, missing, step) : 0;
+
+		/* Step towards the minimum until a free asset hits a limit. Which
+		 * limit is kept here, a step scaled by alpha = 0 has no sign */
+		alpha = 1;
+		best = -1;
+		for (p = 0; p < port->nfree; p++) {
+			i = port->order[p];
+			if (w[i] + step[p] < port->lo[i]) {
+				t = (port->lo[i] - w[i]) / step[p];
+				if (t < alpha) limit = PORT_LOWER;
+			} else if (w[i] + step[p] > port->hi[i]) {
+				t = (port->hi[i] - w[i]) / step[p];
+				if (t < alpha) limit = PORT_UPPER;
+			} else {
+				continue;
+			}
+			if (t < alpha) {
+				alpha = t;
+				best = p;
+			}
+		}
+		for (p = 0; p < port->nfree; p++) {
+			step[p] *= alpha;
+			w[port->order[p]] += step[p];
+		}
+		gradstep(port, cov, step, g);
+
+		if (best >= 0) {
+			i = port->order[best];
+			port->state[i] = limit;
+			w[i] = (limit == PORT_LOWER) ? port->lo[i] : port->hi[i];
+			dropfree(port, best);
+			port->iters++;
+			continue;
+		}
+
+		/* At the minimum of this active set, free the asset whose limit
+		 * multiplier is the most negative. With nothing free the budget
+		 * multiplier is any nu that keeps the others at or above 0, if
+		 * there is none it is taken halfway so both ends can be freed */
+		if (!port->nfree) {
+			double nulo = -HUGE_VAL, nuhi = HUGE_VAL;
+			for (i = 0; i < n; i++) {
+				if (port->lo[i] == port->hi[i]) continue;
+				if (port->state[i] == PORT_LOWER) nulo = fmax(nulo, -g[i]);
+				else                              nuhi = fmin(nuhi, -g[i]);
+			}
+			nu = (nulo <= nuhi) ? nulo : (nulo + nuhi) / 2;
+		}
+
+		worst = -EPSILON;
+		best = -1;
+		for (i = 0; i < n; i++) {
+			if (port->state[i] == PORT_FREE || port->lo[i] == port->hi[i]) continue;
+			lambda = (port->state[i] == PORT_LOWER) ? g[i] + nu : -(g[i] + nu);
+			if (lambda < worst) {
+				worst = lambda;
+				best = i;
+			}
+		}
+		if (best < 0) break;
+		if (addfree(port, cov, best)) goto fail;
+		port->iters++;
+	}
+
+	if (port->iters > maxiter) {
+		LOG_WARN("Portfolio did not converge in %d iterations\n", maxiter);
+		goto fail;
+	}
+
+	memcpy(port->weights, w, sizeof(double) * n);
+	port->solved = 1;
+	free(w);
+	free(c);
+	free(g);
+	free(step);
+
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Solved portfolio, %d free assets after %d changes\n", port->nfree, port->iters);
+	return port->iters;
+
+fail:
+	port->solved = 0;
+	free(w);
+	free(c);
+	free(g);
+	free(step);
+	return -1;
+}
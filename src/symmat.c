@@ -0,0 +1,237 @@
+/**
+ * @file    symmat.c
+ * @brief   Symmetric matrices stored as their packed lower triangle
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "symmat.h"
+#include "error.h"
+#include "latency.h"
+#include "logging.h"
+#include "threadpool.h"
+
+/*** System Includes ***/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+/* Side of the triangle tiles the rank-k update is split into */
+#define SYM_BLOCK 64
+
+/* Rows of the update added to a tile before moving to the next tile */
+#define SYM_ROWS 256
+
+/* Rank-k updates with at least this much work (k * n^2) use the thread pool */
+#define SYM_PARALLEL_WORK (1L << 18)
+
+/*** Helper Functions ***/
+
+static double packdot(const double *a, const double *b, int len)
+{
+	double sum = 0;
+	int i;
+	for (i = 0; i < len; i++) sum += a[i] * b[i];
+	return sum;
+}
+
+typedef struct {
+	SymMatrix *sym;
+	const Matrix *mat;
+	double alpha;
+} SymArgs;
+
+/* Adds rows [r0, r1) of alpha * mat^T mat to the tile (i0..i1, j0..j1),
+ * a packed row is contiguous so the inner loop vectorizes */
+static inline void rankktile(SymMatrix *sym, double alpha, const Matrix *mat,
+							 long r0, long r1, int i0, int i1, int j0, int j1)
+{
+	const double *row;
+	double a;
+	long r;
+	int i, j, jend;
+
+	for (r = r0; r < r1; r++) {
+		row = &mat->vals[r * mat->ncols];
+		for (i = i0; i < i1; i++) {
+			a = alpha * row[i];
+			double * restrict out = &sym->vals[SIDX(0, i)];
+			jend = (j1 <= i + 1) ? j1 : i + 1;
+			for (j = j0; j < jend; j++) out[j] += a * row[j];
+		}
+	}
+}
+
+/* The tiles of the triangle are dealt out to the threads, every tile has
+ * one owner so nothing has to be reduced */
+static void rankktiles(void *arg, int id, int nthreads)
+{
+	SymArgs *a = arg;
+	int n = a->sym->n;
+	int nb = (n + SYM_BLOCK - 1) / SYM_BLOCK;
+	int bi, bj, t = 0;
+	long r0, r1, k = a->mat->nrows;
+
+	for (bi = 0; bi < nb; bi++) {
+		for (bj = 0; bj <= bi; bj++, t++) {
+			if (t % nthreads != id) continue;
+			for (r0 = 0; r0 < k; r0 += SYM_ROWS) {
+				r1 = (r0 + SYM_ROWS < k) ? r0 + SYM_ROWS : k;
+				rankktile(a->sym, a->alpha, a->mat, r0, r1,
+						  bi * SYM_BLOCK, (bi + 1) * SYM_BLOCK < n ? (bi + 1) * SYM_BLOCK : n,
+						  bj * SYM_BLOCK, (bj + 1) * SYM_BLOCK < n ? (bj + 1) * SYM_BLOCK : n);
+			}
+		}
+	}
+}
+
+/*** Public Functions ***/
+
+SymMatrix *initsym(int n)
+{
+	LOG_INFO("Creating a %dx%d symmetric Matrix...\n", n, n);
+	assert(n > 0);
+
+	SymMatrix *sym = malloc(sizeof(SymMatrix));
+	if (!sym) DIE("malloc");
+
+	sym->n = n;
+	if (!(sym->vals = calloc(SIDX(0, n), sizeof(double)))) DIE("calloc");
+
+	LOG_INFO("Succesfully created symmetric matrix\n");
+	return sym;
+}
+
+void freesym(SymMatrix *sym)
+{
+	free(sym->vals);
+	free(sym);
+}
+
+void sympack(SymMatrix *res, const Matrix *mat)
+{
+	assert(mat->nrows == res->n && mat->ncols == res->n);
+
+	int y;
+	for (y = 0; y < res->n; y++)
+		memcpy(&res->vals[SIDX(0, y)], &GET(mat, 0, y), sizeof(double) * (y + 1));
+}
+
+void symunpack(Matrix *res, const SymMatrix *sym)
+{
+	assert(res->nrows == sym->n && res->ncols == sym->n);
+
+	int x, y;
+	const double *row;
+	for (y = 0; y < sym->n; y++) {
+		row = &sym->vals[SIDX(0, y)];
+		for (x = 0; x <= y; x++) GET(res, x, y) = GET(res, y, x) = row[x];
+	}
+}
+
+void symrank1(SymMatrix *sym, double alpha, const double *vec)
+{
+	int i, j;
+	double a;
+
+	for (i = 0; i < sym->n; i++) {
+		a = alpha * vec[i];
+		double * restrict out = &sym->vals[SIDX(0, i)];
+		for (j = 0; j <= i; j++) out[j] += a * vec[j];
+	}
+}
+
+void symrankk(SymMatrix *sym, double alpha, const Matrix *mat)
+{
+	LOG_INFO("Rank %d update of %dx%d symmetric Matrix...\n", mat->nrows, sym->n, sym->n);
+	assert(mat->ncols == sym->n);
+	LATENCY_START(start);
+
+	SymArgs args = { sym, mat, alpha };
+	long n = sym->n;
+
+	if (mat->nrows * n * n >= SYM_PARALLEL_WORK && tpthreads() > 1)
+		tprun(rankktiles, &args);
+	else
+		rankktiles(&args, 0, 1);
+
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Finished rank %d update\n", mat->nrows);
+}
+
+void symmv(const SymMatrix *sym, const double *vec, double *res)
+{
+	int i, j;
+	const double *row;
+	double xi;
+
+	/* Row i of the triangle is both row i and column i of A */
+	memset(res, 0, sizeof(double) * sym->n);
+	for (i = 0; i < sym->n; i++) {
+		row = &sym->vals[SIDX(0, i)];
+		xi = vec[i];
+		res[i] += packdot(row, vec, i) + row[i] * xi;
+		for (j = 0; j < i; j++) res[j] += row[j] * xi;
+	}
+}
+
+int symchol(SymMatrix *sym)
+{
+	LOG_INFO("Cholesky decomposition of %dx%d symmetric Matrix...\n", sym->n, sym->n);
+	LATENCY_START(start);
+
+	int i, j, n = sym->n;
+	double d, *rowi, *rowj;
+
+	/* Same row by row order as matchol(), the packed rows are contiguous */
+	for (j = 0; j < n; j++) {
+		rowj = &sym->vals[SIDX(0, j)];
+		d = rowj[j] - packdot(rowj, rowj, j);
+		if (d <= EPSILON) {
+			LOG_WARN("Matrix is not positive definite at column %d\n", j);
+			return -1;
+		}
+		rowj[j] = sqrt(d);
+
+		for (i = j + 1; i < n; i++) {
+			rowi = &sym->vals[SIDX(0, i)];
+			rowi[j] = (rowi[j] - packdot(rowi, rowj, j)) / rowj[j];
+		}
+	}
+
+	LATENCY_STOP(LAT_SOLVE, start);
+	LOG_INFO("Finished Cholesky decomposition\n");
+	return EXIT_SUCCESS;
+}
+
+void symsoltri(const SymMatrix *chol, double *vec, int trans)
+{
+	int i, k, n = chol->n;
+	const double *row;
+
+	if (!trans) {
+		for (i = 0; i < n; i++) {
+			row = &chol->vals[SIDX(0, i)];
+			vec[i] = (vec[i] - packdot(row, vec, i)) / row[i];
+		}
+	} else {
+		/* Walk the rows of L backwards instead of its columns */
+		for (i = n - 1; i >= 0; i--) {
+			row = &chol->vals[SIDX(0, i)];
+			vec[i] /= row[i];
+			for (k = 0; k < i; k++) vec[k] -= row[k] * vec[i];
+		}
+	}
+}
+
+void symcholsolve(const SymMatrix *chol, double *vec)
+{
+	symsoltri(chol, vec, 0);
+	symsoltri(chol, vec, 1);
+}
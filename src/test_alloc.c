@@ -0,0 +1,142 @@
+/**
+ * @file    test_alloc.c
+ * @brief   Tests the allocation policies in alloc.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "alloc.h"
+#include "matrix.h"
+#include "threadpool.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*** Defines ***/
+
+#define ROWS 2048
+#define COLS 512
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+/* Zero when created, keeps what is written and multiplies like malloc */
+static const char *check(Matrix *mat, const Matrix *ref, const double *vec, const double *want)
+{
+	static double res[ROWS];
+	long i, size = (long)mat->nrows * mat->ncols;
+
+	if ((uintptr_t)mat->vals % 64) return "values not cache aligned";
+	for (i = 0; i < size; i++)
+		if (mat->vals[i] != 0) return "values not zero";
+	for (i = 0; i < size; i++) mat->vals[i] = ref->vals[i];
+	if (matgemv(res, mat, vec, 0)) return "matgemv";
+	for (i = 0; i < mat->nrows; i++)
+		if (res[i] != want[i]) return "product differs";
+	return NULL;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	long i;
+	double vec[COLS], want[ROWS];
+	const char *err;
+	Matrix *mat;
+
+	srand(45);
+	printf("\nTesting alloc.c...\n");
+	tpinit(4);
+	Matrix *ref = initmat(ROWS, COLS, NULL, 1);
+	for (i = 0; i < (long)ROWS * COLS; i++) ref->vals[i] = (double)rand() / RAND_MAX - 0.5;
+	for (i = 0; i < COLS; i++) vec[i] = (double)rand() / RAND_MAX;
+	matgemv(want, ref, vec, 0);
+
+	/*** Small matrices ***/
+	printf("Testing a small matrix falls back to malloc... ");
+	mat = initmatalloc(16, 16, ALLOC_HUGE | ALLOC_INTERLEAVE);
+	for (i = 0, err = NULL; i < 256; i++)
+		if (mat->vals[i] != 0) err = "values not zero";
+	if      (mat->alloc != ALLOC_MALLOC) { FAIL("policy not malloc"); }
+	else if (err)                        { FAIL(err); }
+	else                                 { PASS(); }
+	freemat(mat);
+
+	/*** 2MB pages ***/
+	printf("Testing 2MB pages... ");
+	mat = initmatalloc(ROWS, COLS, ALLOC_HUGE);
+	err = check(mat, ref, vec, want);
+	if      (mat->alloc != ALLOC_HUGE)        { FAIL("policy changed"); }
+	else if ((uintptr_t)mat->vals % 4096 != 64) { FAIL("not at the start of a page"); }
+	else if (err)                             { FAIL(err); }
+	else                                      { PASS(); }
+	freemat(mat);
+
+	/*** 1GB pages ***/
+	printf("Testing 1GB pages or the fall back... ");
+	mat = initmatalloc(ROWS, COLS, ALLOC_HUGE1G);
+	err = check(mat, ref, vec, want);
+	if      (mat->alloc != ALLOC_HUGE1G && mat->alloc != ALLOC_HUGE) { FAIL("policy"); }
+	else if (err)                                                    { FAIL(err); }
+	else                                                             { PASS(); }
+	freemat(mat);
+
+	/*** NUMA placement ***/
+	printf("Testing interleaved pages... ");
+	mat = initmatalloc(ROWS, COLS, ALLOC_HUGE | ALLOC_INTERLEAVE);
+	err = check(mat, ref, vec, want);
+	if      (mat->alloc != (ALLOC_HUGE | ALLOC_INTERLEAVE)) { FAIL("policy changed"); }
+	else if (err)                                           { FAIL(err); }
+	else                                                    { PASS(); }
+	freemat(mat);
+
+	printf("Testing pages bound to a node... ");
+	mat = initmatalloc(ROWS, COLS, ALLOC_HUGE | ALLOC_BIND(0));
+	err = check(mat, ref, vec, want);
+	if      (ALLOC_NODE(mat->alloc) != 0) { FAIL("node changed"); }
+	else if (err)                         { FAIL(err); }
+	else                                  { PASS(); }
+	freemat(mat);
+
+	printf("Testing a node that is not online... ");
+	mat = initmatalloc(ROWS, COLS, ALLOC_HUGE | ALLOC_BIND(63));
+	err = check(mat, ref, vec, want);
+	if      (mat->alloc != ALLOC_HUGE) { FAIL("placement not dropped"); }
+	else if (err)                      { FAIL(err); }
+	else                               { PASS(); }
+	freemat(mat);
+
+	printf("Testing a placement in ordinary pages... ");
+	mat = initmatalloc(ROWS, COLS, ALLOC_INTERLEAVE);
+	err = check(mat, ref, vec, want);
+	if      (mat->alloc != ALLOC_INTERLEAVE)   { FAIL("policy changed"); }
+	else if ((uintptr_t)mat->vals % 4096 != 64) { FAIL("not at the start of a page"); }
+	else if (err)                              { FAIL(err); }
+	else                                       { PASS(); }
+	freemat(mat);
+
+	printf("Testing a placement that fails on its own... ");
+	mat = initmatalloc(ROWS, COLS, ALLOC_BIND(63));
+	err = check(mat, ref, vec, want);
+	if      (mat->alloc != ALLOC_MALLOC) { FAIL("policy not malloc"); }
+	else if (err)                        { FAIL(err); }
+	else                                 { PASS(); }
+	freemat(mat);
+
+	freemat(ref);
+	tpfree();
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
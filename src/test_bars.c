@@ -0,0 +1,171 @@
+/**
+ * @file    test_bars.c
+ * @brief   Tests the tick to bar resampling in bars.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "bars.h"
+#include "matrix.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*** Defines ***/
+
+#define NTICKS 20000
+#define NSYMS 3
+#define NFRAMES 3
+#define CAP 4096
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+static const double FRAMES[NFRAMES] = { 1, 60, 300 };
+
+/* The bars of one symbol at one timeframe straight from all the ticks,
+ * returns the amount of periods with trades, the last one still open */
+static int bruteforce(const Matrix *ticks, int sym, double len, Matrix *out)
+{
+	int i, n = 0;
+	double *bar = NULL, t, p, q;
+
+	for (i = 0; i < ticks->nrows; i++) {
+		if ((int)GET(ticks, TICK_SYM, i) != sym) continue;
+		t = GET(ticks, TICK_TIME, i);
+		p = GET(ticks, TICK_PRICE, i);
+		q = GET(ticks, TICK_QTY, i);
+		if (!bar || floor(t / len) * len != bar[BAR_TIME]) {
+			bar = &GET(out, 0, n++);
+			bar[BAR_TIME] = floor(t / len) * len;
+			bar[BAR_OPEN] = bar[BAR_HIGH] = bar[BAR_LOW] = p;
+			bar[BAR_VOLUME] = bar[BAR_VWAP] = 0;
+		}
+		bar[BAR_HIGH] = fmax(bar[BAR_HIGH], p);
+		bar[BAR_LOW] = fmin(bar[BAR_LOW], p);
+		bar[BAR_CLOSE] = p;
+		bar[BAR_VOLUME] += q;
+		bar[BAR_VWAP] += p * q;
+	}
+	for (i = 0; i < n; i++) GET(out, BAR_VWAP, i) /= GET(out, BAR_VOLUME, i);
+	return n;
+}
+
+/* Largest relative difference between the first nrows of two bar sets */
+static double bardiff(const Matrix *a, const Matrix *b, int nrows)
+{
+	double worst = 0, d;
+	int i, c;
+	for (i = 0; i < nrows; i++)
+		for (c = 0; c < BAR_COLS; c++) {
+			d = fabs(GET(a, c, i) - GET(b, c, i)) / fmax(1, fabs(GET(b, c, i)));
+			if (d > worst) worst = d;
+		}
+	return worst;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	int i, s, f, n, got, bad;
+	double t = 1e6, price[NSYMS] = { 100, 50, 2000 };
+	Matrix view;
+
+	srand(46);
+	printf("\nTesting bars.c...\n");
+
+	/* Trades of three symbols interleaved, with quiet spells longer than
+	 * some of the timeframes */
+	Matrix *ticks = initmat(NTICKS, TICK_COLS, NULL, 1);
+	for (i = 0; i < NTICKS; i++) {
+		s = rand() % NSYMS;
+		t += (rand() % 100 == 0) ? 90 : 0.25 * rand() / RAND_MAX;
+		price[s] *= 1 + 0.001 * ((double)rand() / RAND_MAX - 0.5);
+		GET(ticks, TICK_TIME, i) = t;
+		GET(ticks, TICK_SYM, i) = s;
+		GET(ticks, TICK_PRICE, i) = price[s];
+		GET(ticks, TICK_QTY, i) = 1 + rand() % 10;
+	}
+	Matrix *want = initmat(NTICKS, BAR_COLS, NULL, 1);
+
+	/*** Every symbol and timeframe from one pass ***/
+	printf("Testing the bars of every symbol and timeframe... ");
+	BarAgg *agg = initbars(NSYMS, NFRAMES, FRAMES, CAP);
+	barsfeed(agg, ticks);
+	for (s = 0, bad = 0; s < NSYMS; s++)
+		for (f = 0; f < NFRAMES; f++) {
+			n = bruteforce(ticks, s, FRAMES[f], want);
+			got = barslast(agg, s, f, CAP, &view);
+			bad += got != n - 1 || bardiff(&view, want, got) > 1e-12;
+		}
+	if (bad) { FAIL("bars differ from the ticks"); }
+	else     { PASS(); }
+
+	/*** Flushing ***/
+	printf("Testing a flush completes the open bars... ");
+	barsflush(agg, t + 1);
+	got = barslast(agg, 0, 0, CAP, &view);
+	n = bruteforce(ticks, 0, FRAMES[0], want);
+	f = bruteforce(ticks, 0, FRAMES[2], want);
+	bad = barslast(agg, 0, 2, CAP, &view) != f - (t + 1 < GET(want, BAR_TIME, f - 1) + FRAMES[2]);
+	if      (got != n)  { FAIL("open 1 second bar not completed"); }
+	else if (bad)       { FAIL("5 minute bar flushed wrong"); }
+	else                { PASS(); }
+	freebars(agg);
+
+	/*** Gaps ***/
+	printf("Testing periods without trades have no bar... ");
+	agg = initbars(1, 1, FRAMES, CAP);
+	barstick(agg, 0, 10.5, 1, 1);
+	barstick(agg, 0, 13.2, 2, 1);
+	barstick(agg, 0, 13.7, 3, 3);
+	barstick(agg, 0, 20.0, 4, 1);
+	got = barslast(agg, 0, 0, CAP, &view);
+	if      (got != 2)                          { FAIL("wrong amount of bars"); }
+	else if (GET(&view, BAR_TIME, 1) != 13)     { FAIL("wrong period"); }
+	else if (GET(&view, BAR_VWAP, 1) != 2.75)   { FAIL("wrong vwap"); }
+	else if (GET(&view, BAR_OPEN, 1) != 2 ||
+			 GET(&view, BAR_CLOSE, 1) != 3)     { FAIL("wrong open or close"); }
+	else                                        { PASS(); }
+	freebars(agg);
+
+	/*** Wrapping ***/
+	printf("Testing the ring wraps into one contiguous view... ");
+	agg = initbars(2, 1, FRAMES, 8);
+	for (i = 0; i < 21; i++) {
+		barstick(agg, 0, i, i, 1);
+		barstick(agg, 1, i, -i, 1);
+	}
+	got = barslast(agg, 0, 0, 8, &view);
+	for (i = 0, bad = 0; i < got; i++) bad += GET(&view, BAR_CLOSE, i) != 12 + i;
+	barslast(agg, 0, 0, 6, &view);
+	const double *oldest = view.vals;
+	barstick(agg, 0, 21, 21, 1);
+	if      (got != 8)                          { FAIL("wrong amount of bars"); }
+	else if (bad)                               { FAIL("bars out of order"); }
+	else if (view.vals < agg->rings->vals ||
+			 view.vals >= agg->rings->vals + 16 * BAR_COLS) { FAIL("view outside the ring"); }
+	else if (barslast(agg, 0, 0, 3, &view) != 3 ||
+			 GET(&view, BAR_CLOSE, 2) != 20)    { FAIL("last 3 bars"); }
+	else if (oldest[BAR_CLOSE] != 14)           { FAIL("older view overwritten"); }
+	else if (barslast(agg, 1, 0, 8, &view) != 8 ||
+			 GET(&view, BAR_CLOSE, 7) != -19)   { FAIL("second symbol"); }
+	else                                        { PASS(); }
+	freebars(agg);
+
+	freemat(ticks);
+	freemat(want);
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file    test_batch.c
+ * @brief   Tests the batched small matrix solvers in batch.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "batch.h"
+#include "matrix.h"
+#include "threadpool.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+#define COUNT 37   /* Not a multiple of BATCH_LANES so the padding is used */
+#define N 7
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+static double randu(void)
+{
+	return (double)rand() / RAND_MAX * 2 - 1;
+}
+
+static void randfill(Matrix *mat)
+{
+	int i;
+	for (i = 0; i < mat->nrows * mat->ncols; i++) mat->vals[i] = randu();
+}
+
+/* A^T A + I, always positive definite */
+static void randspd(Matrix *mat)
+{
+	Matrix *a = initmat(mat->nrows, mat->ncols, NULL, 1);
+	int i;
+
+	randfill(a);
+	memset(mat->vals, 0, sizeof(double) * mat->nrows * mat->ncols);
+	matsyrk(mat, a);
+	for (i = 0; i < mat->nrows; i++) GET(mat, i, i) += 1;
+	freemat(a);
+}
+
+static double maxdiff(const double *a, const double *b, int len)
+{
+	double d, worst = 0;
+	int i;
+	for (i = 0; i < len; i++)
+		if ((d = fabs(a[i] - b[i])) > worst) worst = d;
+	return worst;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	int b, i, nbad;
+	int status[COUNT];
+	double worst;
+
+	MatBatch *mats = initbatch(COUNT, N, N);
+	MatBatch *vecs = initbatch(COUNT, N, 1);
+	Matrix *mat = initmat(N, N, NULL, 1);
+	Matrix *one = initmat(N, N, NULL, 1);
+	Matrix *vec = initmat(N, 1, NULL, 1);
+	Matrix *got = initmat(N, 1, NULL, 1);
+	double *sol = malloc(sizeof(double) * N);
+	double *ys = malloc(sizeof(double) * COUNT * N);
+	Matrix **orig = malloc(sizeof(Matrix *) * COUNT);
+	if (!sol || !ys || !orig) DIE("malloc");
+
+	srand(11);
+	tpinit(4);
+	printf("\nTesting batch.c...\n");
+
+	/*** Copying in and out ***/
+	printf("Testing batchset and batchget... ");
+	randfill(mat);
+	batchset(mats, COUNT - 1, mat);
+	batchget(one, mats, COUNT - 1);
+	if      (memcmp(one->vals, mat->vals, sizeof(double) * N * N)) { FAIL("round trip"); }
+	else if (BGET(mats, COUNT - 1, 2, 3) != GET(mat, 2, 3))       { FAIL("layout"); }
+	else                                                          { PASS(); }
+
+	/*** LU against solinv ***/
+	printf("Testing batchsolve against solinv... ");
+	for (b = 0; b < COUNT; b++) {
+		orig[b] = initmat(N, N, NULL, 1);
+		randfill(orig[b]);
+		batchset(mats, b, orig[b]);
+		randfill(vec);
+		batchset(vecs, b, vec);
+		memcpy(&ys[b * N], vec->vals, sizeof(double) * N);
+	}
+	nbad = batchsolve(mats, vecs, status);
+	worst = 0;
+	for (b = 0; b < COUNT; b++) {
+		solinv(orig[b], NULL, sol, &ys[b * N]);
+		batchget(got, vecs, b);
+		worst = fmax(worst, maxdiff(got->vals, sol, N));
+	}
+	if      (nbad)                                  { FAIL("reported singular"); }
+	else if (worst > 1e-9)                          { FAIL("solutions differ"); }
+	else                                            { PASS(); }
+
+	/*** Cholesky against solchol ***/
+	printf("Testing batchchol against solchol... ");
+	for (b = 0; b < COUNT; b++) {
+		randspd(orig[b]);
+		batchset(mats, b, orig[b]);
+		randfill(vec);
+		batchset(vecs, b, vec);
+		memcpy(&ys[b * N], vec->vals, sizeof(double) * N);
+	}
+	nbad = batchchol(mats, status);
+	batchcholsolve(mats, vecs);
+	worst = 0;
+	for (b = 0; b < COUNT; b++) {
+		solchol(orig[b], NULL, sol, &ys[b * N]);
+		batchget(got, vecs, b);
+		worst = fmax(worst, maxdiff(got->vals, sol, N));
+	}
+	batchget(one, mats, 0);
+	if      (nbad)                                  { FAIL("reported not positive definite"); }
+	else if (worst > 1e-9)                          { FAIL("solutions differ"); }
+	else if (GET(one, N - 1, 0) != 0)               { FAIL("upper part not zeroed"); }
+	else                                            { PASS(); }
+
+	/*** Bad lanes do not spoil the others ***/
+	printf("Testing singular matrices in the batch... ");
+	for (b = 0; b < COUNT; b++) {
+		randfill(orig[b]);
+		if (b % 5 == 2)
+			for (i = 0; i < N; i++) GET(orig[b], i, 3) = 2 * GET(orig[b], i, 1);
+		batchset(mats, b, orig[b]);
+		randfill(vec);
+		batchset(vecs, b, vec);
+		memcpy(&ys[b * N], vec->vals, sizeof(double) * N);
+	}
+	nbad = batchsolve(mats, vecs, status);
+	worst = 0;
+	for (b = 0; b < COUNT; b++) {
+		if (status[b]) continue;
+		solinv(orig[b], NULL, sol, &ys[b * N]);
+		batchget(got, vecs, b);
+		worst = fmax(worst, maxdiff(got->vals, sol, N));
+	}
+	if      (nbad != (COUNT + 2) / 5)               { FAIL("singular count"); }
+	else if (status[2] != -1 || status[3] != 0)     { FAIL("status"); }
+	else if (worst > 1e-9)                          { FAIL("good lanes differ"); }
+	else                                            { PASS(); }
+
+	printf("Testing not positive definite matrices in the batch... ");
+	for (b = 0; b < COUNT; b++) {
+		randspd(orig[b]);
+		if (b == 4) GET(orig[b], 2, 2) = -1;
+		batchset(mats, b, orig[b]);
+	}
+	nbad = batchchol(mats, status);
+	if      (nbad != 1 || status[4] != -1)          { FAIL("status"); }
+	else                                            { PASS(); }
+
+	for (b = 0; b < COUNT; b++) freemat(orig[b]);
+	free(orig);
+	free(ys);
+	free(sol);
+	freemat(mat);
+	freemat(one);
+	freemat(vec);
+	freemat(got);
+	freebatch(mats);
+	freebatch(vecs);
+	tpfree();
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
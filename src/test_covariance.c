@@ -0,0 +1,192 @@
+/**
+ * @file    test_covariance.c
+ * @brief   Tests the streaming covariance estimators in covariance.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "covariance.h"
+#include "symmat.h"
+#include "matrix.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+#define N 20
+#define T 50       /* Window length */
+#define BARS 437   /* Past COV_REFRESH_WINDOWS windows, so a refresh happens */
+#define DECAY 0.97
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+static double randu(void)
+{
+	return (double)rand() / RAND_MAX * 2 - 1;
+}
+
+/* Prices around 100 with correlated moves, a mean far from 0 */
+static void randbars(Matrix *bars)
+{
+	int i, j;
+	double common;
+	for (i = 0; i < bars->nrows; i++) {
+		common = randu();
+		for (j = 0; j < bars->ncols; j++)
+			GET(bars, j, i) = 100 + j + common * (j % 3) + randu();
+	}
+}
+
+/* Weighted covariance of rows [r0, r1) straight from the definition */
+static void directcov(const Matrix *bars, int r0, int r1, double decay, double *cov)
+{
+	double mean[N], w, wsum = 0;
+	int i, j, r;
+
+	memset(mean, 0, sizeof(mean));
+	memset(cov, 0, sizeof(double) * N * N);
+	for (r = r0, w = pow(decay, r1 - 1 - r0); r < r1; r++, w /= decay) {
+		wsum += w;
+		for (j = 0; j < N; j++) mean[j] += w * GET(bars, j, r);
+	}
+	for (j = 0; j < N; j++) mean[j] /= wsum;
+	for (r = r0, w = pow(decay, r1 - 1 - r0); r < r1; r++, w /= decay)
+		for (i = 0; i < N; i++)
+			for (j = 0; j < N; j++)
+				cov[i * N + j] += w * (GET(bars, i, r) - mean[i]) * (GET(bars, j, r) - mean[j]);
+	for (i = 0; i < N * N; i++) cov[i] /= wsum;
+}
+
+/* Ledoit-Wolf intensity of rows [r0, r1) as in the paper */
+static double directshrink(const Matrix *bars, int r0, int r1, const double *cov)
+{
+	double mean[N], d[N], target = 0, d2 = 0, b2 = 0, e;
+	int i, j, r, t = r1 - r0;
+
+	memset(mean, 0, sizeof(mean));
+	for (r = r0; r < r1; r++)
+		for (j = 0; j < N; j++) mean[j] += GET(bars, j, r) / t;
+	for (i = 0; i < N; i++) target += cov[i * N + i] / N;
+	for (i = 0; i < N; i++)
+		for (j = 0; j < N; j++) {
+			e = cov[i * N + j] - (i == j) * target;
+			d2 += e * e / N;
+		}
+	for (r = r0; r < r1; r++) {
+		for (j = 0; j < N; j++) d[j] = GET(bars, j, r) - mean[j];
+		for (i = 0; i < N; i++)
+			for (j = 0; j < N; j++) {
+				e = d[i] * d[j] - cov[i * N + j];
+				b2 += e * e / N / t / t;
+			}
+	}
+	return fmin(b2, d2) / d2;
+}
+
+static double symdiff(const SymMatrix *sym, const double *full)
+{
+	double worst = 0;
+	int i, j;
+	for (i = 0; i < N; i++)
+		for (j = 0; j < N; j++) worst = fmax(worst, fabs(SGET(sym, j, i) - full[i * N + j]));
+	return worst;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	int r, k, i;
+	double cov[N * N], worst, shrink, want;
+
+	Matrix *bars = initmat(BARS, N, NULL, 1);
+	SymMatrix *got = initsym(N);
+	CovEst *win = initcovwindow(N, T);
+	CovEst *ewma = initcovewma(N, DECAY);
+
+	srand(23);
+	randbars(bars);
+	printf("\nTesting covariance.c...\n");
+
+	/*** Sliding window fed batches of every size up to 9 ***/
+	printf("Testing the sliding window against the direct covariance... ");
+	worst = 0;
+	for (r = 0, k = 1; r < BARS; r += k, k = k % 9 + 1) {
+		if (r + k > BARS) k = BARS - r;
+		Matrix view = { k, N, &GET(bars, 0, r), 0 };
+		covupdate(win, &view);
+		if (r + k < 3) continue;
+		covget(win, got);
+		directcov(bars, (r + k > T) ? r + k - T : 0, r + k, 1, cov);
+		worst = fmax(worst, symdiff(got, cov));
+	}
+	if (worst > 1e-10) { FAIL("covariance differs"); }
+	else               { PASS(); }
+
+	printf("Testing the sliding window mean... ");
+	worst = 0;
+	for (i = 0; i < N; i++) {
+		want = 0;
+		for (r = BARS - T; r < BARS; r++) want += GET(bars, i, r) / T;
+		worst = fmax(worst, fabs(win->mean[i] - want));
+	}
+	if (worst > 1e-10) { FAIL("mean differs"); }
+	else               { PASS(); }
+
+	/*** Ledoit-Wolf ***/
+	printf("Testing the Ledoit-Wolf shrinkage... ");
+	directcov(bars, BARS - T, BARS, 1, cov);
+	want = directshrink(bars, BARS - T, BARS, cov);
+	shrink = covshrink(win, got);
+	double target = 0;
+	for (i = 0; i < N; i++) target += cov[i * N + i] / N;
+	for (i = 0; i < N * N; i++) cov[i] *= 1 - want;
+	for (i = 0; i < N; i++) cov[i * N + i] += want * target;
+	if      (fabs(shrink - want) > 1e-8)  { FAIL("intensity differs"); }
+	else if (shrink <= 0 || shrink >= 1)  { FAIL("intensity out of range"); }
+	else if (symdiff(got, cov) > 1e-10)   { FAIL("shrunk covariance differs"); }
+	else                                  { PASS(); }
+
+	/*** A batch longer than the window replaces it ***/
+	printf("Testing a batch longer than the window... ");
+	Matrix head = { T + 5, N, bars->vals, 0 };
+	covupdate(win, &head);
+	covget(win, got);
+	directcov(bars, 5, T + 5, 1, cov);
+	if (symdiff(got, cov) > 1e-10) { FAIL("covariance differs"); }
+	else                           { PASS(); }
+
+	/*** Exponential decay ***/
+	printf("Testing exponential decay against the direct covariance... ");
+	worst = 0;
+	for (r = 0, k = 1; r < 200; r += k, k = k % 7 + 1) {
+		Matrix view = { k, N, &GET(bars, 0, r), 0 };
+		covupdate(ewma, &view);
+		if (r + k < 3) continue;
+		covget(ewma, got);
+		directcov(bars, 0, r + k, DECAY, cov);
+		worst = fmax(worst, symdiff(got, cov));
+	}
+	if (worst > 1e-10) { FAIL("covariance differs"); }
+	else               { PASS(); }
+
+	freecov(win);
+	freecov(ewma);
+	freesym(got);
+	freemat(bars);
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file    test_exchange.c
+ * @brief   Tests the local matching engine in exchange.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "exchange.h"
+#include "data.h"
+#include "error.h"
+#include "logging.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*** Defines ***/
+
+#define REPLAY_FILE "./tests/exchange/replay.mat"
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+typedef struct {
+	int nfills;
+	long filled;
+	long lastmaker;
+	long lastprice;
+	long maxlatency;
+} FillLog;
+
+static void logfill(const Fill *fill, void *arg)
+{
+	FillLog *log = arg;
+	log->nfills++;
+	log->filled += fill->qty;
+	log->lastmaker = fill->maker;
+	log->lastprice = fill->price;
+	if (fill->latency > log->maxlatency) log->maxlatency = fill->latency;
+}
+
+/* Bot that lifts the best ask with an IOC every time the ask moves */
+static void bot(OrderBook *book, const double *row, void *arg)
+{
+	long *sent = arg;
+	long ask = bookbest(book, SIDE_SELL);
+	(void)row;
+	if (ask >= 0 && bookdepth(book, SIDE_SELL, ask) > 0) {
+		bookorder(book, SIDE_BUY, ORDER_IOC, ask, 1);
+		(*sent)++;
+	}
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	FillLog log = { 0 };
+	long a, b, c, d;
+
+	printf("\nTesting exchange.c...\n");
+	OrderBook *book = initbook(100, 200, 64);
+	bookonfill(book, logfill, &log);
+
+	/*** Resting orders and best prices ***/
+	printf("Testing resting limit orders... ");
+	a = bookorder(book, SIDE_BUY, ORDER_LIMIT, 150, 10);
+	b = bookorder(book, SIDE_BUY, ORDER_LIMIT, 150, 5);
+	c = bookorder(book, SIDE_SELL, ORDER_LIMIT, 155, 7);
+	d = bookorder(book, SIDE_SELL, ORDER_LIMIT, 160, 3);
+	if      (a < 0 || b < 0 || c < 0 || d < 0)        { FAIL("rejected"); }
+	else if (bookbest(book, SIDE_BUY) != 150)         { FAIL("best bid"); }
+	else if (bookbest(book, SIDE_SELL) != 155)        { FAIL("best ask"); }
+	else if (bookdepth(book, SIDE_BUY, 150) != 15)    { FAIL("bid depth"); }
+	else if (log.nfills != 0)                         { FAIL("unexpected fill"); }
+	else                                              { PASS(); }
+
+	/*** FIFO priority within a level ***/
+	printf("Testing time priority... ");
+	bookorder(book, SIDE_SELL, ORDER_LIMIT, 150, 12);
+	if      (log.filled != 12)                        { FAIL("fill quantity"); }
+	else if (bookqty(book, a) != 0)                   { FAIL("first order not filled first"); }
+	else if (bookqty(book, b) != 3)                   { FAIL("second order quantity"); }
+	else if (log.lastmaker != b)                      { FAIL("maker order"); }
+	else                                              { PASS(); }
+
+	/*** Cancel ***/
+	printf("Testing cancel... ");
+	if      (bookcancel(book, b))                     { FAIL("cancel resting"); }
+	else if (!bookcancel(book, b))                    { FAIL("cancel twice"); }
+	else if (!bookcancel(book, a))                    { FAIL("cancel filled"); }
+	else if (bookbest(book, SIDE_BUY) != -1)          { FAIL("bid side not empty"); }
+	else                                              { PASS(); }
+
+	/*** IOC and market orders sweep levels and never rest ***/
+	printf("Testing IOC and market orders... ");
+	log.filled = 0;
+	long ioc = bookorder(book, SIDE_BUY, ORDER_IOC, 155, 20);
+	long ioclef = bookqty(book, ioc);
+	long mkt = bookorder(book, SIDE_BUY, ORDER_MARKET, 0, 2);
+	if      (log.filled != 9)                         { FAIL("fill quantity"); }
+	else if (ioclef != 0 || bookqty(book, mkt) != 0)  { FAIL("taker rested"); }
+	else if (log.lastprice != 160)                    { FAIL("market price"); }
+	else if (bookdepth(book, SIDE_SELL, 160) != 1)    { FAIL("ask depth"); }
+	else if (bookbest(book, SIDE_BUY) != -1)          { FAIL("IOC rested"); }
+	else                                              { PASS(); }
+
+	/*** Rejections ***/
+	printf("Testing rejected orders... ");
+	if      (bookorder(book, SIDE_BUY, ORDER_LIMIT, 99, 1) != -1)  { FAIL("below ladder"); }
+	else if (bookorder(book, SIDE_BUY, ORDER_LIMIT, 300, 1) != -1) { FAIL("above ladder"); }
+	else if (bookorder(book, SIDE_BUY, ORDER_LIMIT, 150, 0) != -1) { FAIL("zero quantity"); }
+	else if (bookorder(book, SIDE_BUY, 7, 150, 1) != -1)           { FAIL("unknown type"); }
+	else                                                           { PASS(); }
+	freebook(book);
+
+	/*** Only orders that rest need a slot ***/
+	printf("Testing a full book still takes liquidity... ");
+	book = initbook(100, 10, 4);
+	log = (FillLog){ 0 };
+	bookonfill(book, logfill, &log);
+	bookorder(book, SIDE_SELL, ORDER_LIMIT, 105, 2);
+	bookorder(book, SIDE_SELL, ORDER_LIMIT, 105, 2);
+	bookorder(book, SIDE_BUY, ORDER_LIMIT, 101, 1);
+	bookorder(book, SIDE_BUY, ORDER_LIMIT, 101, 1);
+	a = bookorder(book, SIDE_BUY, ORDER_LIMIT, 106, 1);
+	b = bookorder(book, SIDE_BUY, ORDER_LIMIT, 105, 5);
+	c = bookorder(book, SIDE_BUY, ORDER_MARKET, 0, 1);
+	d = bookorder(book, SIDE_SELL, ORDER_IOC, 101, 1);
+	if      (a < 0 || c < 0 || d < 0)                 { FAIL("rejected"); }
+	else if (b != -1)                                 { FAIL("limit order rested without a slot"); }
+	else if (log.filled != 3)                         { FAIL("fill quantity"); }
+	else if (bookqty(book, a) || bookcancel(book, a) != -1) { FAIL("taker has a slot"); }
+	else                                              { PASS(); }
+	freebook(book);
+
+	printf("Testing a limit order rests in a slot after matching... ");
+	book = initbook(100, 10, 2);
+	bookorder(book, SIDE_SELL, ORDER_LIMIT, 105, 1);
+	a = bookorder(book, SIDE_BUY, ORDER_LIMIT, 105, 3);
+	b = bookorder(book, SIDE_BUY, ORDER_LIMIT, 104, 1);
+	c = bookorder(book, SIDE_BUY, ORDER_LIMIT, 104, 1);
+	if      (a < 0 || b < 0)                          { FAIL("rejected"); }
+	else if (bookqty(book, a) != 2 || bookqty(book, b) != 1) { FAIL("resting quantity"); }
+	else if (c != -1)                                 { FAIL("more orders rest than slots"); }
+	else if (bookcancel(book, a) || bookcancel(book, b)) { FAIL("cancel"); }
+	else                                              { PASS(); }
+	freebook(book);
+
+	/*** Replay from the data store ***/
+	printf("Testing replay from the data store... ");
+	double events[] = {
+		0, SIDE_BUY,  ORDER_LIMIT, 120, 5,
+		1, SIDE_SELL, ORDER_LIMIT, 125, 4,
+		2, SIDE_SELL, ORDER_LIMIT, 124, 2,
+		3, SIDE_BUY,  ORDER_LIMIT, 121, 1,
+	};
+	Matrix *evmat = initmat(4, REPLAY_COLS, events, 1);
+	Matrix *loaded = NULL;
+	long sent = 0, nevents = -1;
+
+	book = initbook(100, 50, 16);
+	log = (FillLog){ 0 };
+	bookonfill(book, logfill, &log);
+	if (!savemat(REPLAY_FILE, evmat) && (loaded = loadmat(REPLAY_FILE)))
+		nevents = bookreplay(book, loaded, bot, &sent);
+
+	if      (!loaded)                                 { FAIL("data store"); }
+	else if (nevents != 4)                            { FAIL("event count"); }
+	else if (sent != 3 || log.filled != 3)            { FAIL("bot fills"); }
+	else if (bookdepth(book, SIDE_SELL, 124) != 0)    { FAIL("ask depth"); }
+	else if (log.maxlatency <= 0)                     { FAIL("tick-to-trade latency"); }
+	else                                              { PASS(); }
+
+	freebook(book);
+	freemat(evmat);
+	if (loaded) freemat(loaded);
+
+	/*** A store header bigger than a Matrix ***/
+	printf("Testing a store too big for one matrix is rejected... ");
+	DataHeader head = { .nrows = (long)INT_MAX + 1, .ncols = REPLAY_COLS };
+	FILE *file = fopen(REPLAY_FILE, "wb");
+	memcpy(head.magic, DATA_MAGIC, DATA_MAGIC_LEN);
+	if (!file || fwrite(&head, sizeof(head), 1, file) != 1) { FAIL("could not write the header"); }
+	else if (fclose(file) || (loaded = loadmat(REPLAY_FILE))) { FAIL("loaded"); }
+	else                                              { PASS(); }
+	unlink(REPLAY_FILE);
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
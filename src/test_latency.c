@@ -0,0 +1,135 @@
+/**
+ * @file    test_latency.c
+ * @brief   Tests the latency histograms in latency.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "latency.h"
+#include "error.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+#define NTHREADS 4
+#define PER_THREAD 100000
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/* Reported values may be up to one bucket (1/64) above the real value */
+#define CLOSE(out, exp) ((out) >= (exp) && (out) <= (exp) + (exp) / 64 + 1)
+
+/*** Helper Functions ***/
+
+static void *recorder(void *arg)
+{
+	long base = (long)arg;
+	long i;
+	for (i = 1; i <= PER_THREAD; i++) latrecord(LAT_PREDICT, base + i);
+	return NULL;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	LatHist *hist = malloc(sizeof(LatHist));
+	LatHist *other = malloc(sizeof(LatHist));
+	long i;
+	if (!hist || !other) DIE("malloc");
+
+	printf("\nTesting latency.c...\n");
+
+	/*** Exact values below the sub bucket count ***/
+	printf("Testing small values... ");
+	lathistreset(hist);
+	for (i = 0; i < 100; i++) lathistrecord(hist, i);
+	if      (lathistpercentile(hist, 50) != 49)     { FAIL("p50"); }
+	else if (lathistpercentile(hist, 99) != 98)     { FAIL("p99"); }
+	else if (lathistpercentile(hist, 100) != 99)    { FAIL("p100"); }
+	else if (hist->min != 0 || hist->max != 99)     { FAIL("min/max"); }
+	else                                            { PASS(); }
+
+	/*** Relative error on a wide range ***/
+	printf("Testing percentiles of 1..1000000... ");
+	lathistreset(hist);
+	for (i = 1; i <= 1000000; i++) lathistrecord(hist, i);
+	long p50 = lathistpercentile(hist, 50);
+	long p99 = lathistpercentile(hist, 99);
+	long p999 = lathistpercentile(hist, 99.9);
+	if      (!CLOSE(p50, 500000))                   { FAIL("p50"); }
+	else if (!CLOSE(p99, 990000))                   { FAIL("p99"); }
+	else if (!CLOSE(p999, 999000))                  { FAIL("p99.9"); }
+	else                                            { PASS(); }
+
+	/*** Clamping ***/
+	printf("Testing out of range values... ");
+	lathistreset(hist);
+	lathistrecord(hist, -5);
+	lathistrecord(hist, 1L << 50);
+	if      (hist->total != 2)                      { FAIL("count"); }
+	else if (hist->min != 0)                        { FAIL("negative value"); }
+	else if (hist->max != (1ULL << LAT_MAX_BITS) - 1) { FAIL("huge value"); }
+	else                                            { PASS(); }
+
+	/*** Merging ***/
+	printf("Testing merging histograms... ");
+	lathistreset(hist);
+	lathistreset(other);
+	for (i = 0; i < 1000; i++) lathistrecord(hist, 1000);
+	for (i = 0; i < 1000; i++) lathistrecord(other, 100000);
+	lathistmerge(hist, other);
+	if      (hist->total != 2000)                   { FAIL("count"); }
+	else if (!CLOSE(lathistpercentile(hist, 25), 1000))     { FAIL("p25"); }
+	else if (!CLOSE(lathistpercentile(hist, 75), 100000))   { FAIL("p75"); }
+	else                                            { PASS(); }
+
+	/*** Per thread recording ***/
+	printf("Testing per thread histograms... ");
+	pthread_t threads[NTHREADS];
+	for (i = 0; i < NTHREADS; i++)
+		pthread_create(&threads[i], NULL, recorder, (void *)(i * PER_THREAD));
+	for (i = 0; i < NTHREADS; i++) pthread_join(threads[i], NULL);
+	latmerge(hist, LAT_PREDICT);
+	if      (hist->total != NTHREADS * PER_THREAD)  { FAIL("count"); }
+	else if (hist->min != 1)                        { FAIL("min"); }
+	else if (hist->max != NTHREADS * PER_THREAD)    { FAIL("max"); }
+	else if (!CLOSE(lathistpercentile(hist, 50), NTHREADS * PER_THREAD / 2)) { FAIL("p50"); }
+	else                                            { PASS(); }
+
+	/*** JSON dump ***/
+	printf("Testing JSON dump... ");
+	char buf[4096] = { 0 };
+	FILE *f = tmpfile();
+	int err = latjson(f);
+	rewind(f);
+	fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	if      (err)                                   { FAIL("latjson"); }
+	else if (!strstr(buf, "\"predict\": { \"count\": 400000")) { FAIL("predict stage"); }
+	else if (strstr(buf, "\"solve\""))              { FAIL("empty stage dumped"); }
+	else                                            { PASS(); }
+
+	/*** Reset ***/
+	printf("Testing reset... ");
+	latreset();
+	latmerge(hist, LAT_PREDICT);
+	if (hist->total != 0)                           { FAIL("count"); }
+	else                                            { PASS(); }
+
+	free(hist);
+	free(other);
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
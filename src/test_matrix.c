@@ -9,6 +9,7 @@
 
 #include "matrix.h"
 #include "logging.h"
+#include "threadpool.h"
 #include "test_data_matrix.h" /* run gen_test_data.py to create this */
 #include "error.h"
 
@@ -35,6 +36,11 @@ printf(" (%s%+.4f%s)\n", (diff >= 0) ? ASCII_GREEN : ASCII_RED, diff, ASCII_RESE
 
 #define FCMP(f1, f2) ((fabs(f1) - fabs(f2)) < EPSILON)
 
+/* Two sided, relative to the expected value once it is bigger than 1 */
+#define FNEAR(f1, f2, tol) (fabs((f1) - (f2)) < (tol) * fmax(1, fabs(f2)))
+#define SOLVE_TOL 1e-6
+#define INV_TOL 1e-8
+
 /*** Globals ***/
 
 static FILE *outfptr;
@@ -107,6 +113,52 @@ int matcmp(const Matrix *mat1, const double *mat2, int len)
 	return EXIT_SUCCESS;
 }
 
+int arrcmp(const double *arr1, const double *arr2, int len)
+{
+	int i;
+	for (i = 0; i < len; i++)
+		if (!(FCMP(arr1[i], arr2[i]))) return 1;
+
+	return EXIT_SUCCESS;
+}
+
+int arrnear(const double *arr1, const double *arr2, int len, double tol)
+{
+	int i;
+	for (i = 0; i < len; i++)
+		if (!(FNEAR(arr1[i], arr2[i], tol))) return 1;
+
+	return EXIT_SUCCESS;
+}
+
+int matnear(const Matrix *mat1, const double *mat2, int len, double tol)
+{
+	if (len != (mat1->ncols * mat1->nrows)) return -1;
+	return arrnear(mat1->vals, mat2, len, tol);
+}
+
+/* 1 if mat is not within tol of the identity */
+int notident(const Matrix *mat, double tol)
+{
+	int i, j;
+	for (i = 0; i < mat->nrows; i++)
+		for (j = 0; j < mat->ncols; j++)
+			if (!(FNEAR(GET(mat, j, i), (double)(i == j), tol))) return 1;
+
+	return EXIT_SUCCESS;
+}
+
+/* Largest absolute difference of two matrices of the same shape */
+double maxdiff(const Matrix *mat1, const Matrix *mat2)
+{
+	double worst = 0;
+	int i;
+	for (i = 0; i < mat1->nrows * mat1->ncols; i++)
+		worst = fmax(worst, fabs(mat1->vals[i] - mat2->vals[i]));
+
+	return worst;
+}
+
 /*** Testing ***/
 
 int main(void)
@@ -118,6 +170,7 @@ int main(void)
 	int nfail = 0;
 	double stime, etime, cdiff;
 
+	tpinit(4);
 	printf("\nTesting matrix.c...\n");
 
 	/*** initmat ***/
@@ -211,6 +264,134 @@ int main(void)
 	else if (matcmp(mat_dmb, MAT_D_M_B, dblen)) { FAIL_MAT_ARR(mat_dmb, MAT_D_M_B); }
 	else                                              { PASS((MUL_T - cdiff)); }
 
+	/*** Strassen-Winograd against the blocked product, odd sizes peel ***/
+	int sshape[] = { 128, 257, 300 };
+	int s, si, oldcross;
+	double serr = 0;
+	for (s = 0; s < (int)(sizeof(sshape) / sizeof(sshape[0])); s++) {
+		int sn = sshape[s];
+		Matrix *sa = initmat(sn, sn, NULL, 1);
+		Matrix *sb = initmat(sn, sn, NULL, 1);
+		Matrix *sclass = initmat(sn, sn, NULL, 1);
+		Matrix *swino = initmat(sn, sn, NULL, 1);
+		srand(sn);
+		for (si = 0; si < sn * sn; si++) {
+			sa->vals[si] = (double)rand() / RAND_MAX * 2 - 1;
+			sb->vals[si] = (double)rand() / RAND_MAX * 2 - 1;
+		}
+		oldcross = matcrossover(0);
+		matmult(sclass, sa, sb);
+		matcrossover(16);
+		matmult(swino, sa, sb);
+		matcrossover(oldcross);
+		for (si = 0; si < sn * sn; si++)
+			serr = fmax(serr, fabs(sclass->vals[si] - swino->vals[si]));
+		freemat(sa);
+		freemat(sb);
+		freemat(sclass);
+		freemat(swino);
+	}
+
+	printf("Testing Strassen-Winograd multiplication...");
+	if (serr > 1e-10) { FAIL_INT_INT((int)(serr * 1e12), 0); }
+	else              { PASS(0.0); }
+
+	/*** GEMV and batched predictions against matmult() ***/
+	int grows = 2003, gcols = 37, gmodels = 5;
+	Matrix *gx = initmat(grows, gcols, NULL, 1);
+	Matrix *gxt = initmat(gcols, grows, NULL, 1);
+	Matrix *gcoef = initmat(gmodels, gcols, NULL, 1);
+	Matrix *gcoeft = initmat(gcols, gmodels, NULL, 1);
+	Matrix *gwant = initmat(grows, gmodels, NULL, 1);
+	Matrix *ggot = initmat(grows, gmodels, NULL, 1);
+	Matrix gvec = { gcols, 1, NULL, 0 }, gout = { grows, 1, NULL, 0 };
+	double *gres = malloc(sizeof(double) * grows), gerr = 0;
+	if (!gres) DIE("malloc");
+	for (si = 0; si < grows * gcols; si++) gx->vals[si] = (double)rand() / RAND_MAX * 2 - 1;
+	for (si = 0; si < gmodels * gcols; si++) gcoef->vals[si] = (double)rand() / RAND_MAX * 2 - 1;
+	matT(gxt, gx);
+	matT(gcoeft, gcoef);
+	matmult(gwant, gx, gcoeft);
+
+	matpredict(ggot, gx, gcoef);
+	for (si = 0; si < grows * gmodels; si++)
+		gerr = fmax(gerr, fabs(ggot->vals[si] - gwant->vals[si]));
+
+	/* The first model on its own, through X and through X^T */
+	gvec.vals = gcoef->vals;
+	gout.vals = gwant->vals;
+	matmult(&gout, gx, &gvec);
+	matgemv(gres, gx, gcoef->vals, 0);
+	for (si = 0; si < grows; si++) gerr = fmax(gerr, fabs(gres[si] - gout.vals[si]));
+	matgemv(gres, gxt, gcoef->vals, 1);
+	for (si = 0; si < grows; si++) gerr = fmax(gerr, fabs(gres[si] - gout.vals[si]));
+
+	Matrix grow = { 1, gcols, gx->vals, 0 }, gmodel = { 1, gcols, gcoef->vals, 0 }, gone = { 1, 1, gres, 0 };
+	matpredict(&gone, &grow, &gmodel);
+	gerr = fmax(gerr, fabs(gres[0] - gout.vals[0]));
+
+	printf("Testing GEMV and batched predictions...");
+	if (gerr > 1e-12) { FAIL_INT_INT((int)(gerr * 1e12), 0); }
+	else              { PASS(0.0); }
+	freemat(gx);
+	freemat(gxt);
+	freemat(gcoef);
+	freemat(gcoeft);
+	freemat(gwant);
+	freemat(ggot);
+	free(gres);
+
+	/*** Fixed size kernels against reference loops and the LU path ***/
+	int fn, fr, fc, fk, ferr = 0;
+	double fvec[8], fx[8], flu[8], fsum, fdiff = 0;
+	for (fn = 2; fn <= 8; fn++) {
+		Matrix *fa = initmat(fn, fn, NULL, 1), *fb = initmat(fn, fn, NULL, 1);
+		Matrix *fres = initmat(fn, fn, NULL, 1), *fcopy = initmat(fn, fn, NULL, 1);
+		for (si = 0; si < fn * fn; si++) {
+			fa->vals[si] = (double)rand() / RAND_MAX * 2 - 1;
+			fb->vals[si] = (double)rand() / RAND_MAX * 2 - 1;
+		}
+		for (fr = 0; fr < fn; fr++) {
+			GET(fa, fr, fr) += fn;
+			fvec[fr] = (double)rand() / RAND_MAX * 2 - 1;
+		}
+
+		matmult(fres, fa, fb);
+		for (fr = 0; fr < fn; fr++)
+			for (fc = 0; fc < fn; fc++) {
+				for (fsum = 0, fk = 0; fk < fn; fk++) fsum += GET(fa, fk, fr) * GET(fb, fc, fk);
+				fdiff = fmax(fdiff, fabs(GET(fres, fc, fr) - fsum));
+			}
+
+		matT(fres, fa);
+		for (fr = 0; fr < fn; fr++)
+			for (fc = 0; fc < fn; fc++) ferr += GET(fres, fc, fr) != GET(fa, fr, fc);
+
+		/* A inv(A) = I */
+		ferr += matinv(fres, fa) != 0;
+		for (fr = 0; fr < fn; fr++)
+			for (fc = 0; fc < fn; fc++) {
+				for (fsum = 0, fk = 0; fk < fn; fk++) fsum += GET(fa, fk, fr) * GET(fres, fc, fk);
+				fdiff = fmax(fdiff, fabs(fsum - (fr == fc)));
+			}
+
+		/* Giving solinv() room for the LU factors takes the general path */
+		memcpy(fcopy->vals, fa->vals, sizeof(double) * fn * fn);
+		ferr += solinv(fa, NULL, fx, fvec) != 0;
+		ferr += solinv(fa, fcopy, flu, fvec) != 0;
+		for (fr = 0; fr < fn; fr++) fdiff = fmax(fdiff, fabs(fx[fr] - flu[fr]));
+
+		freemat(fa);
+		freemat(fb);
+		freemat(fres);
+		freemat(fcopy);
+	}
+
+	printf("Testing fixed size kernels...");
+	if      (ferr)         { FAIL_INT_INT(ferr, 0); }
+	else if (fdiff > 1e-12) { FAIL_INT_INT((int)(fdiff * 1e12), 0); }
+	else                   { PASS(0.0); }
+
 	/*** Transpose ***/
 	Matrix *amatt = initmat(amat->nrows, amat->ncols, NULL, 1);
 	Matrix *bmatt = initmat(bmat->nrows, bmat->ncols, NULL, 1);
@@ -231,6 +412,74 @@ int main(void)
 	else if (matcmp(bmatt, MAT_B_T, blen)) { FAIL_MAT_ARR(amatt, MAT_B_T); }
 	else                                   { PASS((T_T - cdiff)); }
 
+	/*** Blocked and in place transpose ***/
+	int tshape[][2] = { { 37, 53 }, { 130, 65 }, { 96, 96 }, { 1, 9 } };
+	int i, j, terr = 0;
+	for (i = 0; i < (int)(sizeof(tshape) / sizeof(tshape[0])); i++) {
+		Matrix *big = initmat(tshape[i][0], tshape[i][1], NULL, 1);
+		Matrix *bigt = initmat(tshape[i][1], tshape[i][0], NULL, 1);
+		for (j = 0; j < tshape[i][0] * tshape[i][1]; j++) big->vals[j] = j;
+		matT(bigt, big);
+		for (j = 0; j < tshape[i][0] * tshape[i][1]; j++)
+			if (GET(bigt, j / tshape[i][1], j % tshape[i][1]) != j) terr = 1;
+		matTip(big);
+		if (big->nrows != bigt->nrows || big->ncols != bigt->ncols
+			|| memcmp(big->vals, bigt->vals, sizeof(double) * bigt->nrows * bigt->ncols))
+			terr = 1;
+		freemat(big);
+		freemat(bigt);
+	}
+
+	printf("Testing blocked and in place transposing...");
+	if (terr) { FAIL_INT_INT(terr, 0); }
+	else      { PASS(0.0); }
+
+	/*** Rank without rref ***/
+	stime = clock();
+	int arank2 = matrank(amat);
+	int brank2 = matrank(bmat);
+	int crank2 = matrank(cmat);
+	int drank2 = matrank(dmat);
+	etime = clock();
+	cdiff = (etime - stime) / CLOCKS_PER_SEC;
+
+	printf("Testing matrank...");
+	if      (arank2 != RANK_A)                { FAIL_INT_INT(arank2, RANK_A); }
+	else if (brank2 != RANK_B)                { FAIL_INT_INT(brank2, RANK_B); }
+	else if (crank2 != RANK_C)                { FAIL_INT_INT(crank2, RANK_C); }
+	else if (drank2 != RANK_D)                { FAIL_INT_INT(drank2, RANK_D); }
+	else if (matcmp(amat, TEST_DATA_A, alen)) { FAIL_MAT_ARR(amat, TEST_DATA_A); }
+	else                                      { PASS((RREF_T - cdiff)); }
+
+	/*** Blocked rref on a matrix wider than one panel ***/
+	/* For a full rank m x n matrix M = [A | B] the rref is [I | A^-1 B] */
+	int wm = 100, wn = 250;
+	Matrix *wide = initmat(wm, wn, NULL, 1);
+	Matrix *wrref = initmat(wm, wn, NULL, 1);
+	Matrix *wleft = initmat(wm, wm, NULL, 1);
+	Matrix *wright = initmat(wm, wn - wm, NULL, 1);
+	Matrix *wprod = initmat(wm, wn - wm, NULL, 1);
+	srand(5);
+	for (i = 0; i < wm * wn; i++) wide->vals[i] = (double)rand() / RAND_MAX * 2 - 1;
+	memcpy(wrref->vals, wide->vals, sizeof(double) * wm * wn);
+	int wrank = rref(wrref);
+	for (i = 0; i < wm; i++) {
+		memcpy(&GET(wleft, 0, i), &GET(wide, 0, i), sizeof(double) * wm);
+		memcpy(&GET(wright, 0, i), &GET(wrref, wm, i), sizeof(double) * (wn - wm));
+	}
+	matmult(wprod, wleft, wright);
+	double werr = 0;
+	for (i = 0; i < wm; i++)
+		for (j = 0; j < wn; j++) {
+			if (j < wm) werr = fmax(werr, fabs(GET(wrref, j, i) - (i == j)));
+			else        werr = fmax(werr, fabs(GET(wprod, j - wm, i) - GET(wide, j, i)));
+		}
+
+	printf("Testing blocked rref...");
+	if      (wrank != wm)                     { FAIL_INT_INT(wrank, wm); }
+	else if (werr > 1e-8)                     { FAIL_INT_INT((int)(werr * 1e9), 0); }
+	else                                      { PASS(0.0); }
+
 	/*** RREF and rank ***/
 	Matrix *arref = initmat(amat->nrows, amat->ncols, amat->vals, 1);
 	Matrix *brref = initmat(bmat->nrows, bmat->ncols, bmat->vals, 1);
@@ -266,17 +515,121 @@ int main(void)
 	if (!esol || !fsol) DIE("malloc");
 
 	stime = clock();
-	int einv = solve_nxn(emat, esol, TEST_VEC_E);
-	int finv = solve_nxn(fmat, fsol, TEST_VEC_F);
+	int einv = solinv(emat, NULL, esol, TEST_VEC_E);
+	int finv = solinv(fmat, NULL, fsol, TEST_VEC_F);
 	etime = clock();
 	cdiff = (etime - stime) / CLOCKS_PER_SEC;
 
 	printf("Testing non-singular Ax=y solving for x...");
-	if      (einv == CAN_INV_E)              { FAIL_INT_INT(einv, CAN_INV_E); }
-	else if (finv == CAN_INV_F)              { FAIL_INT_INT(finv, CAN_INV_F); }
-	else if (memcmp(esol, SOL_VEC_E, velen)) { FAIL_ARR_ARR(esol, SOL_VEC_E, velen); }
-	else if (memcmp(fsol, SOL_VEC_F, vflen)) { FAIL_ARR_ARR(fsol, SOL_VEC_F, vflen); }
-	else                                     { PASS((NXNSOLVE_T - cdiff)); }
+	if      ((einv == 0) != CAN_INV_E) { FAIL_INT_INT((einv == 0), CAN_INV_E); }
+	else if ((finv == 0) != CAN_INV_F) { FAIL_INT_INT((finv == 0), CAN_INV_F); }
+	else if (CAN_INV_E && arrnear(esol, SOL_VEC_E, velen, SOLVE_TOL)) {
+		FAIL_ARR_ARR(esol, SOL_VEC_E, velen);
+	}
+	else if (CAN_INV_F && arrnear(fsol, SOL_VEC_F, vflen, SOLVE_TOL)) {
+		FAIL_ARR_ARR(fsol, SOL_VEC_F, vflen);
+	}
+	else                               { PASS((NXNSOLVE_T - cdiff)); }
+
+	/*** Inverse and psuodoinverse ***/
+	Matrix *emati = initmat(emat->nrows, emat->ncols, NULL, 1);
+	Matrix *cmatgi = initmat(cmat->ncols, cmat->nrows, NULL, 1);
+	int svlen = (SHAPE_C[0] < SHAPE_C[1]) ? SHAPE_C[0] : SHAPE_C[1];
+	double *csval = malloc(sizeof(double) * svlen);
+	if (!csval) DIE("malloc");
+
+	stime = clock();
+	int eerr = matinv(emati, emat);
+	int cerr = matginv(cmatgi, cmat);
+	matsvd(cmat, 0, NULL, csval, NULL);
+	etime = clock();
+	cdiff = (etime - stime) / CLOCKS_PER_SEC;
+
+	/* A inv(A) = I, A pinv(A) A = A and the singular values are sorted */
+	Matrix *eprod = initmat(emat->nrows, emat->ncols, NULL, 1);
+	Matrix *cprod = initmat(cmat->nrows, cmat->nrows, NULL, 1);
+	Matrix *cback = initmat(cmat->nrows, cmat->ncols, NULL, 1);
+	int unsorted = csval[svlen - 1] < 0;
+	for (i = 1; i < svlen; i++) unsorted += csval[i] > csval[i - 1];
+	if (CAN_INV_E && !eerr) matmult(eprod, emat, emati);
+	matmult(cprod, cmat, cmatgi);
+	matmult(cback, cprod, cmat);
+
+	printf("Testing inverse...");
+	if      ((eerr == 0) != CAN_INV_E)     { FAIL_INT_INT((eerr == 0), CAN_INV_E); }
+	else if (CAN_INV_E && matnear(emati, INV_E, elen, INV_TOL)) { FAIL_MAT_ARR(emati, INV_E); }
+	else if (CAN_INV_E && notident(eprod, INV_TOL))             { FAIL_MAT_ARR(eprod, INV_E); }
+	else                                   { PASS((INV_T - cdiff)); }
+
+	printf("Testing psuodoinverse...");
+	if      (cerr)                                   { FAIL_INT_INT(cerr, 0); }
+	else if (matnear(cmatgi, PINV_C, clen, INV_TOL)) { FAIL_MAT_ARR(cmatgi, PINV_C); }
+	else if (matnear(cback, TEST_DATA_C, clen, INV_TOL)) { FAIL_MAT_ARR(cback, TEST_DATA_C); }
+	else if (arrnear(csval, SVAL_C, svlen, INV_TOL)) { FAIL_ARR_ARR(csval, SVAL_C, svlen); }
+	else if (unsorted)                               { FAIL_ARR_ARR(csval, SVAL_C, svlen); }
+	else                                             { PASS((INV_T - cdiff)); }
+
+	freemat(eprod);
+	freemat(cprod);
+	freemat(cback);
+
+	/*** Rank deficient psuodoinverse, the third column is the sum of the others ***/
+	double rvals[] = { 1, 2, 3,  4, 5, 9,  7, 8, 15,  2, -1, 1 };
+	Matrix *rmat = initmat(4, 3, rvals, 1);
+	Matrix *rgi = initmat(3, 4, NULL, 1);
+	Matrix *rag = initmat(4, 4, NULL, 1);
+	Matrix *rga = initmat(3, 3, NULL, 1);
+	Matrix *ragt = initmat(4, 4, NULL, 1);
+	Matrix *rgat = initmat(3, 3, NULL, 1);
+	Matrix *raga = initmat(4, 3, NULL, 1);
+	Matrix *rgag = initmat(3, 4, NULL, 1);
+	double rsval[3], rerr;
+	int rerrc = matginv(rgi, rmat);
+	int rrank = matsvd(rmat, 0, NULL, rsval, NULL);
+	matmult(rag, rmat, rgi);
+	matmult(rga, rgi, rmat);
+	matmult(raga, rag, rmat);
+	matmult(rgag, rga, rgi);
+	matT(ragt, rag);
+	matT(rgat, rga);
+
+	/* The four Penrose conditions, relative to the size of A */
+	rerr = fmax(maxdiff(raga, rmat), maxdiff(rgag, rgi) * rsval[0]);
+	rerr = fmax(rerr, fmax(maxdiff(rag, ragt), maxdiff(rga, rgat)));
+
+	printf("Testing rank deficient psuodoinverse...");
+	if      (rerrc)                          { FAIL_INT_INT(rerrc, 0); }
+	else if (rrank != 2)                     { FAIL_INT_INT(rrank, 2); }
+	else if (rerr > 1e-10 * rsval[0])        { FAIL_INT_INT((int)(rerr * 1e12), 0); }
+	else                                     { PASS(0.0); }
+
+	/*** Truncated SVD keeps the biggest singular triplet ***/
+	Matrix *ru = initmat(4, 1, NULL, 1);
+	Matrix *rv = initmat(3, 1, NULL, 1);
+	Matrix *rav = initmat(4, 1, NULL, 1);
+	double rs1;
+	int rtrank = matsvd(rmat, 1, ru, &rs1, rv);
+	matmult(rav, rmat, rv);
+	for (rerr = 0, i = 0; i < 4; i++) rerr = fmax(rerr, fabs(rav->vals[i] - rs1 * ru->vals[i]));
+
+	printf("Testing truncated SVD...");
+	if      (rtrank != 2)                    { FAIL_INT_INT(rtrank, 2); }
+	else if (!FNEAR(rs1, rsval[0], 1e-12))   { FAIL_ARR_ARR(&rs1, rsval, 1); }
+	else if (rerr > 1e-10 * rsval[0])        { FAIL_INT_INT((int)(rerr * 1e12), 0); }
+	else                                     { PASS(0.0); }
+
+	freemat(rmat);
+	freemat(rgi);
+	freemat(rag);
+	freemat(rga);
+	freemat(ragt);
+	freemat(rgat);
+	freemat(raga);
+	freemat(rgag);
+	freemat(ru);
+	freemat(rv);
+	freemat(rav);
+	tpfree();
 
 	/*** total ***/
 	printf("%s%d/%d PASSED%s", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
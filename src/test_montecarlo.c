@@ -0,0 +1,162 @@
+/**
+ * @file    test_montecarlo.c
+ * @brief   Tests the bootstrap engine in montecarlo.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "montecarlo.h"
+#include "matrix.h"
+#include "threadpool.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+#define N 1000
+#define P 4
+#define RESAMPLES 1000
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+static const double TRUE_COEF[P] = { 0.5, -1.0, 2.0, 0.25 };
+
+/* Roughly normal from the sum of uniforms */
+static double randn(void)
+{
+	double sum = 0;
+	int i;
+	for (i = 0; i < 12; i++) sum += (double)rand() / RAND_MAX;
+	return sum - 6;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	int i, j, runs;
+	long r, k, idx[N];
+	double returns[N], y[N], mean = 0, var = 0, sample, lo, hi, se;
+	double *a = malloc(sizeof(double) * RESAMPLES);
+	double *b = malloc(sizeof(double) * RESAMPLES);
+	McOptions opt;
+	if (!a || !b) DIE("malloc");
+
+	srand(47);
+	printf("\nTesting montecarlo.c...\n");
+	for (i = 0; i < N; i++) {
+		returns[i] = 0.001 + 0.01 * randn();
+		mean += returns[i] / N;
+	}
+	for (i = 0; i < N; i++) var += (returns[i] - mean) * (returns[i] - mean) / (N - 1);
+	sample = mean / sqrt(var);
+	mcdefaults(&opt);
+	opt.nresample = RESAMPLES;
+	opt.seed = 1234;
+
+	/*** Generators ***/
+	printf("Testing the generator lanes are uniform and independent... ");
+	McRng rng;
+	uint64_t draws[MC_LANES];
+	double u, lanes[MC_LANES] = { 0 }, cross = 0;
+	mcseed(&rng, 99, 0);
+	for (k = 0; k < 100000; k++) {
+		mcnext(&rng, draws);
+		for (i = 0; i < MC_LANES; i++) {
+			u = (draws[i] >> 11) * 0x1p-53;
+			lanes[i] += u / 100000;
+		}
+		cross += ((draws[0] >> 11) * 0x1p-53 - 0.5) * ((draws[1] >> 11) * 0x1p-53 - 0.5) / 100000;
+	}
+	for (i = 0, u = 0; i < MC_LANES; i++) u = fmax(u, fabs(lanes[i] - 0.5));
+	if      (u > 0.005)            { FAIL("lane mean is not 1/2"); }
+	else if (fabs(cross) > 0.002)  { FAIL("lanes are correlated"); }
+	else                           { PASS(); }
+
+	/*** Blocks ***/
+	printf("Testing block resampling... ");
+	opt.block = 20;
+	mcresample(idx, N, &opt, 7);
+	for (runs = 0, i = 0; i < N; i++)
+		if (i % 20 && idx[i] != (idx[i - 1] + 1) % N) runs++;
+	opt.block = 1;
+	if (runs) { FAIL("a block is not consecutive rows"); }
+	else      { PASS(); }
+
+	/*** Same result on any amount of threads ***/
+	printf("Testing the result does not depend on the threads... ");
+	tpinit(4);
+	mcsharpe(returns, N, &opt, a);
+	tpfree();
+	tpinit(1);
+	mcsharpe(returns, N, &opt, b);
+	tpfree();
+	tpinit(3);
+	if (memcmp(a, b, sizeof(double) * RESAMPLES)) { FAIL("results differ"); }
+	else                                          { PASS(); }
+
+	/*** Sharpe ratio against its asymptotic standard error ***/
+	printf("Testing the Sharpe ratio interval... ");
+	mcinterval(a, RESAMPLES, 1, 0.95, &lo, &hi);
+	se = sqrt((1 + sample * sample / 2) / N);
+	if      (lo > sample || hi < sample)                     { FAIL("sample Sharpe ratio outside"); }
+	else if (fabs((hi - lo) / (2 * 1.96 * se) - 1) > 0.15)   { FAIL("width differs from theory"); }
+	else                                                     { PASS(); }
+
+	/*** Drawdown of a resample against the direct one ***/
+	printf("Testing the drawdown distribution... ");
+	opt.block = 10;
+	mcdrawdown(returns, N, &opt, a);
+	double cum = 0, peak = 0, worst = 0, least = HUGE_VAL;
+	mcresample(idx, N, &opt, 17);
+	for (i = 0; i < N; i++) {
+		cum += returns[idx[i]];
+		peak = fmax(peak, cum);
+		worst = fmax(worst, peak - cum);
+	}
+	for (r = 0; r < RESAMPLES; r++) least = fmin(least, a[r]);
+	opt.block = 1;
+	if      (a[17] != worst)  { FAIL("resample differs"); }
+	else if (least < 0)       { FAIL("negative drawdown"); }
+	else                      { PASS(); }
+
+	/*** Regression coefficients ***/
+	printf("Testing the coefficient intervals... ");
+	Matrix *x = initmat(N, P, NULL, 1);
+	Matrix *coefs = initmat(RESAMPLES, P, NULL, 1);
+	for (i = 0; i < N; i++) {
+		GET(x, 0, i) = 1;
+		for (j = 1; j < P; j++) GET(x, j, i) = randn();
+		for (y[i] = randn(), j = 0; j < P; j++) y[i] += TRUE_COEF[j] * GET(x, j, i);
+	}
+	int outside = 0, err = mccoef(x, y, &opt, coefs);
+	for (j = 0; j < P; j++) {
+		mcinterval(coefs->vals + j, RESAMPLES, P, 0.99, &lo, &hi);
+		outside += TRUE_COEF[j] < lo || TRUE_COEF[j] > hi;
+		outside += (hi - lo) > 0.25;
+	}
+	if      (err)      { FAIL("mccoef"); }
+	else if (outside)  { FAIL("intervals miss the true coefficients"); }
+	else               { PASS(); }
+
+	freemat(x);
+	freemat(coefs);
+	free(a);
+	free(b);
+	tpfree();
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
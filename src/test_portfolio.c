@@ -0,0 +1,200 @@
+/**
+ * @file    test_portfolio.c
+ * @brief   Tests the active-set portfolio optimizer in portfolio.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "portfolio.h"
+#include "symmat.h"
+#include "matrix.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+#define N 60
+#define GAMMA 200.0
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+static double randu(void)
+{
+	return (double)rand() / RAND_MAX * 2 - 1;
+}
+
+/* A covariance from a few factors plus noise, like a real one */
+static void randcov(SymMatrix *cov)
+{
+	Matrix *rows = initmat(3 * N, N, NULL, 1);
+	int i;
+
+	for (i = 0; i < 3 * N * N; i++) rows->vals[i] = 0.02 * randu();
+	memset(cov->vals, 0, sizeof(double) * SIDX(0, N));
+	symrankk(cov, 1.0 / (3 * N), rows);
+	for (i = 0; i < N; i++) SGET(cov, i, i) += 1e-4;
+	freemat(rows);
+}
+
+/* Largest violation of the KKT conditions of the solution */
+static double kkt(const Portfolio *port, const SymMatrix *cov, const double *mu)
+{
+	double g[N], nu = 0, sum = 0, worst;
+	int i, nfree = 0;
+
+	symmv(cov, port->weights, g);
+	for (i = 0; i < N; i++) {
+		g[i] = GAMMA * g[i] - mu[i];
+		sum += port->weights[i];
+		if (port->state[i] == PORT_FREE) {
+			nu -= g[i];
+			nfree++;
+		}
+	}
+	if (nfree) {
+		nu /= nfree;
+	} else {
+		/* At a vertex any nu between the limits of the two sides will do */
+		double nulo = -HUGE_VAL, nuhi = HUGE_VAL;
+		for (i = 0; i < N; i++) {
+			if (port->state[i] == PORT_LOWER) nulo = fmax(nulo, -g[i]);
+			else                              nuhi = fmin(nuhi, -g[i]);
+		}
+		nu = isinf(nuhi) ? nulo : isinf(nulo) ? nuhi : (nulo + nuhi) / 2;
+	}
+
+	worst = fabs(sum - port->budget);
+	for (i = 0; i < N; i++) {
+		worst = fmax(worst, port->lo[i] - port->weights[i]);
+		worst = fmax(worst, port->weights[i] - port->hi[i]);
+		if (port->state[i] == PORT_FREE)       worst = fmax(worst, fabs(g[i] + nu));
+		else if (port->state[i] == PORT_LOWER) worst = fmax(worst, -(g[i] + nu));
+		else                                   worst = fmax(worst, g[i] + nu);
+	}
+	return worst;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	int i, err, cold, warm;
+	double mu[N], sol[N], ones[N], sum;
+
+	SymMatrix *cov = initsym(N);
+	Matrix *full = initmat(N, N, NULL, 1);
+	Portfolio *port = initport(N);
+	Portfolio *fresh = initport(N);
+
+	srand(31);
+	printf("\nTesting portfolio.c...\n");
+
+	randcov(cov);
+	for (i = 0; i < N; i++) mu[i] = 0.01 * randu();
+
+	/*** No limits, the closed form through the budget multiplier ***/
+	printf("Testing without limits against the closed form... ");
+	for (i = 0; i < N; i++) {
+		port->lo[i] = -HUGE_VAL;
+		ones[i] = 1;
+	}
+	err = portsolve(port, cov, mu, GAMMA);
+	symunpack(full, cov);
+	solchol(full, NULL, sol, mu);
+	double a = 0, b = 0, worst = 0;
+	for (i = 0; i < N; i++) a += sol[i] / GAMMA;
+	solchol(full, NULL, ones, ones);
+	for (i = 0; i < N; i++) b += ones[i];
+	for (i = 0; i < N; i++)
+		worst = fmax(worst, fabs(port->weights[i] - (sol[i] / GAMMA - (a - 1) / b * ones[i])));
+	if      (err < 0)       { FAIL("failed"); }
+	else if (worst > 1e-8)  { FAIL("weights differ"); }
+	else                    { PASS(); }
+
+	/*** Long only ***/
+	printf("Testing long only... ");
+	for (i = 0; i < N; i++) port->lo[i] = 0;
+	port->solved = 0;
+	err = portsolve(port, cov, mu, GAMMA);
+	if      (err < 0)                      { FAIL("failed"); }
+	else if (kkt(port, cov, mu) > 1e-8)    { FAIL("not optimal"); }
+	else if (port->nfree == N)             { FAIL("no limit active"); }
+	else                                   { PASS(); }
+
+	/*** Warm start after a small move ***/
+	printf("Testing the warm start after a rebalance... ");
+	for (i = 0; i < N; i++) {
+		mu[i] += 0.0005 * randu();
+		SGET(cov, i, i) *= 1.01;
+	}
+	warm = portsolve(port, cov, mu, GAMMA);
+	cold = portsolve(fresh, cov, mu, GAMMA);
+	worst = 0;
+	for (i = 0; i < N; i++) worst = fmax(worst, fabs(port->weights[i] - fresh->weights[i]));
+	if      (warm < 0 || cold < 0)         { FAIL("failed"); }
+	else if (kkt(port, cov, mu) > 1e-8)    { FAIL("not optimal"); }
+	else if (worst > 1e-8)                 { FAIL("differs from the cold start"); }
+	else if (warm >= cold)                 { FAIL("no fewer changes than a cold start"); }
+	else                                   { PASS(); }
+
+	/*** Per asset limits ***/
+	printf("Testing per asset limits... ");
+	for (i = 0; i < N; i++) port->hi[i] = 0.05;
+	port->budget = 0.9;
+	err = portsolve(port, cov, mu, GAMMA);
+	sum = 0;
+	for (i = 0; i < N; i++) sum += port->state[i] == PORT_UPPER;
+	if      (err < 0)                      { FAIL("failed"); }
+	else if (kkt(port, cov, mu) > 1e-8)    { FAIL("not optimal"); }
+	else if (sum == 0)                     { FAIL("no upper limit active"); }
+	else                                   { PASS(); }
+
+	/*** Limits that can not be met ***/
+	printf("Testing a budget the limits can not meet... ");
+	for (i = 0; i < N; i++) port->hi[i] = 0.01;
+	if (portsolve(port, cov, mu, GAMMA) >= 0) { FAIL("not reported"); }
+	else                                      { PASS(); }
+
+	/*** A limit hit without moving ***/
+	printf("Testing a free asset that hits its limit at once... ");
+	/* Asset 4 hits its lower limit with the step scaled to 0, it must
+	 * not be taken for the infinite upper one */
+	static const double small[15] = { 3, 2, 5, 0, 0, 5, -1, -3, 2, 4, 0, 0, 1, 0, 4 };
+	static const double smallmu[5] = { 0, 1, 0, 0, 0 };
+	static const double want[5] = { 0, 0.5, 0, 0.4375, 0.0625 };
+	SymMatrix *scov = initsym(5);
+	Portfolio *sport = initport(5);
+	memcpy(scov->vals, small, sizeof(small));
+	for (i = 0; i < 5; i++) {
+		sport->lo[i] = (i == 3) ? -1 : 0;
+		sport->hi[i] = (i == 4) ? HUGE_VAL : 0.5;
+	}
+	err = portsolve(sport, scov, smallmu, 1);
+	worst = 0;
+	for (i = 0; i < 5; i++) worst = fmax(worst, fabs(sport->weights[i] - want[i]));
+	if      (err < 0)               { FAIL("failed"); }
+	else if (!(worst < 1e-12))      { FAIL("weights wrong or not finite"); }
+	else                            { PASS(); }
+	freeport(sport);
+	freesym(scov);
+
+	freeport(port);
+	freeport(fresh);
+	freesym(cov);
+	freemat(full);
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
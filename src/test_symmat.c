@@ -0,0 +1,159 @@
+/**
+ * @file    test_symmat.c
+ * @brief   Tests the packed symmetric matrices in symmat.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "symmat.h"
+#include "matrix.h"
+#include "threadpool.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+#define N 150      /* More than two SYM_BLOCK tiles, not a multiple of one */
+#define K 37
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+static double randu(void)
+{
+	return (double)rand() / RAND_MAX * 2 - 1;
+}
+
+static void randfill(Matrix *mat)
+{
+	int i;
+	for (i = 0; i < mat->nrows * mat->ncols; i++) mat->vals[i] = randu();
+}
+
+static double maxdiff(const double *a, const double *b, int len)
+{
+	double d, worst = 0;
+	int i;
+	for (i = 0; i < len; i++)
+		if ((d = fabs(a[i] - b[i])) > worst) worst = d;
+	return worst;
+}
+
+/* Fill in the upper triangle of a matrix that only has its lower one set */
+static void mirror(Matrix *mat)
+{
+	int x, y;
+	for (y = 0; y < mat->nrows; y++)
+		for (x = 0; x < y; x++) GET(mat, y, x) = GET(mat, x, y);
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	int i, x, y, err;
+
+	SymMatrix *sym = initsym(N);
+	Matrix *rows = initmat(K, N, NULL, 1);
+	Matrix *full = initmat(N, N, NULL, 1);
+	Matrix *got = initmat(N, N, NULL, 1);
+	double *vec = malloc(sizeof(double) * N);
+	double *res = malloc(sizeof(double) * N);
+	double *sol = malloc(sizeof(double) * N);
+	if (!vec || !res || !sol) DIE("malloc");
+
+	srand(17);
+	tpinit(4);
+	printf("\nTesting symmat.c...\n");
+
+	/*** Packing ***/
+	printf("Testing sympack and symunpack... ");
+	randfill(full);
+	mirror(full);
+	sympack(sym, full);
+	symunpack(got, sym);
+	if      (memcmp(got->vals, full->vals, sizeof(double) * N * N)) { FAIL("round trip"); }
+	else if (SGET(sym, 3, 70) != GET(full, 3, 70))                 { FAIL("lower"); }
+	else if (SGET(sym, 70, 3) != GET(full, 70, 3))                 { FAIL("upper"); }
+	else                                                           { PASS(); }
+
+	/*** Updates against matsyrk ***/
+	printf("Testing symrankk against matsyrk... ");
+	randfill(rows);
+	memset(full->vals, 0, sizeof(double) * N * N);
+	memset(sym->vals, 0, sizeof(double) * SIDX(0, N));
+	matsyrk(full, rows);
+	mirror(full);
+	symrankk(sym, 1, rows);
+	symunpack(got, sym);
+	if (maxdiff(got->vals, full->vals, N * N) > 1e-12) { FAIL("differs"); }
+	else                                               { PASS(); }
+
+	printf("Testing symrank1 downdates symrankk... ");
+	for (i = 0; i < K; i++) symrank1(sym, -1, &GET(rows, 0, i));
+	err = 0;
+	for (i = 0; i < (int)SIDX(0, N); i++)
+		if (fabs(sym->vals[i]) > 1e-12) err = 1;
+	if (err) { FAIL("not zero"); }
+	else     { PASS(); }
+
+	/*** Matrix-vector product ***/
+	printf("Testing symmv... ");
+	randfill(full);
+	mirror(full);
+	sympack(sym, full);
+	for (i = 0; i < N; i++) vec[i] = randu();
+	symmv(sym, vec, res);
+	for (y = 0; y < N; y++) {
+		sol[y] = 0;
+		for (x = 0; x < N; x++) sol[y] += GET(full, x, y) * vec[x];
+	}
+	if (maxdiff(res, sol, N) > 1e-12) { FAIL("differs"); }
+	else                              { PASS(); }
+
+	/*** Cholesky against solchol ***/
+	printf("Testing symchol against solchol... ");
+	memset(full->vals, 0, sizeof(double) * N * N);
+	matsyrk(full, rows);
+	randfill(rows);
+	matsyrk(full, rows);
+	for (i = 0; i < N; i++) GET(full, i, i) += 1;
+	mirror(full);
+	sympack(sym, full);
+	for (i = 0; i < N; i++) res[i] = vec[i];
+	solchol(full, NULL, sol, vec);
+	err = symchol(sym);
+	symcholsolve(sym, res);
+	if      (err)                        { FAIL("not positive definite"); }
+	else if (maxdiff(res, sol, N) > 1e-9) { FAIL("solutions differ"); }
+	else                                 { PASS(); }
+
+	printf("Testing symchol on an indefinite matrix... ");
+	sympack(sym, full);
+	SGET(sym, 5, 5) = -1;
+	if (symchol(sym) >= 0) { FAIL("not reported"); }
+	else                   { PASS(); }
+
+	tpfree();
+	free(vec);
+	free(res);
+	free(sol);
+	freesym(sym);
+	freemat(rows);
+	freemat(full);
+	freemat(got);
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
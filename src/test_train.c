@@ -0,0 +1,377 @@
+/**
+ * @file    test_train.c
+ * @brief   Tests the model training functions in train.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "train.h"
+#include "data.h"
+#include "latency.h"
+#include "matrix.h"
+#include "threadpool.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*** Defines ***/
+
+#define STREAM_FILE "./tests/train/stream.mat"
+
+#define NROWS 5000
+#define NFEAT 6
+
+/* Wide enough that the iterative solvers take a while */
+#define WROWS 3000
+#define WFEAT 120
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+static const double TRUE_COEF[NFEAT] = { 1.5, -2.0, 0.25, 3.0, -0.75, 0.5 };
+
+static double randu(void)
+{
+	return (double)rand() / RAND_MAX * 2 - 1;
+}
+
+/* Counts the runs of every thread, each thread has its own slot */
+static void countruns(void *arg, int id, int nthreads)
+{
+	(void)nthreads;
+	((int *)arg)[id]++;
+}
+
+/* Rows of [1 x1 .. x5 y] with y = X * TRUE_COEF + noise */
+static Matrix *makedata(int nrows, double noise)
+{
+	Matrix *z = initmat(nrows, NFEAT + 1, NULL, 1);
+	int i, j;
+	double y;
+
+	for (i = 0; i < nrows; i++) {
+		GET(z, 0, i) = 1;
+		y = TRUE_COEF[0];
+		for (j = 1; j < NFEAT; j++) {
+			GET(z, j, i) = randu();
+			y += TRUE_COEF[j] * GET(z, j, i);
+		}
+		GET(z, NFEAT, i) = y + noise * randu();
+	}
+	return z;
+}
+
+static double maxdiff(const double *a, const double *b, int len)
+{
+	double d, worst = 0;
+	int i;
+	for (i = 0; i < len; i++)
+		if ((d = fabs(a[i] - b[i])) > worst) worst = d;
+	return worst;
+}
+
+/* Worst violation of the elastic net optimality conditions at b */
+static double kktcheck(const Matrix *gram, long n, double lambda, double alpha,
+					   const double *b)
+{
+	int j, k, p = gram->nrows - 1;
+	double q, err, worst = 0;
+
+	for (j = 0; j < p; j++) {
+		q = GET(gram, p, j);
+		for (k = 0; k < p; k++) q -= GET(gram, k, j) * b[k];
+		q -= n * lambda * (1 - alpha) * b[j];
+
+		if (b[j] > 0)      err = fabs(q - n * lambda * alpha);
+		else if (b[j] < 0) err = fabs(q + n * lambda * alpha);
+		else               err = fmax(fabs(q) - n * lambda * alpha, 0);
+		if (err > worst) worst = err;
+	}
+	return worst / n;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	double coef[NFEAT];
+	int i, j, r;
+
+	srand(7);
+	tpinit(4);
+	printf("\nTesting train.c...\n");
+	Matrix *z = makedata(NROWS, 0);
+
+	/*** Symmetric rank-k update against the plain product ***/
+	printf("Testing matsyrk... ");
+	Matrix *zt = initmat(z->ncols, z->nrows, NULL, 1);
+	Matrix *exp = initmat(z->ncols, z->ncols, NULL, 1);
+	Matrix *out = initmat(z->ncols, z->ncols, NULL, 1);
+	for (i = 0; i < z->nrows; i++)
+		for (j = 0; j < z->ncols; j++)
+			GET(zt, i, j) = GET(z, j, i);
+	matmult(exp, zt, z);
+	matsyrk(out, z);
+	if (maxdiff(out->vals, exp->vals, z->ncols * z->ncols) > 1e-8) { FAIL("Z^TZ"); }
+	else                                                            { PASS(); }
+	freemat(zt);
+	freemat(exp);
+	freemat(out);
+
+	/*** Wide matrices use the tiled path ***/
+	printf("Testing wide matsyrk... ");
+	Matrix *w = initmat(400, 300, NULL, 1);
+	Matrix *wg = initmat(300, 300, NULL, 1);
+	double sum, worst = 0;
+	for (i = 0; i < 400 * 300; i++) w->vals[i] = randu();
+	matsyrk(wg, w);
+	for (i = 0; i < 300; i++) {
+		for (j = 0; j < 300; j++) {
+			for (sum = 0, r = 0; r < 400; r++) sum += GET(w, i, r) * GET(w, j, r);
+			if (fabs(sum - GET(wg, j, i)) > worst) worst = fabs(sum - GET(wg, j, i));
+		}
+	}
+	if (worst > 1e-9) { FAIL("W^TW"); }
+	else              { PASS(); }
+	freemat(w);
+	freemat(wg);
+
+	/*** Streaming LSE on a file, in chunks that don't divide the rows ***/
+	printf("Testing streaming LSE... ");
+	long nread = -1;
+	Matrix *gram = initmat(NFEAT + 1, NFEAT + 1, NULL, 1);
+	if (!savemat(STREAM_FILE, z)) nread = gramstream(STREAM_FILE, gram, 333);
+	int err = trainstream(STREAM_FILE, coef, 333);
+	if      (nread != NROWS)                        { FAIL("rows read"); }
+	else if (err)                                   { FAIL("trainstream"); }
+	else if (maxdiff(coef, TRUE_COEF, NFEAT) > 1e-8) { FAIL("coefficients"); }
+	else                                            { PASS(); }
+	freemat(gram);
+
+	/*** Gradient descent ***/
+	static const char *names[] = { "SGD", "momentum", "Adam" };
+	static const double tols[] = { 1e-6, 1e-6, 1e-3 };
+	GDOptions opt;
+	Matrix *gx = initmat(NROWS, NFEAT, NULL, 1);
+	double *gy = malloc(sizeof(double) * NROWS);
+	int method;
+	if (!gy) DIE("malloc");
+	for (i = 0; i < NROWS; i++) {
+		for (j = 0; j < NFEAT; j++) GET(gx, j, i) = GET(z, j, i);
+		gy[i] = GET(z, NFEAT, i);
+	}
+
+	for (method = GD_SGD; method <= GD_ADAM; method++) {
+		printf("Testing %s gradient descent... ", names[method]);
+		gddefaults(&opt, method);
+		opt.epochs = 50;
+		if (method == GD_ADAM) opt.rate = 0.01;
+		for (j = 0; j < NFEAT; j++) coef[j] = 0;
+		err = traingd(gx, gy, coef, &opt);
+		if      (err)                                       { FAIL("traingd"); }
+		else if (maxdiff(coef, TRUE_COEF, NFEAT) > tols[method]) { FAIL("coefficients"); }
+		else                                                { PASS(); }
+	}
+
+	/* Full batches are big enough to be split over the threads */
+	printf("Testing full batch gradient descent... ");
+	gddefaults(&opt, GD_MOMENTUM);
+	opt.batch = 0;
+	opt.rate = 0.1;
+	opt.epochs = 500;
+	for (j = 0; j < NFEAT; j++) coef[j] = 0;
+	err = traingd(gx, gy, coef, &opt);
+	if      (err)                                       { FAIL("traingd"); }
+	else if (maxdiff(coef, TRUE_COEF, NFEAT) > 1e-6)    { FAIL("coefficients"); }
+	else                                                { PASS(); }
+
+	printf("Testing diverging gradient descent... ");
+	gddefaults(&opt, GD_SGD);
+	opt.rate = 10;
+	for (j = 0; j < NFEAT; j++) coef[j] = 0;
+	if (!traingd(gx, gy, coef, &opt)) { FAIL("no error"); }
+	else                              { PASS(); }
+	freemat(gx);
+	free(gy);
+	freemat(z);
+
+	/*** Regularized regression from the Gram matrix ***/
+	Matrix *noisy = makedata(NROWS, 0.5);
+	Matrix *ngram = initmat(NFEAT + 1, NFEAT + 1, NULL, 1);
+	matsyrk(ngram, noisy);
+
+	printf("Testing ridge regression... ");
+	err = trainridge(ngram, NROWS, 0.1, coef);
+	if      (err)                                     { FAIL("trainridge"); }
+	else if (kktcheck(ngram, NROWS, 0.1, 0, coef) > 1e-10) { FAIL("optimality"); }
+	else                                              { PASS(); }
+
+	static const double alphas[] = { 1, 0.5, 0 };
+	double lambdas[50];
+	PathOptions popt;
+	Matrix *path = initmat(50, NFEAT, NULL, 1);
+	LatHist hist;
+	int a, k, nzero;
+	for (a = 0; a < 3; a++) {
+		printf("Testing regularization path with alpha %.1f... ", alphas[a]);
+		pathdefaults(&popt, alphas[a]);
+		popt.nlambda = 50;
+		latreset();
+		int nfit = trainpath(ngram, NROWS, &popt, lambdas, path);
+		latmerge(&hist, LAT_TRAIN);
+
+		double worst = 0, v;
+		for (k = 0; k < nfit; k++)
+			if ((v = kktcheck(ngram, NROWS, lambdas[k], alphas[a], &GET(path, 0, k))) > worst)
+				worst = v;
+		for (nzero = 0, j = 0; j < NFEAT; j++) nzero += GET(path, j, 0) == 0;
+
+		if      (nfit != 50)                          { FAIL("trainpath"); }
+		else if (hist.total != 1)                     { FAIL("not one latency per path"); }
+		else if (worst > 1e-5)                        { FAIL("optimality"); }
+		else if (alphas[a] > 0 && nzero != NFEAT)     { FAIL("largest lambda not all zero"); }
+		else if (alphas[a] > 0 && maxdiff(&GET(path, 0, 49), TRUE_COEF, NFEAT) > 0.05) {
+			FAIL("smallest lambda");
+		}
+		else                                          { PASS(); }
+	}
+	freemat(path);
+
+	/*** Cross validation against refitting every fold ***/
+	printf("Testing k-fold cross validation... ");
+	static const double cvlambdas[] = { 0, 0.001, 0.01, 0.1, 1 };
+	double cverr[5], experr[5] = { 0 };
+	int nfolds = 7, f, l, best;
+	long fs, fe;
+	Matrix *fgram = initmat(NFEAT + 1, NFEAT + 1, NULL, 1);
+	Matrix rowview = { 1, NFEAT + 1, NULL, 0 };
+
+	latreset();
+	best = traincv(noisy, nfolds, cvlambdas, 5, cverr, coef);
+	latmerge(&hist, LAT_TRAIN);
+	for (f = 0; f < nfolds; f++) {
+		tprange(NROWS, f, nfolds, &fs, &fe);
+		memset(fgram->vals, 0, sizeof(double) * (NFEAT + 1) * (NFEAT + 1));
+		for (r = 0; r < NROWS; r++) {
+			if (r >= fs && r < fe) continue;
+			rowview.vals = &GET(noisy, 0, r);
+			matsyrk(fgram, &rowview);
+		}
+		for (l = 0; l < 5; l++) {
+			double b[NFEAT], res;
+			trainridge(fgram, NROWS - (fe - fs), cvlambdas[l], b);
+			for (r = fs; r < fe; r++) {
+				res = GET(noisy, NFEAT, r);
+				for (j = 0; j < NFEAT; j++) res -= GET(noisy, j, r) * b[j];
+				experr[l] += res * res / NROWS;
+			}
+		}
+	}
+	if      (best < 0)                                { FAIL("traincv"); }
+	else if (hist.total != 1)                         { FAIL("not one latency per run"); }
+	else if (maxdiff(cverr, experr, 5) > 1e-9)        { FAIL("fold errors"); }
+	else if (best != 0 && best != 1)                  { FAIL("best lambda"); }
+	else if (maxdiff(coef, TRUE_COEF, NFEAT) > 0.05)  { FAIL("refit"); }
+	else                                              { PASS(); }
+	freemat(fgram);
+
+	printf("Testing cross validation with too many folds... ");
+	if (traincv(noisy, NROWS + 1, cvlambdas, 5, cverr, NULL) != -1) { FAIL("no error"); }
+	else                                                          { PASS(); }
+
+	freemat(ngram);
+	freemat(noisy);
+
+	/*** Iterative solvers against the ridge closed form ***/
+	Matrix *wx = initmat(WROWS, WFEAT, NULL, 1);
+	Matrix *wz = initmat(WROWS, WFEAT + 1, NULL, 1);
+	Matrix *wgram = initmat(WFEAT + 1, WFEAT + 1, NULL, 1);
+	double *wy = malloc(sizeof(double) * WROWS);
+	double want[WFEAT], got[WFEAT], common;
+	IterOptions iopt;
+	int cold, warm;
+	if (!wy) DIE("malloc");
+
+	/* Correlated columns of different scales, so preconditioning matters */
+	for (r = 0; r < WROWS; r++) {
+		common = randu();
+		for (j = 0, wy[r] = 0; j < WFEAT; j++) {
+			GET(wx, j, r) = (1 + j % 7) * (randu() + 0.5 * common);
+			wy[r] += GET(wx, j, r) * ((j % 5) - 2) / (1 + j % 7);
+		}
+		wy[r] += 0.1 * randu();
+		memcpy(&GET(wz, 0, r), &GET(wx, 0, r), sizeof(double) * WFEAT);
+		GET(wz, WFEAT, r) = wy[r];
+	}
+	matsyrk(wgram, wz);
+	trainridge(wgram, WROWS, 0.01, want);
+
+	static const char *inames[] = { "conjugate gradient", "LSQR" };
+	for (method = ITER_CG; method <= ITER_LSQR; method++) {
+		printf("Testing %s ridge regression... ", inames[method]);
+		iterdefaults(&iopt, method);
+		iopt.lambda = 0.01;
+		memset(got, 0, sizeof(got));
+		cold = trainiter(wx, wy, got, &iopt);
+		if      (cold < 0)                          { FAIL("trainiter"); }
+		else if (maxdiff(got, want, WFEAT) > 1e-7)  { FAIL("coefficients"); }
+		else                                        { PASS(); }
+
+		/* A little new noise, the last solution is close to the new one */
+		printf("Testing %s warm start... ", inames[method]);
+		for (r = 0; r < WROWS; r++) GET(wz, WFEAT, r) = wy[r] += 0.001 * randu();
+		memset(wgram->vals, 0, sizeof(double) * (WFEAT + 1) * (WFEAT + 1));
+		matsyrk(wgram, wz);
+		trainridge(wgram, WROWS, 0.01, want);
+		warm = trainiter(wx, wy, got, &iopt);
+		if      (warm < 0)                          { FAIL("trainiter"); }
+		else if (maxdiff(got, want, WFEAT) > 1e-7)  { FAIL("coefficients"); }
+		else if (warm >= cold)                      { FAIL("no fewer iterations than a cold start"); }
+		else                                        { PASS(); }
+	}
+
+	printf("Testing an iterative solver out of iterations... ");
+	iterdefaults(&iopt, ITER_CG);
+	iopt.maxiter = 2;
+	memset(got, 0, sizeof(got));
+	if (trainiter(wx, wy, got, &iopt) >= 0) { FAIL("no error"); }
+	else                                    { PASS(); }
+
+	freemat(wx);
+	freemat(wz);
+	freemat(wgram);
+	free(wy);
+
+	/*** Missing files ***/
+	printf("Testing missing data store file... ");
+	unlink(STREAM_FILE);
+	if (trainstream(STREAM_FILE, coef, 0) >= 0) { FAIL("no error"); }
+	else                                        { PASS(); }
+
+	/*** Restarting the pool ***/
+	printf("Testing a restarted pool only runs new work... ");
+	int before[4] = { 0 }, after[4] = { 0 }, runs = 0;
+	tprun(countruns, before);
+	tpfree();
+	tpinit(3);
+	usleep(10000);
+	tprun(countruns, after);
+	for (i = 0; i < 4; i++) runs += (before[i] != 1) + (after[i] != (i < 3));
+	if (runs) { FAIL("a worker ran old or missed new work"); }
+	else      { PASS(); }
+	tpfree();
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
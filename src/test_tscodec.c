@@ -0,0 +1,200 @@
+/**
+ * @file    test_tscodec.c
+ * @brief   Tests the compressed time series files in tscodec.c
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "tscodec.h"
+#include "data.h"
+#include "matrix.h"
+#include "threadpool.h"
+#include "error.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*** Defines ***/
+
+#define TSC_FILE "./tests/tscodec/ticks.tsc"
+#define RAW_FILE "./tests/tscodec/ticks.mat"
+
+#define NROWS 20000
+#define BLOCK 1000
+
+#define FAIL(msg) nfail++; printf("%sFAIL%s %s\n", ASCII_RED, ASCII_RESET, msg)
+#define PASS() npass++; printf("%sPASS%s\n", ASCII_GREEN, ASCII_RESET)
+
+/*** Helper Functions ***/
+
+static double randu(void)
+{
+	return (double)rand() / RAND_MAX;
+}
+
+/* Ticks of [time in ms, price, size, spread]. Mostly 100ms apart with
+ * jitter and the odd long gap, the price walks in cents */
+static void randticks(Matrix *ticks)
+{
+	double t = 1760000000000.0, price = 250.00;
+	int i;
+
+	for (i = 0; i < ticks->nrows; i++) {
+		t += (i % 997 == 0) ? 3600000 * randu() : 100 + floor(5 * randu());
+		t = floor(t);
+		if (randu() < 0.3) price = round((price + (randu() < 0.5 ? -0.01 : 0.01)) * 100) / 100;
+		GET(ticks, 0, i) = t;
+		GET(ticks, 1, i) = price;
+		GET(ticks, 2, i) = floor(1 + 500 * randu());
+		GET(ticks, 3, i) = (randu() < 0.9) ? 0.01 : 0.02;
+	}
+}
+
+/* Bitwise so NaN and -0 have to come back exactly */
+static int sameblock(const Matrix *got, const Matrix *ticks, long r0)
+{
+	return !memcmp(got->vals, &GET(ticks, 0, r0), sizeof(double) * got->nrows * got->ncols);
+}
+
+static long filesize(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) ? -1 : st.st_size;
+}
+
+/* Overwrites len bytes of a file at offset, the old bytes go to old */
+static int patch(const char *path, long offset, const void *buf, void *old, size_t len)
+{
+	int fd = open(path, O_RDWR), err;
+	if (fd < 0) return -1;
+	err = pread(fd, old, len, offset) != (ssize_t)len
+		|| pwrite(fd, buf, len, offset) != (ssize_t)len;
+	close(fd);
+	return err ? -1 : 0;
+}
+
+/*** Testing ***/
+
+int main(void)
+{
+	int npass = 0;
+	int nfail = 0;
+	long r0, r1;
+	Matrix *got;
+	TscFile *tf = NULL;
+
+	Matrix *ticks = initmat(NROWS, 4, NULL, 1);
+
+	srand(41);
+	tpinit(4);
+	printf("\nTesting tscodec.c...\n");
+	randticks(ticks);
+	GET(ticks, 1, 17) = NAN;
+	GET(ticks, 1, 18) = -0.0;
+	GET(ticks, 2, 19) = HUGE_VAL;
+
+	/*** Round trip of the whole file ***/
+	printf("Testing a round trip of the whole file... ");
+	if (tscsave(TSC_FILE, ticks, BLOCK) || !(tf = tscopen(TSC_FILE))) { FAIL("could not save"); }
+	else if (!(got = tscload(tf, -HUGE_VAL, HUGE_VAL)))                { FAIL("could not load"); }
+	else {
+		if      (got->nrows != NROWS || got->ncols != 4)  { FAIL("wrong size"); }
+		else if (!sameblock(got, ticks, 0))               { FAIL("values differ"); }
+		else                                              { PASS(); }
+		freemat(got);
+	}
+
+	printf("Testing the compressed size... ");
+	savemat(RAW_FILE, ticks);
+	if (filesize(TSC_FILE) * 3 > filesize(RAW_FILE)) { FAIL("less than 3x smaller"); }
+	else                                             { PASS(); }
+	unlink(RAW_FILE);
+
+	/*** Ranges ***/
+	printf("Testing a range over several blocks... ");
+	r0 = 2345;
+	r1 = 7891;
+	if (!tf || !(got = tscload(tf, GET(ticks, 0, r0), GET(ticks, 0, r1)))) { FAIL("could not load"); }
+	else {
+		while (r0 > 0 && GET(ticks, 0, r0 - 1) == GET(ticks, 0, r0)) r0--;
+		while (GET(ticks, 0, r1 - 1) == GET(ticks, 0, r1)) r1--;
+		if      (got->nrows != r1 - r0)        { FAIL("wrong rows"); }
+		else if (!sameblock(got, ticks, r0))   { FAIL("values differ"); }
+		else                                   { PASS(); }
+		freemat(got);
+	}
+
+	printf("Testing a range inside the last block... ");
+	r0 = NROWS - 10;
+	if (!tf || !(got = tscload(tf, GET(ticks, 0, r0), HUGE_VAL))) { FAIL("could not load"); }
+	else {
+		if      (got->nrows != NROWS - r0)     { FAIL("wrong rows"); }
+		else if (!sameblock(got, ticks, r0))   { FAIL("values differ"); }
+		else                                   { PASS(); }
+		freemat(got);
+	}
+
+	printf("Testing a range past the end... ");
+	if (tf && tscload(tf, GET(ticks, 0, NROWS - 1) + 1, HUGE_VAL)) { FAIL("rows found"); }
+	else                                                            { PASS(); }
+	if (tf) tscclose(tf);
+
+	/*** Damaged files ***/
+	printf("Testing a damaged block index is rejected... ");
+	long at = sizeof(TscHeader) + sizeof(TscBlock) + offsetof(TscBlock, nbytes);
+	long eight = 8, old, tmp;
+	if (patch(TSC_FILE, at, &eight, &old, sizeof(long)))       { FAIL("could not patch"); }
+	else if ((tf = tscopen(TSC_FILE)))                         { FAIL("opened"); tscclose(tf); }
+	else if (patch(TSC_FILE, at, &old, &tmp, sizeof(long)))    { FAIL("could not restore"); }
+	else if (!(tf = tscopen(TSC_FILE)))                        { FAIL("restored file not opened"); }
+	else                                                       { PASS(); tscclose(tf); }
+
+	printf("Testing a damaged size table is rejected... ");
+	at = sizeof(TscHeader) + (NROWS / BLOCK) * sizeof(TscBlock);
+	uint32_t huge = 1U << 30, was;
+	if (patch(TSC_FILE, at, &huge, &was, sizeof(huge)) || !(tf = tscopen(TSC_FILE))) {
+		FAIL("could not patch");
+	} else {
+		if ((got = tscload(tf, -HUGE_VAL, HUGE_VAL))) { FAIL("loaded"); freemat(got); }
+		else                                          { PASS(); }
+		tscclose(tf);
+	}
+
+	printf("Testing a header too big for one matrix is rejected... ");
+	long nrows = (long)INT_MAX + 1;
+	if (patch(TSC_FILE, offsetof(TscHeader, nrows), &nrows, &old, sizeof(long))) {
+		FAIL("could not patch");
+	}
+	else if ((tf = tscopen(TSC_FILE))) { FAIL("opened"); tscclose(tf); }
+	else                               { PASS(); }
+
+	/*** Bad input ***/
+	printf("Testing timestamps out of order... ");
+	GET(ticks, 0, 500) = GET(ticks, 0, 0);
+	if (!tscsave(TSC_FILE, ticks, BLOCK)) { FAIL("no error"); }
+	else                                  { PASS(); }
+
+	printf("Testing a file that is not a time series... ");
+	savemat(RAW_FILE, ticks);
+	if ((tf = tscopen(RAW_FILE))) { FAIL("opened"); tscclose(tf); }
+	else                          { PASS(); }
+
+	unlink(TSC_FILE);
+	unlink(RAW_FILE);
+	freemat(ticks);
+	tpfree();
+
+	/*** total ***/
+	printf("%s%d/%d PASSED%s\n", ASCII_GREEN, npass, npass + nfail, ASCII_RESET);
+	return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file    threadpool.c
+ * @brief   Fork-join thread pool shared by the parallel kernels
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "threadpool.h"
+#include "error.h"
+#include "logging.h"
+
+/*** System Includes ***/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*** File Variables ***/
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  done = PTHREAD_COND_INITIALIZER;
+
+/* Only one tprun() can use the pool at a time */
+static pthread_mutex_t runlock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t *workers = NULL;
+static int nworkers = 0;     /* Threads in the pool including the caller */
+static long generation = 0;  /* Bumped for every new piece of work */
+static int pending = 0;      /* Workers still busy with the current work */
+static int stopping = 0;
+
+static TaskFunc task = NULL;
+static void *taskarg = NULL;
+
+/* Set while a thread is running a task so nested calls stay serial */
+static _Thread_local int intask = 0;
+
+/*** Helper Functions ***/
+
+static void *worker(void *arg)
+{
+	int id = (int)(long)arg;
+	long seen = 0;
+
+	intask = 1;
+	pthread_mutex_lock(&lock);
+	while (1) {
+		while (generation == seen && !stopping) pthread_cond_wait(&wake, &lock);
+		if (stopping) break;
+		seen = generation;
+		pthread_mutex_unlock(&lock);
+
+		task(taskarg, id, nworkers);
+
+		pthread_mutex_lock(&lock);
+		if (--pending == 0) pthread_cond_signal(&done);
+	}
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+/*** Public Functions ***/
+
+int tpinit(int nthreads)
+{
+	pthread_mutex_lock(&runlock);
+	if (nworkers) {
+		pthread_mutex_unlock(&runlock);
+		return nworkers;
+	}
+
+	if (nthreads <= 0) nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0) nthreads = 1;
+	LOG_INFO("Starting thread pool with %d threads...\n", nthreads);
+
+	if (nthreads > 1 && !(workers = malloc(sizeof(pthread_t) * (nthreads - 1))))
+		DIE("malloc");
+
+	long i;
+	stopping = 0;
+	nworkers = nthreads;
+	for (i = 1; i < nthreads; i++)
+		if (pthread_create(&workers[i - 1], NULL, worker, (void *)i))
+			DIE("pthread_create");
+
+	pthread_mutex_unlock(&runlock);
+	return nthreads;
+}
+
+void tpfree(void)
+{
+	int i;
+
+	pthread_mutex_lock(&runlock);
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	pthread_cond_broadcast(&wake);
+	pthread_mutex_unlock(&lock);
+
+	for (i = 0; i < nworkers - 1; i++) pthread_join(workers[i], NULL);
+	free(workers);
+	workers = NULL;
+	nworkers = 0;
+
+	/* Workers of a new pool start from generation 0, they must not see the
+	 * last work of this one as new */
+	generation = 0;
+	pthread_mutex_unlock(&runlock);
+}
+
+int tpthreads(void)
+{
+	if (intask) return 1;
+	if (!nworkers) tpinit(0);
+	return nworkers;
+}
+
+void tprun(TaskFunc fn, void *arg)
+{
+	if (intask) {
+		fn(arg, 0, 1);
+		return;
+	}
+	if (!nworkers) tpinit(0);
+
+	pthread_mutex_lock(&runlock);
+	if (nworkers == 1) {
+		intask = 1;
+		fn(arg, 0, 1);
+		intask = 0;
+		pthread_mutex_unlock(&runlock);
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	task = fn;
+	taskarg = arg;
+	pending = nworkers - 1;
+	generation++;
+	pthread_cond_broadcast(&wake);
+	pthread_mutex_unlock(&lock);
+
+	/* The calling thread does its share instead of waiting idle */
+	intask = 1;
+	fn(arg, 0, nworkers);
+	intask = 0;
+
+	pthread_mutex_lock(&lock);
+	while (pending > 0) pthread_cond_wait(&done, &lock);
+	pthread_mutex_unlock(&lock);
+	pthread_mutex_unlock(&runlock);
+}
+
+void tprange(long n, int id, int nthreads, long *start, long *end)
+{
+	long base = n / nthreads;
+	long rem = n % nthreads;
+
+	*start = id * base + ((id < rem) ? id : rem);
+	*end = *start + base + ((id < rem) ? 1 : 0);
+}
@@ -0,0 +1,1007 @@
+/**
+ * @file    train.c
+ * @brief   Functions to train linear regression models
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "train.h"
+#include "data.h"
+#include "error.h"
+#include "latency.h"
+#include "logging.h"
+#include "threadpool.h"
+
+/*** System Includes ***/
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** Defines ***/
+
+/* Below this many multiply-adds a batch gradient is not worth splitting */
+#define GD_PARALLEL_WORK (1 << 15)
+
+/* Smallest alpha used to find where a path starts, a pure ridge penalty
+ * never sets coefficients to zero so it has no natural largest lambda */
+#define PATH_MIN_ALPHA 1e-3
+
+/*** Type Definitions ***/
+
+/* Two chunks of rows, one reader thread for the whole file fills one
+ * while the other is being added */
+typedef struct {
+	const DataFile *df;
+	double *bufs[2];
+	long got[2];      /* Rows in each buffer, 0 at the end of the file, -1 on error */
+	int full[2];
+	long chunkrows;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} ReadAhead;
+
+/* One mini-batch gradient, split over the threads */
+typedef struct {
+	const Matrix *x;
+	const double *y;
+	const double *coef;
+	const long *idx;   /* Shuffled row order, the batch is idx[start..start+count) */
+	long start;
+	long count;
+	double *grads;     /* One gradient of ncols per thread */
+	double *losses;    /* One sum of squared residuals per thread */
+} GradArgs;
+
+/* Coordinate descent over a cached Gram matrix G = X^TX */
+typedef struct {
+	const Matrix *gram;
+	int p;
+	double *b;        /* Coefficients */
+	double *q;        /* Gradient X^Ty - Gb, updated as b changes */
+	char *eligible;   /* Coefficients swept for the current lambda */
+	double nl1;       /* n lambda alpha */
+	double nl2;       /* n lambda (1 - alpha) */
+	double thresh;    /* Converged once no update changes the loss more */
+} CDState;
+
+/* Cross validation folds, solved in parallel */
+typedef struct {
+	const Matrix *z;
+	int nfolds;
+	const double *lambdas;
+	int nlambda;
+	Matrix **grams;     /* Gram block of every fold */
+	const Matrix *total;
+	double *sse;        /* Held out squared error, nfolds x nlambda */
+	int err;            /* Set by any thread whose fit fails */
+} CVArgs;
+
+/* Products with X for the iterative solvers, split over the rows */
+typedef struct {
+	const Matrix *x;
+	const double *in;  /* p long for Xv and X^TXv, n long for X^Tu */
+	const double *y;   /* Set to also find X^Ty and the diagonal with X^TXv */
+	double *out;       /* n long for Xv, one of p per thread otherwise */
+	double *xty;       /* One of p per thread */
+	double *diag;      /* Sums of squares of the columns, one of p per thread */
+} IterArgs;
+
+/*** Helper Functions ***/
+
+/* Fills the buffers in turn until the file ends, each one only once the
+ * chunk in it has been added */
+static void *readahead(void *arg)
+{
+	ReadAhead *ra = arg;
+	long row = 0, got;
+	int k = 0;
+
+	do {
+		pthread_mutex_lock(&ra->lock);
+		while (ra->full[k]) pthread_cond_wait(&ra->cond, &ra->lock);
+		pthread_mutex_unlock(&ra->lock);
+
+		got = readrows(ra->df, ra->bufs[k], row, ra->chunkrows);
+		row += got;
+
+		pthread_mutex_lock(&ra->lock);
+		ra->got[k] = got;
+		ra->full[k] = 1;
+		pthread_cond_signal(&ra->cond);
+		pthread_mutex_unlock(&ra->lock);
+		k ^= 1;
+	} while (got > 0);
+	return NULL;
+}
+
+/* The Gram matrix of an open data store file, gram has to be ncols x ncols */
+static long gramfile(const DataFile *df, Matrix *gram, long chunkrows)
+{
+	if (chunkrows <= 0) chunkrows = STREAM_CHUNK_ROWS;
+
+	ReadAhead ra = { .df = df, .chunkrows = chunkrows };
+	Matrix chunk = { 0, df->ncols, NULL, 0 };
+	size_t bsize = chunkrows * df->ncols * sizeof(double);
+	pthread_t reader;
+	long total = 0, got;
+	int k = 0;
+
+	if (!(ra.bufs[0] = malloc(bsize))) DIE("malloc");
+	if (!(ra.bufs[1] = malloc(bsize))) DIE("malloc");
+	pthread_mutex_init(&ra.lock, NULL);
+	pthread_cond_init(&ra.cond, NULL);
+	memset(gram->vals, 0, sizeof(double) * gram->nrows * gram->ncols);
+
+	if (pthread_create(&reader, NULL, readahead, &ra)) {
+		LOG_WARN("Could not start the reader thread, reading and adding in turn\n");
+		while ((got = readrows(df, ra.bufs[0], total, chunkrows)) > 0) {
+			chunk.nrows = got;
+			chunk.vals = ra.bufs[0];
+			matsyrk(gram, &chunk);
+			total += got;
+		}
+	} else {
+		for (;;) {
+			pthread_mutex_lock(&ra.lock);
+			while (!ra.full[k]) pthread_cond_wait(&ra.cond, &ra.lock);
+			got = ra.got[k];
+			pthread_mutex_unlock(&ra.lock);
+			if (got <= 0) break;
+
+			/* The reader is filling the other buffer meanwhile */
+			chunk.nrows = got;
+			chunk.vals = ra.bufs[k];
+			matsyrk(gram, &chunk);
+			total += got;
+			LOG_DEBUG("Added rows up to %ld\n", total);
+
+			pthread_mutex_lock(&ra.lock);
+			ra.full[k] = 0;
+			pthread_cond_signal(&ra.cond);
+			pthread_mutex_unlock(&ra.lock);
+			k ^= 1;
+		}
+		pthread_join(reader, NULL);
+	}
+
+	pthread_mutex_destroy(&ra.lock);
+	pthread_cond_destroy(&ra.cond);
+	free(ra.bufs[0]);
+	free(ra.bufs[1]);
+	if (got < 0) return -1;
+
+	LOG_INFO("Finished Gram matrix of %ld rows\n", total);
+	return total;
+}
+
+/* splitmix64, small and good enough to shuffle with */
+static inline unsigned long nextrand(unsigned long *state)
+{
+	unsigned long z = (*state += 0x9e3779b97f4a7c15UL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+	return z ^ (z >> 31);
+}
+
+/* Bit level check, isfinite() is optimized away by -Ofast */
+static inline int notfinite(double d)
+{
+	unsigned long bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return ((bits >> 52) & 0x7ff) == 0x7ff;
+}
+
+static void shuffle(long *idx, long n, unsigned long *state)
+{
+	long i, j, temp;
+	for (i = n - 1; i > 0; i--) {
+		j = nextrand(state) % (i + 1);
+		temp = idx[i]; idx[i] = idx[j]; idx[j] = temp;
+	}
+}
+
+/* Adds x_i (x_i . b - y_i) of this thread's rows of the batch to its own
+ * gradient, the residual of a row is used as soon as it is known */
+static void gradpart(void *arg, int id, int nthreads)
+{
+	GradArgs *a = arg;
+	int j, p = a->x->ncols;
+	long k, start, end;
+	double r, loss = 0;
+	const double *row;
+	const double * restrict coef = a->coef;
+	double * restrict g = &a->grads[id * p];
+
+	memset(g, 0, sizeof(double) * p);
+	tprange(a->count, id, nthreads, &start, &end);
+	for (k = a->start + start; k < a->start + end; k++) {
+		row = &a->x->vals[a->idx[k] * p];
+		r = -a->y[a->idx[k]];
+		for (j = 0; j < p; j++) r += row[j] * coef[j];
+		for (j = 0; j < p; j++) g[j] += r * row[j];
+		loss += r * r;
+	}
+	a->losses[id] = loss;
+}
+
+static inline double softthresh(double z, double t)
+{
+	if (z > t)  return z - t;
+	if (z < -t) return z + t;
+	return 0;
+}
+
+/* One pass over the eligible coefficients, only the non-zero ones if
+ * activeonly is set. Returns the biggest change in the loss */
+static double cdsweep(CDState *cd, int activeonly)
+{
+	const Matrix *gram = cd->gram;
+	const double *row;
+	double gjj, nb, d, change, worst = 0;
+	int j, k, p = cd->p;
+
+	for (j = 0; j < p; j++) {
+		if (!cd->eligible[j] || (activeonly && cd->b[j] == 0)) continue;
+		row = &GET(gram, 0, j);
+		if ((gjj = row[j]) <= 0) continue;
+
+		nb = softthresh(cd->q[j] + gjj * cd->b[j], cd->nl1) / (gjj + cd->nl2);
+		if ((d = nb - cd->b[j]) == 0) continue;
+
+		/* Covariance update, only touches the gradient when b_j moved */
+		cd->b[j] = nb;
+		for (k = 0; k < p; k++) cd->q[k] -= row[k] * d;
+		if ((change = gjj * d * d) > worst) worst = change;
+	}
+
+	return worst;
+}
+
+/* Coordinate descent for one lambda, returns the amount of sweeps */
+static int cdsolve(CDState *cd, int maxiter)
+{
+	int j, iter = 0, violated = 1;
+
+	while (violated && iter < maxiter) {
+
+		/* Sweep everything eligible, then just the active set until it settles */
+		while (iter < maxiter) {
+			iter++;
+			if (cdsweep(cd, 0) < cd->thresh) break;
+			while (iter < maxiter) {
+				iter++;
+				if (cdsweep(cd, 1) < cd->thresh) break;
+			}
+		}
+
+		/* Coefficients the strong rule left out must satisfy the KKT conditions */
+		violated = 0;
+		for (j = 0; j < cd->p; j++) {
+			if (cd->eligible[j] || fabs(cd->q[j]) <= cd->nl1) continue;
+			cd->eligible[j] = 1;
+			violated = 1;
+		}
+	}
+
+	return iter;
+}
+
+/* Rows of fold f */
+static inline void foldrange(const CVArgs *a, int f, long *start, long *end)
+{
+	tprange(a->z->nrows, f, a->nfolds, start, end);
+}
+
+static void cvblocks(void *arg, int id, int nthreads)
+{
+	CVArgs *a = arg;
+	Matrix view = { 0, a->z->ncols, NULL, 0 };
+	long start, end;
+	int f;
+
+	for (f = id; f < a->nfolds; f += nthreads) {
+		foldrange(a, f, &start, &end);
+		view.nrows = end - start;
+		view.vals = &a->z->vals[start * a->z->ncols];
+		memset(a->grams[f]->vals, 0, sizeof(double) * a->z->ncols * a->z->ncols);
+		matsyrk(a->grams[f], &view);
+	}
+}
+
+/* The ridge solve of trainridge(), without recording a latency so the
+ * fits and folds built on it only record their whole run */
+static int ridgesolve(const Matrix *gram, long nrows, double lambda, double *coef)
+{
+	int p = gram->nrows - 1;
+	int i, err;
+	double *xty = malloc(sizeof(double) * p);
+	Matrix *xtx = initmat(p, p, NULL, 1);
+	if (!xty) DIE("malloc");
+
+	/* Shift the diagonal of X^TX, which also makes it positive definite */
+	for (i = 0; i < p; i++) {
+		memcpy(&GET(xtx, 0, i), &GET(gram, 0, i), sizeof(double) * p);
+		GET(xtx, i, i) += nrows * lambda;
+		xty[i] = GET(gram, p, i);
+	}
+	err = solchol(xtx, NULL, coef, xty);
+
+	freemat(xtx);
+	free(xty);
+	return err;
+}
+
+/* ||y - Xb||^2 = y^Ty - 2b^TX^Ty + b^TX^TXb, straight from a Gram block */
+static double gramsse(const Matrix *gram, const double *b)
+{
+	int i, j, p = gram->nrows - 1;
+	double sse = GET(gram, p, p), xb;
+
+	for (i = 0; i < p; i++) {
+		for (xb = 0, j = 0; j < p; j++) xb += GET(gram, j, i) * b[j];
+		sse += b[i] * (xb - 2 * GET(gram, p, i));
+	}
+	return sse;
+}
+
+static void cvfolds(void *arg, int id, int nthreads)
+{
+	CVArgs *a = arg;
+	int n = a->z->ncols;
+	Matrix *train = initmat(n, n, NULL, 1);
+	double *b = malloc(sizeof(double) * (n - 1));
+	long start, end, i;
+	int f, l;
+	if (!b) DIE("malloc");
+
+	for (f = id; f < a->nfolds; f += nthreads) {
+		foldrange(a, f, &start, &end);
+
+		/* The training rows are everything except this fold */
+		for (i = 0; i < (long)n * n; i++)
+			train->vals[i] = a->total->vals[i] - a->grams[f]->vals[i];
+
+		for (l = 0; l < a->nlambda; l++) {
+			if (ridgesolve(train, a->z->nrows - (end - start), a->lambdas[l], b)) {
+				__atomic_store_n(&a->err, -1, __ATOMIC_RELAXED);
+				break;
+			}
+			a->sse[f * a->nlambda + l] = gramsse(a->grams[f], b);
+		}
+	}
+
+	freemat(train);
+	free(b);
+}
+
+/* Threads worth using for one pass over x */
+static inline int iterthreads(const Matrix *x)
+{
+	return ((long)x->nrows * x->ncols >= GD_PARALLEL_WORK) ? tpthreads() : 1;
+}
+
+static inline void iterrun(TaskFunc fn, IterArgs *a, int nthreads)
+{
+	if (nthreads > 1) tprun(fn, a);
+	else              fn(a, 0, 1);
+}
+
+/* Adds the nthreads vectors of p in parts into the first one */
+static void sumparts(double *parts, int p, int nthreads)
+{
+	int j;
+	for (; nthreads > 1; nthreads--)
+		for (j = 0; j < p; j++) parts[j] += parts[(nthreads - 1) * p + j];
+}
+
+/* X^TXv in one pass, each row adds x_i (x_i . v) while it is in cache */
+static void normalpart(void *arg, int id, int nthreads)
+{
+	IterArgs *a = arg;
+	int j, p = a->x->ncols;
+	long i, start, end;
+	double t, yi;
+	const double *row;
+	double * restrict out = &a->out[id * p];
+	double * restrict xty = a->y ? &a->xty[id * p] : NULL;
+	double * restrict diag = a->y ? &a->diag[id * p] : NULL;
+
+	memset(out, 0, sizeof(double) * p);
+	if (a->y) {
+		memset(xty, 0, sizeof(double) * p);
+		memset(diag, 0, sizeof(double) * p);
+	}
+	tprange(a->x->nrows, id, nthreads, &start, &end);
+	for (i = start; i < end; i++) {
+		row = &a->x->vals[i * p];
+		t = matdot(row, a->in, p);
+		for (j = 0; j < p; j++) out[j] += t * row[j];
+		if (!a->y) continue;
+		yi = a->y[i];
+		for (j = 0; j < p; j++) {
+			xty[j] += yi * row[j];
+			diag[j] += row[j] * row[j];
+		}
+	}
+}
+
+/* Xv, every thread owns its rows of the result */
+static void rowspart(void *arg, int id, int nthreads)
+{
+	IterArgs *a = arg;
+	int p = a->x->ncols;
+	long i, start, end;
+
+	tprange(a->x->nrows, id, nthreads, &start, &end);
+	for (i = start; i < end; i++) a->out[i] = matdot(&a->x->vals[i * p], a->in, p);
+}
+
+/* X^Tu, and the sums of squares of the columns if diag is set */
+static void colspart(void *arg, int id, int nthreads)
+{
+	IterArgs *a = arg;
+	int j, p = a->x->ncols;
+	long i, start, end;
+	double ui;
+	const double *row;
+	double * restrict out = &a->out[id * p];
+	double * restrict diag = a->diag ? &a->diag[id * p] : NULL;
+
+	memset(out, 0, sizeof(double) * p);
+	if (diag) memset(diag, 0, sizeof(double) * p);
+	tprange(a->x->nrows, id, nthreads, &start, &end);
+	for (i = start; i < end; i++) {
+		row = &a->x->vals[i * p];
+		ui = a->in[i];
+		for (j = 0; j < p; j++) out[j] += ui * row[j];
+		if (diag)
+			for (j = 0; j < p; j++) diag[j] += row[j] * row[j];
+	}
+}
+
+/* Preconditioned conjugate gradients on (X^TX + n lambda I) b = X^Ty */
+static int itercg(const Matrix *x, const double *y, double *coef, const IterOptions *opt)
+{
+	int p = x->ncols, nthreads = iterthreads(x);
+	int j, iter;
+	double nl = x->nrows * opt->lambda;
+	double alpha, rz, rznew, bnorm, rnorm;
+	double *parts = malloc(sizeof(double) * p * nthreads * 3);
+	double *r = malloc(sizeof(double) * p);
+	double *z = malloc(sizeof(double) * p);
+	double *d = malloc(sizeof(double) * p);
+	double *minv = malloc(sizeof(double) * p);
+	if (!parts || !r || !z || !d || !minv) DIE("malloc");
+
+	/* The first pass also finds X^Ty and the diagonal of X^TX */
+	IterArgs args = { x, coef, y, parts, &parts[p * nthreads], &parts[2 * p * nthreads] };
+	iterrun(normalpart, &args, nthreads);
+	sumparts(args.out, p, nthreads);
+	sumparts(args.xty, p, nthreads);
+	sumparts(args.diag, p, nthreads);
+
+	bnorm = 0;
+	for (j = 0; j < p; j++) {
+		r[j] = args.xty[j] - args.out[j] - nl * coef[j];
+		bnorm += args.xty[j] * args.xty[j];
+		minv[j] = (opt->precond && args.diag[j] + nl > 0) ? 1 / (args.diag[j] + nl) : 1;
+		d[j] = z[j] = minv[j] * r[j];
+	}
+	bnorm = sqrt(bnorm);
+	rz = matdot(r, z, p);
+	rnorm = sqrt(matdot(r, r, p));
+
+	args.in = d;
+	args.y = NULL;
+	for (iter = 0; rnorm > opt->tol * bnorm; iter++) {
+		if (iter >= opt->maxiter) {
+			iter = -1;
+			break;
+		}
+
+		/* q = (X^TX + n lambda I) d, kept in parts */
+		iterrun(normalpart, &args, nthreads);
+		sumparts(parts, p, nthreads);
+		for (j = 0; j < p; j++) parts[j] += nl * d[j];
+
+		alpha = rz / matdot(d, parts, p);
+		for (j = 0; j < p; j++) {
+			coef[j] += alpha * d[j];
+			r[j] -= alpha * parts[j];
+			z[j] = minv[j] * r[j];
+		}
+		rznew = matdot(r, z, p);
+		for (j = 0; j < p; j++) d[j] = z[j] + rznew / rz * d[j];
+		rz = rznew;
+		rnorm = sqrt(matdot(r, r, p));
+		LOG_DEBUG("CG iteration %d residual %.6g\n", iter, rnorm);
+	}
+
+	free(parts);
+	free(r);
+	free(z);
+	free(d);
+	free(minv);
+	return iter;
+}
+
+/* LSQR on min ||[y; 0] - [XD; sqrt(n lambda) D] z||, b = D z. The damping
+ * rows make it the ridge problem exactly, D scales the columns to unit
+ * norm when preconditioning. Starts from the residual of coef so it only
+ * solves for the correction */
+static int iterlsqr(const Matrix *x, const double *y, double *coef, const IterOptions *opt)
+{
+	int p = x->ncols, nthreads = iterthreads(x);
+	long i, n = x->nrows;
+	int j, iter;
+	double damp = sqrt(n * opt->lambda);
+	double alpha, beta, rho, rhobar, phi, phibar, c = 1, s, theta, anorm2, ynorm;
+	double *parts = malloc(sizeof(double) * p * nthreads * 2);
+	double *u = malloc(sizeof(double) * (n + p));  /* [Xv part; damping part] */
+	double *v = malloc(sizeof(double) * p);
+	double *w = malloc(sizeof(double) * p);
+	double *z = calloc(p, sizeof(double));
+	double *xv = malloc(sizeof(double) * n);
+	double *dv = malloc(sizeof(double) * p);
+	double *scale = malloc(sizeof(double) * p);
+	if (!parts || !u || !v || !w || !z || !xv || !dv || !scale) DIE("malloc");
+	double *ub = &u[n];
+
+	IterArgs args = { x, coef, NULL, u, NULL, NULL };
+
+	/* beta u = [y - Xb; -sqrt(n lambda) b] */
+	iterrun(rowspart, &args, nthreads);
+	for (beta = ynorm = 0, i = 0; i < n; i++) {
+		u[i] = y[i] - u[i];
+		beta += u[i] * u[i];
+		ynorm += y[i] * y[i];
+	}
+	for (j = 0; j < p; j++) {
+		ub[j] = -damp * coef[j];
+		beta += ub[j] * ub[j];
+	}
+	beta = sqrt(beta);
+	ynorm = sqrt(ynorm);
+	if (beta > 0)
+		for (i = 0; i < n + p; i++) u[i] /= beta;
+
+	/* alpha v = A^Tu, the same pass finds the column norms for D */
+	args.in = u;
+	args.out = parts;
+	args.diag = &parts[p * nthreads];
+	iterrun(colspart, &args, nthreads);
+	sumparts(args.out, p, nthreads);
+	sumparts(args.diag, p, nthreads);
+	for (alpha = 0, j = 0; j < p; j++) {
+		scale[j] = (opt->precond && args.diag[j] + damp * damp > 0)
+			? 1 / sqrt(args.diag[j] + damp * damp) : 1;
+		v[j] = scale[j] * (parts[j] + damp * ub[j]);
+		alpha += v[j] * v[j];
+	}
+	alpha = sqrt(alpha);
+	if (alpha > 0)
+		for (j = 0; j < p; j++) v[j] /= alpha;
+	memcpy(w, v, sizeof(double) * p);
+	args.diag = NULL;
+
+	anorm2 = alpha * alpha;
+	phibar = beta;
+	rhobar = alpha;
+	for (iter = 0; alpha * beta > 0; iter++) {
+
+		/* Converged once ||A^Tr|| <= tol ||A|| ||r||, or r is nearly 0 */
+		if (alpha * fabs(c) <= opt->tol * sqrt(anorm2) || phibar <= opt->tol * ynorm) break;
+		if (iter >= opt->maxiter) {
+			iter = -1;
+			break;
+		}
+
+		/* Golub-Kahan bidiagonalization, beta u = A v - alpha u */
+		for (j = 0; j < p; j++) dv[j] = scale[j] * v[j];
+		args.in = dv;
+		args.out = xv;
+		iterrun(rowspart, &args, nthreads);
+		for (beta = 0, i = 0; i < n; i++) {
+			u[i] = xv[i] - alpha * u[i];
+			beta += u[i] * u[i];
+		}
+		for (j = 0; j < p; j++) {
+			ub[j] = damp * dv[j] - alpha * ub[j];
+			beta += ub[j] * ub[j];
+		}
+		beta = sqrt(beta);
+		if (beta > 0)
+			for (i = 0; i < n + p; i++) u[i] /= beta;
+		anorm2 += alpha * alpha + beta * beta;
+
+		/* alpha v = A^Tu - beta v */
+		args.in = u;
+		args.out = parts;
+		iterrun(colspart, &args, nthreads);
+		sumparts(parts, p, nthreads);
+		for (alpha = 0, j = 0; j < p; j++) {
+			v[j] = scale[j] * (parts[j] + damp * ub[j]) - beta * v[j];
+			alpha += v[j] * v[j];
+		}
+		alpha = sqrt(alpha);
+		if (alpha > 0)
+			for (j = 0; j < p; j++) v[j] /= alpha;
+
+		/* Plane rotation that eliminates beta, then update z and w */
+		rho = hypot(rhobar, beta);
+		c = rhobar / rho;
+		s = beta / rho;
+		theta = s * alpha;
+		rhobar = -c * alpha;
+		phi = c * phibar;
+		phibar *= s;
+		for (j = 0; j < p; j++) {
+			z[j] += phi / rho * w[j];
+			w[j] = v[j] - theta / rho * w[j];
+		}
+		LOG_DEBUG("LSQR iteration %d residual %.6g\n", iter, phibar);
+	}
+
+	for (j = 0; j < p; j++) coef[j] += scale[j] * z[j];
+
+	free(parts);
+	free(u);
+	free(v);
+	free(w);
+	free(z);
+	free(xv);
+	free(dv);
+	free(scale);
+	return iter;
+}
+
+/*** Public Functions ***/
+
+long gramstream(const char *path, Matrix *gram, long chunkrows)
+{
+	LOG_INFO("Building Gram matrix from %s...\n", path);
+
+	DataFile *df = opendata(path);
+	long total;
+	if (!df) return -1;
+	if (gram->nrows != df->ncols || gram->ncols != df->ncols) {
+		LOG_ERROR("Gram matrix is %dx%d but the file has %ld columns\n",
+				  gram->nrows, gram->ncols, df->ncols);
+		closedata(df);
+		return -1;
+	}
+
+	total = gramfile(df, gram, chunkrows);
+	closedata(df);
+	return total;
+}
+
+int gramsolve(const Matrix *gram, double *coef)
+{
+	assert(gram->nrows == gram->ncols && gram->nrows > 1);
+
+	int p = gram->nrows - 1;
+	int i, err;
+	double *xty = malloc(sizeof(double) * p);
+	Matrix *xtx = initmat(p, p, NULL, 1);
+	if (!xty) DIE("malloc");
+
+	/* Z^TZ = [X^TX X^Ty; y^TX y^Ty] */
+	for (i = 0; i < p; i++) {
+		memcpy(&GET(xtx, 0, i), &GET(gram, 0, i), sizeof(double) * p);
+		xty[i] = GET(gram, p, i);
+	}
+	err = solinv(xtx, NULL, coef, xty);
+
+	freemat(xtx);
+	free(xty);
+	return err;
+}
+
+int trainstream(const char *path, double *coef, long chunkrows)
+{
+	LOG_INFO("Training linear model from %s...\n", path);
+	LATENCY_START(start);
+
+	DataFile *df = opendata(path);
+	if (!df) return -1;
+
+	Matrix *gram = initmat(df->ncols, df->ncols, NULL, 1);
+	int err = (gramfile(df, gram, chunkrows) <= 0) ? -1 : gramsolve(gram, coef);
+	freemat(gram);
+	closedata(df);
+
+	if (err) LOG_WARN("Could not train a linear model from %s\n", path);
+	else     LATENCY_STOP(LAT_TRAIN, start);
+	return err;
+}
+
+void gddefaults(GDOptions *opt, int method)
+{
+	opt->method = method;
+	opt->rate = (method == GD_ADAM) ? 0.001 : 0.01;
+	opt->beta1 = 0.9;
+	opt->beta2 = 0.999;
+	opt->eps = 1e-8;
+	opt->batch = 32;
+	opt->epochs = 100;
+	opt->seed = 0;
+}
+
+int traingd(const Matrix *x, const double *y, double *coef, const GDOptions *opt)
+{
+	GDOptions defaults;
+	if (!opt) {
+		gddefaults(&defaults, GD_ADAM);
+		opt = &defaults;
+	}
+	LOG_INFO("Training linear model on %dx%d with gradient descent method %d...\n",
+			 x->nrows, x->ncols, opt->method);
+	LATENCY_START(start);
+
+	int p = x->ncols;
+	long n = x->nrows;
+	long batch = (opt->batch <= 0 || opt->batch > n) ? n : opt->batch;
+	int nthreads = tpthreads();
+	int epoch, j, t, err = EXIT_SUCCESS;
+	long b, i;
+	unsigned long state = opt->seed;
+	double loss, gj, bias1 = 1, bias2 = 1;
+
+	/* Everything is allocated once up front, the steps never allocate */
+	long *idx = malloc(sizeof(long) * n);
+	double *grads = malloc(sizeof(double) * p * nthreads);
+	double *losses = malloc(sizeof(double) * nthreads);
+	double *m = calloc(p, sizeof(double));
+	double *v = calloc(p, sizeof(double));
+	if (!idx || !grads || !losses || !m || !v) DIE("malloc");
+	for (i = 0; i < n; i++) idx[i] = i;
+
+	GradArgs args = { x, y, coef, idx, 0, 0, grads, losses };
+	for (epoch = 0; epoch < opt->epochs && !err; epoch++) {
+		shuffle(idx, n, &state);
+		loss = 0;
+
+		for (b = 0; b < n; b += batch) {
+			args.start = b;
+			args.count = (b + batch < n) ? batch : n - b;
+
+			/* Fused gradient of the batch, then add the threads together */
+			t = (args.count * p >= GD_PARALLEL_WORK) ? nthreads : 1;
+			if (t > 1) tprun(gradpart, &args);
+			else       gradpart(&args, 0, 1);
+			for (; t > 1; t--) {
+				for (j = 0; j < p; j++) grads[j] += grads[(t - 1) * p + j];
+				losses[0] += losses[t - 1];
+			}
+			loss += losses[0];
+
+			/* Update the coefficients with the mean gradient */
+			bias1 *= opt->beta1;
+			bias2 *= opt->beta2;
+			for (j = 0; j < p; j++) {
+				gj = grads[j] / args.count;
+				switch (opt->method) {
+				case GD_MOMENTUM:
+					m[j] = opt->beta1 * m[j] + gj;
+					coef[j] -= opt->rate * m[j];
+					break;
+				case GD_ADAM:
+					m[j] = opt->beta1 * m[j] + (1 - opt->beta1) * gj;
+					v[j] = opt->beta2 * v[j] + (1 - opt->beta2) * gj * gj;
+					coef[j] -= opt->rate * (m[j] / (1 - bias1))
+							   / (sqrt(v[j] / (1 - bias2)) + opt->eps);
+					break;
+				default:
+					coef[j] -= opt->rate * gj;
+				}
+			}
+		}
+
+		LOG_DEBUG("Epoch %d mean squared error %.6g\n", epoch, loss / n);
+		if (notfinite(loss)) {
+			LOG_WARN("Gradient descent diverged in epoch %d\n", epoch);
+			err = -1;
+		}
+	}
+
+	free(idx);
+	free(grads);
+	free(losses);
+	free(m);
+	free(v);
+
+	if (!err) {
+		LATENCY_STOP(LAT_TRAIN, start);
+		LOG_INFO("Finished gradient descent\n");
+	}
+	return err;
+}
+
+void pathdefaults(PathOptions *opt, double alpha)
+{
+	opt->alpha = alpha;
+	opt->nlambda = 100;
+	opt->ratio = 1e-4;
+	opt->tol = 1e-10;
+	opt->maxiter = 100000;
+}
+
+int trainridge(const Matrix *gram, long nrows, double lambda, double *coef)
+{
+	LOG_INFO("Fitting ridge regression with lambda %.6g...\n", lambda);
+	assert(gram->nrows == gram->ncols && gram->nrows > 1);
+	LATENCY_START(start);
+
+	int err = ridgesolve(gram, nrows, lambda, coef);
+	if (!err) LATENCY_STOP(LAT_TRAIN, start);
+	return err;
+}
+
+int trainpath(const Matrix *gram, long nrows, const PathOptions *opt,
+			  double *lambdas, Matrix *coefs)
+{
+	PathOptions defaults;
+	if (!opt) {
+		pathdefaults(&defaults, 1);
+		opt = &defaults;
+	}
+	LOG_INFO("Fitting regularization path of %d lambdas with alpha %.3f...\n",
+			 opt->nlambda, opt->alpha);
+	assert(gram->nrows == gram->ncols && gram->nrows > 1);
+	assert(coefs->nrows == opt->nlambda && coefs->ncols == gram->nrows - 1);
+	LATENCY_START(start);
+
+	int p = gram->nrows - 1;
+	int k, j, iters;
+	double lmax = 0, prev, yty;
+	double alpha = (opt->alpha > PATH_MIN_ALPHA) ? opt->alpha : PATH_MIN_ALPHA;
+
+	/* Smallest lambda where every coefficient is still zero */
+	for (j = 0; j < p; j++)
+		if (fabs(GET(gram, p, j)) > lmax) lmax = fabs(GET(gram, p, j));
+	lmax /= nrows * alpha;
+	for (k = 0; k < opt->nlambda; k++)
+		lambdas[k] = lmax * pow(opt->ratio, (opt->nlambda > 1) ? (double)k / (opt->nlambda - 1) : 0);
+
+	/* A pure ridge penalty has a closed form at every lambda */
+	if (opt->alpha <= 0) {
+		for (k = 0; k < opt->nlambda; k++)
+			if (ridgesolve(gram, nrows, lambdas[k], &GET(coefs, 0, k))) return -1;
+		LATENCY_STOP(LAT_TRAIN, start);
+		return opt->nlambda;
+	}
+
+	CDState cd;
+	cd.gram = gram;
+	cd.p = p;
+	cd.b = calloc(p, sizeof(double));
+	cd.q = malloc(sizeof(double) * p);
+	cd.eligible = malloc(p);
+	if (!cd.b || !cd.q || !cd.eligible) DIE("malloc");
+	yty = GET(gram, p, p);
+	cd.thresh = opt->tol * ((yty > 0) ? yty : 1);
+
+	/* b starts at zero so the gradient is just X^Ty */
+	for (j = 0; j < p; j++) cd.q[j] = GET(gram, p, j);
+
+	prev = lambdas[0];
+	for (k = 0; k < opt->nlambda; k++) {
+		cd.nl1 = nrows * lambdas[k] * opt->alpha;
+		cd.nl2 = nrows * lambdas[k] * (1 - opt->alpha);
+
+		/* Strong rule: skip coefficients that will most likely stay zero */
+		for (j = 0; j < p; j++)
+			cd.eligible[j] = cd.b[j] != 0
+				|| fabs(cd.q[j]) >= nrows * opt->alpha * (2 * lambdas[k] - prev);
+
+		iters = cdsolve(&cd, opt->maxiter);
+		LOG_DEBUG("lambda %.6g took %d sweeps\n", lambdas[k], iters);
+		if (iters >= opt->maxiter) {
+			LOG_WARN("Coordinate descent did not converge for lambda %.6g\n", lambdas[k]);
+		}
+
+		memcpy(&GET(coefs, 0, k), cd.b, sizeof(double) * p);
+		prev = lambdas[k];
+	}
+
+	free(cd.b);
+	free(cd.q);
+	free(cd.eligible);
+
+	LATENCY_STOP(LAT_TRAIN, start);
+	LOG_INFO("Finished regularization path\n");
+	return opt->nlambda;
+}
+
+int traincv(const Matrix *z, int nfolds, const double *lambdas, int nlambda,
+			double *cverr, double *coef)
+{
+	LOG_INFO("%d-fold cross validation of %d lambdas on %dx%d...\n",
+			 nfolds, nlambda, z->nrows, z->ncols);
+	if (nfolds < 2 || nfolds > z->nrows || nlambda < 1) {
+		LOG_ERROR("Can't do %d folds of %d rows\n", nfolds, z->nrows);
+		return -1;
+	}
+	LATENCY_START(start);
+
+	int n = z->ncols;
+	int f, l, best = 0;
+	double err, besterr = 0;
+	Matrix *total = initmat(n, n, NULL, 1);
+	Matrix **grams = malloc(sizeof(Matrix *) * nfolds);
+	double *sse = malloc(sizeof(double) * nfolds * nlambda);
+	if (!grams || !sse) DIE("malloc");
+	for (f = 0; f < nfolds; f++) grams[f] = initmat(n, n, NULL, 1);
+
+	CVArgs args = { z, nfolds, lambdas, nlambda, grams, total, sse, 0 };
+
+	/* One pass over the rows for all the blocks, the total is their sum */
+	tprun(cvblocks, &args);
+	for (f = 0; f < nfolds; f++) matadd(total, 1, grams[f]);
+	tprun(cvfolds, &args);
+
+	if (!args.err) {
+		for (l = 0; l < nlambda; l++) {
+			for (err = 0, f = 0; f < nfolds; f++) err += sse[f * nlambda + l];
+			err /= z->nrows;
+			if (cverr) cverr[l] = err;
+			LOG_DEBUG("lambda %.6g cross validation error %.6g\n", lambdas[l], err);
+			if (l == 0 || err < besterr) {
+				best = l;
+				besterr = err;
+			}
+		}
+		if (coef && ridgesolve(total, z->nrows, lambdas[best], coef)) args.err = -1;
+	}
+
+	for (f = 0; f < nfolds; f++) freemat(grams[f]);
+	free(grams);
+	free(sse);
+	freemat(total);
+
+	if (args.err) {
+		LOG_WARN("Cross validation failed, a training fold is singular\n");
+		return -1;
+	}
+	LATENCY_STOP(LAT_TRAIN, start);
+	LOG_INFO("Best lambda is %.6g with error %.6g\n", lambdas[best], besterr);
+	return best;
+}
+
+void iterdefaults(IterOptions *opt, int method)
+{
+	opt->method = method;
+	opt->lambda = 0;
+	opt->tol = 1e-10;
+	opt->maxiter = 1000;
+	opt->precond = 1;
+}
+
+int trainiter(const Matrix *x, const double *y, double *coef, const IterOptions *opt)
+{
+	IterOptions defaults;
+	if (!opt) {
+		iterdefaults(&defaults, ITER_CG);
+		opt = &defaults;
+	}
+	LOG_INFO("Training linear model on %dx%d with %s...\n", x->nrows, x->ncols,
+			 (opt->method == ITER_LSQR) ? "LSQR" : "conjugate gradients");
+	LATENCY_START(start);
+
+	int iters = (opt->method == ITER_LSQR) ? iterlsqr(x, y, coef, opt)
+										   : itercg(x, y, coef, opt);
+	if (iters < 0) {
+		LOG_WARN("Iterative solver did not converge in %d iterations\n", opt->maxiter);
+		return -1;
+	}
+
+	LATENCY_STOP(LAT_TRAIN, start);
+	LOG_INFO("Finished after %d iterations\n", iters);
+	return iters;
+}
@@ -0,0 +1,588 @@
+/**
+ * @file    tscodec.c
+ * @brief   Compressed time series files of ticks and candles
+ * @author  CJ vd Walt (Christian@vanderwalts.net)
+ * @date    19/10/2026
+*/
+
+/*** Includes ***/
+
+#include "tscodec.h"
+#include "error.h"
+#include "logging.h"
+#include "threadpool.h"
+
+/*** System Includes ***/
+
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*** Defines ***/
+
+/* Blocks with at least this many values are decoded on the thread pool */
+#define TSC_PARALLEL_VALS (1L << 16)
+
+/* Longest run of leading zeros of an XOR that fits its 5 bit field */
+#define TSC_MAX_LEAD 31
+
+/* Zeroed words after the blocks read by tscload(). A row of a damaged
+ * stream that starts inside it reads at most 77 bits and peeks a word
+ * further, so it stays inside the buffer until the decoder notices */
+#define TSC_TAIL_WORDS 2
+
+/*** Type Definitions ***/
+
+/* Bits written most significant first into zeroed 64 bit words */
+typedef struct {
+	uint64_t *words;
+	long nwords;
+	long nbits;
+} BitWriter;
+
+typedef struct {
+	const uint64_t *words;
+	long pos;
+} BitReader;
+
+/* Blocks [b0, b0 + nb) read into buf, decoded into mat by the threads */
+typedef struct {
+	const TscFile *tf;
+	const char *buf;
+	long b0;
+	long nb;
+	Matrix *mat;
+	int err;        /* Set by any thread that finds a damaged block */
+} TscArgs;
+
+/*** Helper Functions ***/
+
+/* Write all len bytes to fd, retrying on short writes */
+static int writeall(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = write(fd, p, len)) <= 0) return EXIT_FAILURE;
+		p += n;
+		len -= n;
+	}
+	return EXIT_SUCCESS;
+}
+
+/* Read exactly len bytes from fd at offset, retrying on short reads */
+static int readall(int fd, void *buf, size_t len, off_t offset)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = pread(fd, p, len, offset)) <= 0) return EXIT_FAILURE;
+		p += n;
+		len -= n;
+		offset += n;
+	}
+	return EXIT_SUCCESS;
+}
+
+static inline uint64_t dbits(double d)
+{
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+static inline double bitsd(uint64_t bits)
+{
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+/* Small signed values to small unsigned ones, 0 -1 1 -2 .. to 0 1 2 3 .. */
+static inline uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t z)
+{
+	return (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+}
+
+/* Appends the low n bits of value, 1 <= n <= 64 */
+static void putbits(BitWriter *bw, uint64_t value, int n)
+{
+	long idx = bw->nbits >> 6;
+	int pos = bw->nbits & 63;
+
+	/* Room for a straddling write and the word of padding after it */
+	if (idx + 2 >= bw->nwords) {
+		long grow = bw->nwords ? bw->nwords : 64;
+		if (!(bw->words = realloc(bw->words, sizeof(uint64_t) * (bw->nwords + grow))))
+			DIE("realloc");
+		memset(&bw->words[bw->nwords], 0, sizeof(uint64_t) * grow);
+		bw->nwords += grow;
+	}
+
+	if (n < 64) value &= (1ULL << n) - 1;
+	if (pos + n <= 64) {
+		bw->words[idx] |= value << (64 - pos - n);
+	} else {
+		bw->words[idx] |= value >> (pos + n - 64);
+		bw->words[idx + 1] |= value << (128 - pos - n);
+	}
+	bw->nbits += n;
+}
+
+/* The next n bits without moving past them, 1 <= n <= 64. Streams end in a
+ * word of padding so a peek past the last value stays inside them */
+static inline uint64_t peekbits(const BitReader *br, int n)
+{
+	long idx = br->pos >> 6;
+	int off = br->pos & 63;
+	uint64_t hi = br->words[idx] << off;
+
+	if (off + n > 64) hi |= br->words[idx + 1] >> (64 - off);
+	return hi >> (64 - n);
+}
+
+static inline uint64_t getbits(BitReader *br, int n)
+{
+	uint64_t bits = peekbits(br, n);
+	br->pos += n;
+	return bits;
+}
+
+/* Timestamps as delta-of-deltas, a fixed interval is a 0 bit per row and
+ * jitter of a few units fits in 9 to 16 bits */
+static void encodets(BitWriter *bw, const Matrix *mat, long r0, long rows)
+{
+	int64_t t, prev = 0, delta = 0;
+	uint64_t z;
+	long r;
+
+	for (r = 0; r < rows; r++) {
+		t = (int64_t)GET(mat, 0, r0 + r);
+		if (r == 0) {
+			putbits(bw, t, 64);
+		} else if (r == 1) {
+			delta = t - prev;
+			putbits(bw, delta, 64);
+		} else {
+			z = zigzag((t - prev) - delta);
+			delta = t - prev;
+			if (z == 0)           putbits(bw, 0x0, 1);
+			else if (z < 1 << 7)  putbits(bw, 0x2 << 7 | z, 9);
+			else if (z < 1 << 9)  putbits(bw, 0x6ULL << 9 | z, 12);
+			else if (z < 1 << 12) putbits(bw, 0xeULL << 12 | z, 16);
+			else {
+				putbits(bw, 0xf, 4);
+				putbits(bw, z, 64);
+			}
+		}
+		prev = t;
+	}
+}
+
+/* Values as the XOR with the previous one. Only the bits between the
+ * leading and trailing zeros are kept, reusing the last window when the
+ * new bits fit inside it */
+static void encodevals(BitWriter *bw, const Matrix *mat, int col, long r0, long rows)
+{
+	uint64_t bits, x, prev = 0;
+	int lead, trail, len, plead = -1, ptrail = 0;
+	long r;
+
+	for (r = 0; r < rows; r++) {
+		bits = dbits(GET(mat, col, r0 + r));
+		x = bits ^ prev;
+		prev = bits;
+
+		if (r == 0) {
+			putbits(bw, bits, 64);
+			continue;
+		}
+		if (x == 0) {
+			putbits(bw, 0x0, 1);
+			continue;
+		}
+
+		lead = __builtin_clzll(x);
+		trail = __builtin_ctzll(x);
+		if (lead > TSC_MAX_LEAD) lead = TSC_MAX_LEAD;
+
+		if (plead >= 0 && lead >= plead && trail >= ptrail) {
+			putbits(bw, 0x2, 2);
+			putbits(bw, x >> ptrail, 64 - plead - ptrail);
+		} else {
+			len = 64 - lead - trail;
+			putbits(bw, 0x3ULL << 11 | (uint64_t)lead << 6 | (len - 1), 13);
+			putbits(bw, x >> trail, len);
+			plead = lead;
+			ptrail = trail;
+		}
+	}
+}
+
+/* Writes each column of rows [r0, r0 + rows) as its own stream after a
+ * table of the stream sizes, returns the bytes written or -1 */
+static long writeblock(int fd, const Matrix *mat, long r0, long rows)
+{
+	BitWriter bw;
+	int c, ncols = mat->ncols;
+	long nbytes, total;
+	size_t tsize = ((ncols * sizeof(uint32_t) + 7) / 8) * 8;
+	uint32_t *sizes = calloc(1, tsize);
+	uint64_t **streams = malloc(sizeof(uint64_t *) * ncols);
+	if (!sizes || !streams) DIE("malloc");
+
+	total = tsize;
+	for (c = 0; c < ncols; c++) {
+		bw.words = NULL;
+		bw.nwords = bw.nbits = 0;
+		if (c == 0) encodets(&bw, mat, r0, rows);
+		else        encodevals(&bw, mat, c, r0, rows);
+
+		/* Whole words plus one of padding for the reader to peek into */
+		nbytes = ((bw.nbits + 63) / 64 + 1) * sizeof(uint64_t);
+		sizes[c] = nbytes;
+		streams[c] = bw.words;
+		total += nbytes;
+	}
+
+	int err = writeall(fd, sizes, tsize);
+	for (c = 0; c < ncols; c++) {
+		if (!err) err = writeall(fd, streams[c], sizes[c]);
+		free(streams[c]);
+	}
+	free(sizes);
+	free(streams);
+	return err ? -1 : total;
+}
+
+/* The decoders return -1 if the rows run past the nwords of the stream */
+static int decodets(const uint64_t *words, long nwords, double *out, long rows, long stride)
+{
+	BitReader br = { words, 0 };
+	uint64_t t = 0, delta = 0, ctl;     /* Unsigned so a damaged delta wraps */
+	long r, end = (nwords - 1) * 64;
+
+	for (r = 0; r < rows; r++) {
+		if (br.pos > end) return -1;
+		if (r == 0) {
+			t = getbits(&br, 64);
+		} else if (r == 1) {
+			delta = getbits(&br, 64);
+			t += delta;
+		} else {
+			ctl = peekbits(&br, 4);
+			if (!(ctl & 0x8)) {
+				br.pos++;
+			} else if (!(ctl & 0x4)) {
+				br.pos += 2;
+				delta += (uint64_t)unzigzag(getbits(&br, 7));
+			} else if (!(ctl & 0x2)) {
+				br.pos += 3;
+				delta += (uint64_t)unzigzag(getbits(&br, 9));
+			} else if (!(ctl & 0x1)) {
+				br.pos += 4;
+				delta += (uint64_t)unzigzag(getbits(&br, 12));
+			} else {
+				br.pos += 4;
+				delta += (uint64_t)unzigzag(getbits(&br, 64));
+			}
+			t += delta;
+		}
+		out[r * stride] = (double)(int64_t)t;
+	}
+	return (br.pos > end) ? -1 : 0;
+}
+
+static int decodevals(const uint64_t *words, long nwords, double *out, long rows, long stride)
+{
+	BitReader br = { words, 0 };
+	uint64_t bits = 0, ctl;
+	int lead, len, trail = 0, width = 0;
+	long r, end = (nwords - 1) * 64;
+
+	for (r = 0; r < rows; r++) {
+		if (br.pos > end) return -1;
+		if (r == 0) {
+			bits = getbits(&br, 64);
+		} else {
+			ctl = peekbits(&br, 2);
+			if (!(ctl & 0x2)) {
+				br.pos++;
+			} else if (ctl == 0x2) {
+				if (!width) return -1;
+				br.pos += 2;
+				bits ^= getbits(&br, width) << trail;
+			} else {
+				ctl = getbits(&br, 13);
+				lead = (ctl >> 6) & 0x1f;
+				len = (ctl & 0x3f) + 1;
+				if (lead + len > 64) return -1;
+				trail = 64 - lead - len;
+				width = len;
+				bits ^= getbits(&br, len) << trail;
+			}
+		}
+		out[r * stride] = bitsd(bits);
+	}
+	return (br.pos > end) ? -1 : 0;
+}
+
+/* Every (block, column) stream is a task of its own, the columns of a
+ * block write to separate places of mat so nothing is shared. The size
+ * table of a block is checked by every task of it, it is only ncols long */
+static void decodeblocks(void *arg, int id, int nthreads)
+{
+	TscArgs *a = arg;
+	const TscFile *tf = a->tf;
+	long ncols = tf->ncols;
+	long b, t, c, k, rows, used, base = tf->index[a->b0].offset;
+	size_t tsize = ((ncols * sizeof(uint32_t) + 7) / 8) * 8;
+	const uint32_t *sizes;
+	const char *stream;
+	int err;
+
+	for (t = id; t < a->nb * ncols; t += nthreads) {
+		b = a->b0 + t / ncols;
+		c = t % ncols;
+		rows = (b == tf->nblocks - 1) ? tf->nrows - b * tf->blockrows : tf->blockrows;
+
+		sizes = (const uint32_t *)(a->buf + tf->index[b].offset - base);
+		stream = (const char *)sizes + tsize;
+		for (k = 0, used = tsize, err = 0; k < ncols; k++) {
+			if (k < c) stream += sizes[k];
+			used += sizes[k];
+			err |= sizes[k] % sizeof(uint64_t) != 0;
+		}
+		if (err || used > tf->index[b].nbytes) {
+			__atomic_store_n(&a->err, -1, __ATOMIC_RELAXED);
+			continue;
+		}
+
+		double *out = &GET(a->mat, c, (b - a->b0) * tf->blockrows);
+		if (c == 0) err = decodets((const uint64_t *)stream, sizes[c] / 8, out, rows, ncols);
+		else        err = decodevals((const uint64_t *)stream, sizes[c] / 8, out, rows, ncols);
+		if (err) __atomic_store_n(&a->err, -1, __ATOMIC_RELAXED);
+	}
+}
+
+/* The blocks have to follow the index back to back up to the end of the
+ * file, each at least its size table long and in timestamp order */
+static int checkindex(const TscFile *tf, long filesize)
+{
+	long b, offset = sizeof(TscHeader) + tf->nblocks * sizeof(TscBlock);
+	long tsize = ((tf->ncols * sizeof(uint32_t) + 7) / 8) * 8;
+	const TscBlock *blk;
+
+	for (b = 0; b < tf->nblocks; b++) {
+		blk = &tf->index[b];
+		if (blk->offset != offset || blk->nbytes <= tsize
+			|| blk->nbytes > filesize - offset || blk->nbytes % sizeof(uint64_t)
+			|| !(blk->first <= blk->last) || (b && blk->first < blk[-1].last))
+			return -1;
+		offset += blk->nbytes;
+	}
+	return (offset == filesize) ? 0 : -1;
+}
+
+/*** Public Functions ***/
+
+int tscsave(const char *path, const Matrix *mat, long blockrows)
+{
+	LOG_INFO("Saving %dx%d time series to %s...\n", mat->nrows, mat->ncols, path);
+	if (blockrows <= 0) blockrows = TSC_BLOCK_ROWS;
+
+	TscHeader head;
+	TscBlock *index;
+	long b, r, r0, rows, nbytes, offset;
+	int fd, err = 0;
+	double t;
+
+	/* The delta-of-delta coding and the index need ordered whole timestamps */
+	for (r = 0; r < mat->nrows; r++) {
+		t = GET(mat, 0, r);
+		if (t != floor(t) || fabs(t) >= 0x1p53 || (r && t < GET(mat, 0, r - 1))) {
+			LOG_ERROR("Row %ld does not have a whole increasing timestamp\n", r);
+			return -1;
+		}
+	}
+
+	memcpy(head.magic, TSC_MAGIC, TSC_MAGIC_LEN);
+	head.nrows = mat->nrows;
+	head.ncols = mat->ncols;
+	head.blockrows = blockrows;
+	head.nblocks = (mat->nrows + blockrows - 1) / blockrows;
+	if (!(index = calloc(head.nblocks, sizeof(TscBlock)))) DIE("calloc");
+
+	fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0) {
+		LOG_ERROR("Could not open %s for writing\n", path);
+		free(index);
+		return -1;
+	}
+
+	/* The index is written last once the block sizes are known */
+	offset = sizeof(head) + head.nblocks * sizeof(TscBlock);
+	if (lseek(fd, offset, SEEK_SET) != offset) err = -1;
+	for (b = 0; b < head.nblocks && !err; b++) {
+		r0 = b * blockrows;
+		rows = (r0 + blockrows < mat->nrows) ? blockrows : mat->nrows - r0;
+		if ((nbytes = writeblock(fd, mat, r0, rows)) < 0) {
+			err = -1;
+			break;
+		}
+		index[b].first = GET(mat, 0, r0);
+		index[b].last = GET(mat, 0, r0 + rows - 1);
+		index[b].offset = offset;
+		index[b].nbytes = nbytes;
+		offset += nbytes;
+	}
+
+	if (!err && (lseek(fd, 0, SEEK_SET) != 0 || writeall(fd, &head, sizeof(head))
+				 || writeall(fd, index, head.nblocks * sizeof(TscBlock))))
+		err = -1;
+
+	close(fd);
+	free(index);
+	if (err) {
+		LOG_ERROR("Failed to write time series to %s\n", path);
+		return -1;
+	}
+
+	LOG_INFO("Compressed %ld rows to %ld bytes, %.2f bits per value\n", head.nrows, offset,
+			 8.0 * offset / ((double)head.nrows * head.ncols));
+	return EXIT_SUCCESS;
+}
+
+TscFile *tscopen(const char *path)
+{
+	LOG_INFO("Opening time series file %s...\n", path);
+
+	TscHeader head;
+	TscFile *tf;
+	struct stat st;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		LOG_ERROR("Could not open %s for reading\n", path);
+		return NULL;
+	}
+
+	/* A loaded range is a Matrix, so the dimensions have to fit an int */
+	if (fstat(fd, &st) || readall(fd, &head, sizeof(head), 0)
+		|| memcmp(head.magic, TSC_MAGIC, TSC_MAGIC_LEN)
+		|| head.nrows <= 0 || head.ncols <= 0 || head.blockrows <= 0
+		|| head.nrows > INT_MAX || head.ncols > INT_MAX
+		|| head.nblocks != head.nrows / head.blockrows + (head.nrows % head.blockrows != 0)) {
+		LOG_ERROR("%s is not a valid time series file\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	if (!(tf = malloc(sizeof(TscFile)))) DIE("malloc");
+	if (!(tf->index = malloc(sizeof(TscBlock) * head.nblocks))) DIE("malloc");
+	tf->fd = fd;
+	tf->nrows = head.nrows;
+	tf->ncols = head.ncols;
+	tf->blockrows = head.blockrows;
+	tf->nblocks = head.nblocks;
+
+	if (readall(fd, tf->index, sizeof(TscBlock) * head.nblocks, sizeof(head))) {
+		LOG_ERROR("%s is truncated\n", path);
+		tscclose(tf);
+		return NULL;
+	}
+	if (checkindex(tf, st.st_size)) {
+		LOG_ERROR("%s has a damaged block index\n", path);
+		tscclose(tf);
+		return NULL;
+	}
+
+	LOG_INFO("Opened %ldx%ld time series file of %ld blocks\n", tf->nrows, tf->ncols, tf->nblocks);
+	return tf;
+}
+
+void tscclose(TscFile *tf)
+{
+	close(tf->fd);
+	free(tf->index);
+	free(tf);
+}
+
+Matrix *tscload(const TscFile *tf, double from, double to)
+{
+	LOG_INFO("Loading time series from %g to %g...\n", from, to);
+	long lo, hi, mid, b0, b1, rows, first, end;
+	size_t len;
+	char *buf;
+	Matrix *mat;
+
+	/* First block that ends at or after from, last one that starts before to */
+	for (lo = 0, hi = tf->nblocks; lo < hi;) {
+		mid = (lo + hi) / 2;
+		if (tf->index[mid].last < from) lo = mid + 1;
+		else                            hi = mid;
+	}
+	b0 = lo;
+	for (hi = tf->nblocks; lo < hi;) {
+		mid = (lo + hi) / 2;
+		if (tf->index[mid].first < to) lo = mid + 1;
+		else                           hi = mid;
+	}
+	b1 = lo - 1;
+	if (b0 > b1) {
+		LOG_WARN("No rows between %g and %g\n", from, to);
+		return NULL;
+	}
+
+	/* The blocks are next to each other, so one read fetches all of them */
+	len = tf->index[b1].offset + tf->index[b1].nbytes - tf->index[b0].offset;
+	if (!(buf = malloc(len + TSC_TAIL_WORDS * sizeof(uint64_t)))) DIE("malloc");
+	memset(buf + len, 0, TSC_TAIL_WORDS * sizeof(uint64_t));
+	if (readall(tf->fd, buf, len, tf->index[b0].offset)) {
+		LOG_ERROR("Failed to read blocks %ld to %ld\n", b0, b1);
+		free(buf);
+		return NULL;
+	}
+
+	rows = ((b1 == tf->nblocks - 1) ? tf->nrows : (b1 + 1) * tf->blockrows) - b0 * tf->blockrows;
+	mat = initmat(rows, tf->ncols, NULL, 1);
+
+	TscArgs args = { tf, buf, b0, b1 - b0 + 1, mat, 0 };
+	if (rows * tf->ncols >= TSC_PARALLEL_VALS && tpthreads() > 1)
+		tprun(decodeblocks, &args);
+	else
+		decodeblocks(&args, 0, 1);
+	free(buf);
+	if (args.err) {
+		LOG_ERROR("Blocks %ld to %ld are damaged\n", b0, b1);
+		freemat(mat);
+		return NULL;
+	}
+
+	/* Only the first and last block can have rows outside the range */
+	for (first = 0; first < rows && GET(mat, 0, first) < from; first++);
+	for (end = rows; end > first && GET(mat, 0, end - 1) >= to; end--);
+	if (first == end) {
+		LOG_WARN("No rows between %g and %g\n", from, to);
+		freemat(mat);
+		return NULL;
+	}
+	if (first > 0)
+		memmove(mat->vals, &GET(mat, 0, first), sizeof(double) * (end - first) * mat->ncols);
+	mat->nrows = end - first;
+
+	LOG_INFO("Loaded %dx%d time series\n", mat->nrows, mat->ncols);
+	return mat;
+}
@@ -291,5 +291,28 @@ def main():
 
         f.write("const double NXNSOLVE_T = " + str(round(nnsolve, 12)) + ";\n")
 
+        # Inverse, psuodoinverse and singular values
+        stime = time.perf_counter()
+        inv_E = np.linalg.inv(mat_E) if non_singular_E else np.zeros(shape_E)
+        pinv_C = np.linalg.pinv(mat_C)
+        sval_C = np.linalg.svd(mat_C, compute_uv=False)
+        etime = time.perf_counter()
+        inv_t = etime - stime
+
+        f.write(INVERSE)
+        f.write("const double INV_E[] = { ")
+        write_array(f, inv_E.flatten())
+        f.write(" };\n")
+        f.write("const double PINV_C[] = { ")
+        write_array(f, pinv_C.flatten())
+        f.write(" };\n")
+        f.write("const double SVAL_C[] = { ")
+        write_array(f, sval_C)
+        f.write(" };\n")
+
+        f.write("\n")
+
+        f.write("const double INV_T = " + str(round(inv_t, 12)) + ";\n")
+
 
 main()